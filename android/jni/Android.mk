@@ -44,8 +44,11 @@ LOCAL_SRC_FILES := \
 	$(SOURCE_PATH)/src/picasso_painter.cpp \
 	$(SOURCE_PATH)/src/picasso_path.cpp \
 	$(SOURCE_PATH)/src/picasso_pattern.cpp \
+	$(SOURCE_PATH)/src/picasso_picture.cpp \
 	$(SOURCE_PATH)/src/picasso_raster_adapter.cpp \
-	$(SOURCE_PATH)/src/picasso_rendering_buffer.cpp
+	$(SOURCE_PATH)/src/picasso_rendering_buffer.cpp \
+	$(SOURCE_PATH)/src/picasso_sweep.cpp \
+	$(SOURCE_PATH)/src/picasso_trace.cpp
 
 LOCAL_CPPFLAGS := -DEXPORT=1 -DNDEBUG=1 -D__ANDROID__=1 \
 				  -O3 -Wall -fPIC -march=armv7-a -mfpu=neon -ftree-vectorize -mfloat-abi=softfp \
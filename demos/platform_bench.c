@@ -0,0 +1,278 @@
+/* platform - headless benchmark framework base on picasso
+ *
+ * Copyright (C) 2009 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Renders a demo scene into memory canvas of every pixel format, and
+ * writes the frame timings to stdout in JSON.
+ *
+ * usage: bench_<scene> [-w width] [-h height] [-n frames] [-s warmup] [-f format]
+ *
+ * Pictures are loaded from "<name>.bmp" in the current directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "picasso.h"
+#include "interface.h"
+#include "timeuse.h"
+
+static const struct {
+    ps_color_format fmt;
+    const char* name;
+    int bpp;
+} formats[] = {
+    { COLOR_FORMAT_RGBA, "rgba", 4 },
+    { COLOR_FORMAT_ARGB, "argb", 4 },
+    { COLOR_FORMAT_ABGR, "abgr", 4 },
+    { COLOR_FORMAT_BGRA, "bgra", 4 },
+    { COLOR_FORMAT_RGB, "rgb", 3 },
+    { COLOR_FORMAT_BGR, "bgr", 3 },
+    { COLOR_FORMAT_RGB565, "rgb565", 2 },
+    { COLOR_FORMAT_RGB555, "rgb555", 2 },
+};
+
+#define NUM_FORMATS (sizeof(formats) / sizeof(formats[0]))
+
+static unsigned timer_interval = 0;
+
+unsigned set_timer(unsigned mc)
+{
+    timer_interval = mc;
+    return 1;
+}
+
+void clear_timer(unsigned id)
+{
+    timer_interval = 0;
+}
+
+void refresh(const ps_rect* r)
+{
+    /* every frame is drawn. */
+}
+
+static unsigned short read_u16(const unsigned char* p)
+{
+    return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static unsigned read_u32(const unsigned char* p)
+{
+    return (unsigned)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24));
+}
+
+picture* load_picture(const char* name)
+{
+    FILE* f;
+    char* pname;
+    unsigned char head[54];
+    unsigned char* row;
+    unsigned char* data;
+    picture* pic;
+    int w, h, bpp, bottom_up, stride, src_stride, x, y;
+
+    if (!name || !strlen(name))
+        return NULL;
+
+    pname = (char*)malloc(strlen(name)+5);
+    sprintf(pname, "%s.bmp", name);
+    f = fopen(pname, "rb");
+    free(pname);
+    if (!f)
+        return NULL;
+
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) || head[0] != 'B' || head[1] != 'M') {
+        fclose(f);
+        return NULL;
+    }
+
+    w = (int)read_u32(head + 18);
+    h = (int)read_u32(head + 22);
+    bpp = read_u16(head + 28) / 8;
+    bottom_up = h > 0;
+    if (h < 0)
+        h = -h;
+
+    if (w <= 0 || (bpp != 3 && bpp != 4) || read_u32(head + 30) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    /* keep as 24 bits, the alpha of bitmap files is not reliable. */
+    src_stride = (w * bpp + 3) & ~3;
+    stride = w * 3;
+    row = (unsigned char*)malloc(src_stride);
+    data = (unsigned char*)malloc(stride * h);
+    fseek(f, (long)read_u32(head + 10), SEEK_SET);
+    for (y = 0; y < h; y++) {
+        unsigned char* dst = data + (bottom_up ? (h - 1 - y) : y) * stride;
+        if (fread(row, 1, src_stride, f) != (size_t)src_stride)
+            memset(row, 0, src_stride);
+        for (x = 0; x < w; x++) {
+            dst[x*3] = row[x*bpp];
+            dst[x*3+1] = row[x*bpp+1];
+            dst[x*3+2] = row[x*bpp+2];
+        }
+    }
+    free(row);
+    fclose(f);
+
+    pic = (picture*)malloc(sizeof(picture));
+    pic->width = w;
+    pic->height = h;
+    pic->native = data;
+    pic->image = ps_image_create_with_data(data, COLOR_FORMAT_BGR, w, h, stride);
+    return pic;
+}
+
+void free_picture(picture* p)
+{
+    if (!p)
+        return;
+
+    ps_image_unref(p->image);
+    free(p->native);
+    free(p);
+}
+
+/* drag the mouse around a small circle, so scenes driven by input keep changing. */
+static void feed_input(int frame, int width, int height)
+{
+    int x = width / 2 + (int)(40 * cos(frame * 0.2));
+    int y = height / 2 + (int)(40 * sin(frame * 0.2));
+
+    if (frame == 0)
+        on_mouse_event(LEFT_BUTTON_DOWN, EVT_LBUTTON, x, y);
+    else
+        on_mouse_event(MOUSE_MOVE, EVT_LBUTTON, x, y);
+}
+
+static void draw_frame(ps_context* context, int frame, int width, int height)
+{
+    feed_input(frame, width, height);
+    if (timer_interval)
+        on_timer();
+    on_size(width, height);
+    on_draw(context);
+}
+
+static const char* scene_name(const char* path)
+{
+    static char name[64];
+    const char* p = strrchr(path, '/');
+    char* e;
+
+    if (!p)
+        p = strrchr(path, '\\');
+    p = p ? p + 1 : path;
+    if (!strncmp(p, "bench_", 6))
+        p += 6;
+
+    strncpy(name, p, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    if ((e = strchr(name, '.')) != NULL)
+        *e = '\0';
+    return name;
+}
+
+int main(int argc, char* argv[])
+{
+    int width = 640, height = 480, frames = 100, warmup = 10;
+    const char* only = NULL;
+    double* times;
+    unsigned i;
+    int j, first = 1;
+
+    for (j = 1; j < argc - 1; j += 2) {
+        if (!strcmp(argv[j], "-w"))
+            width = atoi(argv[j+1]);
+        else if (!strcmp(argv[j], "-h"))
+            height = atoi(argv[j+1]);
+        else if (!strcmp(argv[j], "-n"))
+            frames = atoi(argv[j+1]);
+        else if (!strcmp(argv[j], "-s"))
+            warmup = atoi(argv[j+1]);
+        else if (!strcmp(argv[j], "-f"))
+            only = argv[j+1];
+    }
+
+    if (width < 1 || height < 1 || frames < 1 || warmup < 0) {
+        fprintf(stderr, "usage: %s [-w width] [-h height] [-n frames] [-s warmup] [-f format]\n", argv[0]);
+        return 1;
+    }
+
+    if (!ps_initialize()) {
+        fprintf(stderr, "picasso initialize failed.\n");
+        return 1;
+    }
+
+    times = (double*)malloc(sizeof(double) * frames);
+
+    printf("{\n  \"scene\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"results\": [",
+            scene_name(argv[0]), width, height, frames);
+
+    for (i = 0; i < NUM_FORMATS; i++) {
+        ps_byte* buffer;
+        ps_canvas* canvas;
+        ps_context* context;
+        double total = 0, mean, variance = 0, min_ms, max_ms;
+        int n;
+
+        if (only && strcmp(only, formats[i].name))
+            continue;
+
+        buffer = (ps_byte*)calloc(1, width * height * formats[i].bpp);
+        canvas = ps_canvas_create_with_data(buffer, formats[i].fmt, width, height, width * formats[i].bpp);
+        context = ps_context_create(canvas, 0);
+
+        srand(1);
+        on_init(context, width, height);
+        srand(1); /* scenes seed with time in init. */
+
+        for (n = 0; n < warmup; n++)
+            draw_frame(context, n, width, height);
+
+        for (n = 0; n < frames; n++) {
+            clocktime_t t1, t2;
+            t1 = get_clock();
+            draw_frame(context, warmup + n, width, height);
+            t2 = get_clock();
+            times[n] = get_clock_used_ms(t1, t2);
+            total += times[n];
+        }
+
+        on_term(context);
+        ps_context_unref(context);
+        ps_canvas_unref(canvas);
+        free(buffer);
+
+        mean = total / frames;
+        min_ms = max_ms = times[0];
+        for (n = 0; n < frames; n++) {
+            variance += (times[n] - mean) * (times[n] - mean);
+            if (times[n] < min_ms)
+                min_ms = times[n];
+            if (times[n] > max_ms)
+                max_ms = times[n];
+        }
+        variance = (frames > 1) ? variance / (frames - 1) : 0;
+
+        printf("%s\n    {\"format\": \"%s\", \"ms_per_frame\": %.4f, \"mpix_per_sec\": %.3f, "
+               "\"variance_ms2\": %.6f, \"stddev_ms\": %.4f, \"min_ms\": %.4f, \"max_ms\": %.4f}",
+                first ? "" : ",", formats[i].name, mean, (mean > 0) ? (width * height) / (mean * 1000) : 0,
+                variance, sqrt(variance), min_ms, max_ms);
+        first = 0;
+    }
+
+    printf("\n  ]\n}\n");
+
+    free(times);
+    ps_shutdown();
+    return 0;
+}
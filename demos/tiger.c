@@ -234,7 +234,7 @@ void on_draw(ps_context* gc)
 #if defined(WIN32) || defined(WINCE)
     clocktime_t t1, t2;
 #else
-    suseconds_t t1, t2;
+    long long t1, t2;
 #endif
     PS* ps = 0;
     float scale = height/tigerMaxY;
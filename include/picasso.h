@@ -42,6 +42,7 @@
 #endif
 
 #include "pconfig.h"
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -165,6 +166,13 @@ typedef struct _ps_mask ps_mask;
  */
 typedef struct _ps_font ps_font;
 
+/**
+ * \typedef ps_picture
+ * \brief An opaque type represents recorded drawing commands.
+ * \sa ps_context
+ */
+typedef struct _ps_picture ps_picture;
+
 /**
  * \brief A character glyph of a font.
  */
@@ -244,6 +252,15 @@ PEXPORT int PICAPI ps_version(void);
  *
  * \return  True if is initialized, otherwise False.
  *
+ * \note ps_initialize and ps_shutdown must not be called concurrently with any other function.
+ *       Between them, contexts created without a shared context may be used on different
+ *       threads at the same time, as long as each thread draws to its own canvas and no
+ *       object (context, canvas, path, image ...) is modified by two threads at once.
+ *       Contexts sharing resources with \a ps_context_create must be used on the same thread.
+ *       Fonts, images, patterns, gradients, canvases, masks and pictures may be referenced from
+ *       any thread, such as set as the source of contexts on different threads, their reference
+ *       counts are atomic. They must not be modified while another thread is drawing with them.
+ *
  * \sa ps_shutdown
  */
 PEXPORT ps_bool PICAPI ps_initialize(void);
@@ -292,9 +309,45 @@ typedef enum _ps_status {
     STATUS_UNKNOWN_ERROR,
 }ps_status;
 
+/**
+ * \brief Memory allocator functions used by picasso.
+ */
+typedef struct _ps_allocator {
+    /** Allocate size bytes, same as malloc. */
+    void* (*malloc_func)(size_t size);
+    /** Allocate num * size bytes initialized to zero, same as calloc. */
+    void* (*calloc_func)(size_t num, size_t size);
+    /** Change the size of memory block, same as realloc. */
+    void* (*realloc_func)(void* p, size_t size);
+    /** Free memory block, same as free. */
+    void (*free_func)(void* p);
+}ps_allocator;
+
+/**
+ * \fn ps_bool ps_set_allocator(const ps_allocator* allocator)
+ * \brief Set the memory allocator used by picasso for all its memory.
+ *
+ * \param allocator  Pointer to the allocator functions, all of them must be given.
+ *                   NULL restore the C runtime functions.
+ *
+ * \return  True if is set, otherwise False.
+ *
+ * \note It must be called before the first \a ps_initialize, it fails when picasso is initialized.
+ *       Memory is freed by the allocator which is current, so it should not be changed after
+ *       any memory is allocated. The functions may be called from any thread that is drawing.
+ *       Transient memory of drawing is taken from blocks kept by every canvas, so the allocator
+ *       is seldom called when drawing similar frames.
+ *
+ * \sa ps_initialize, ps_last_status
+ */
+PEXPORT ps_bool PICAPI ps_set_allocator(const ps_allocator* allocator);
+
 /**
  * \fn ps_status ps_last_status(void)
  * \brief Return the last status code of picasso.
+ *
+ * \note The status code is kept per thread, it is the result of the last call on the calling thread.
+ *
  * \sa ps_version
  */
 PEXPORT ps_status PICAPI ps_last_status(void);
@@ -384,6 +437,77 @@ PEXPORT ps_canvas* PICAPI ps_context_set_canvas(ps_context* ctx, ps_canvas* canv
  */
 PEXPORT ps_canvas* PICAPI ps_context_get_canvas(ps_context* ctx);
 
+/**
+ * \brief Bytes of memory held by picasso, by kind of storage.
+ */
+typedef struct _ps_memory_stats {
+    /** Cell blocks and sort tables of rasterizers. */
+    unsigned int raster_bytes;
+    /** Scanline storages of painter. */
+    unsigned int scanline_bytes;
+    /** Span buffers of painter. */
+    unsigned int span_bytes;
+    /** Shadow layer and blur buffers. */
+    unsigned int shadow_bytes;
+    /** Path storage, include text layouts and glyph outlines. */
+    unsigned int path_bytes;
+    /** Glyph caches. */
+    unsigned int glyph_bytes;
+    /** Loaded font files. */
+    unsigned int font_bytes;
+    /** Sum of all above. */
+    unsigned int total_bytes;
+}ps_memory_stats;
+
+/**
+ * \fn ps_bool ps_get_memory_stats(const ps_context* ctx, ps_memory_stats* stats)
+ * \brief Return the bytes of memory held by a context or by the caches shared in the process.
+ *
+ * \param ctx    Pointer to an existing context object, NULL for the shared caches.
+ * \param stats  Pointer to a structure to receiving the memory statistics.
+ *
+ * \return  True if is success, otherwise False.
+ *
+ * \note A context reports the storages of itself, its canvas and its fonts. The glyph caches
+ *       of its fonts are shared with other contexts which use the same fonts. When ctx is NULL,
+ *       only the glyph caches and the loaded font files are reported, the storages of contexts
+ *       and canvases are not included, sum them by calling this function for every context.
+ *       Storages grow to the largest
+ *       drawing and are kept for reuse, call \a ps_context_trim to give them back.
+ *       To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_context_trim, ps_trim_caches
+ */
+PEXPORT ps_bool PICAPI ps_get_memory_stats(const ps_context* ctx, ps_memory_stats* stats);
+
+/**
+ * \fn void ps_context_trim(ps_context* ctx)
+ * \brief Free the storages which a context keeps for reuse.
+ *
+ * \param ctx  Pointer to an existing context object.
+ *
+ * \note Rasterizer cells, scanlines, span, shadow and blur buffers of the context and its canvas
+ *       are freed, paths are shrunk to their contents and the text layout cache is emptied.
+ *       The current path and clipping are kept. It is useful after drawing a huge frame,
+ *       the next drawing will allocate the storages again.
+ *       To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_get_memory_stats, ps_trim_caches
+ */
+PEXPORT void PICAPI ps_context_trim(ps_context* ctx);
+
+/**
+ * \fn void ps_trim_caches(void)
+ * \brief Free the glyph caches which are not used by any font.
+ *
+ * \note Unused glyph caches are kept within the budget set by \a ps_set_glyph_cache_size,
+ *       this function frees all of them.
+ *       To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_get_memory_stats, ps_context_trim, ps_set_glyph_cache_size
+ */
+PEXPORT void PICAPI ps_trim_caches(void);
+
 /** @} end of context functions*/
 
 /**
@@ -646,6 +770,38 @@ PEXPORT void PICAPI ps_canvas_reset_mask(ps_canvas* canvas);
  */
 PEXPORT void PICAPI ps_canvas_bitblt(ps_canvas* src, const ps_rect* rect,
                                                 ps_canvas* dst, const ps_point* location);
+
+/**
+ * \fn unsigned int ps_canvas_get_damage(const ps_canvas* canvas, ps_rect* rects, unsigned int max)
+ * \brief Get the areas of the canvas changed since created or last reset.
+ *
+ * \param canvas  Pointer to an existing canvas object.
+ * \param rects   Buffer to receive the damage rectangles in device pixels, NULL to get the number only.
+ * \param max     The number of rectangles the buffer can hold.
+ *
+ * \return The number of rectangles stored in buffer, or the number of damage rectangles if \a rects is NULL.
+ *
+ * \note Fill, stroke, text, clear, bitblt, shadow and blur add their device bounds to the canvas,
+ *       clipped by the canvas. Overlapped rectangles are merged and the canvas keeps a few of them,
+ *       so the result may cover more pixels than changed. Rectangles are merged more when \a max is
+ *       less than the number of rectangles. Drawing on a canvas created by \a ps_canvas_create_from_canvas
+ *       or \a ps_canvas_create_from_image damages the canvas which owns the pixels too, at the position
+ *       of the area, so sub canvases of one canvas may be drawn by different threads. To get extended
+ *       error information, call \a ps_last_status.
+ *
+ * \sa ps_canvas_reset_damage
+ */
+PEXPORT unsigned int PICAPI ps_canvas_get_damage(const ps_canvas* canvas, ps_rect* rects, unsigned int max);
+
+/**
+ * \fn void ps_canvas_reset_damage(ps_canvas* canvas)
+ * \brief Clear the damage areas of the canvas, usually after the changed areas are presented.
+ *
+ * \param canvas  Pointer to an existing canvas object.
+ *
+ * \sa ps_canvas_get_damage
+ */
+PEXPORT void PICAPI ps_canvas_reset_damage(ps_canvas* canvas);
 /** @} end of canvas functions*/
 
 /**
@@ -1844,6 +2000,105 @@ PEXPORT void PICAPI ps_restore(ps_context* ctx);
 
 /** @} end of state functions*/
 
+/**
+ * \defgroup picture Picture
+ * @{
+ */
+/**
+ * \fn ps_picture* ps_begin_record(ps_context* ctx)
+ * \brief Begin to record the drawing commands of the context into a new picture.
+ *
+ * \param ctx  Pointer to an existing context object.
+ *
+ * \return If the function succeeds, the return value is the pointer to a new picture object.
+ *         If the function fails, the return value is NULL.
+ *
+ * \note While recording, stroke, fill, paint, clear and text drawing of the context
+ *       are captured into the picture with the current graphics state, and nothing is drawn
+ *       to the canvas. The picture is in the device space of the canvas, and it is clipped by
+ *       the clip region when the command is recorded. To get extended error information,
+ *       call \a ps_last_status.
+ *
+ * \sa ps_end_record, ps_draw_picture, ps_picture_ref, ps_picture_unref
+ */
+PEXPORT ps_picture* PICAPI ps_begin_record(ps_context* ctx);
+
+/**
+ * \fn void ps_end_record(ps_context* ctx)
+ * \brief End recording of the context, the drawing commands will be drawn to canvas again.
+ *
+ * \param ctx  Pointer to an existing context object.
+ *
+ * \sa ps_begin_record, ps_draw_picture
+ */
+PEXPORT void PICAPI ps_end_record(ps_context* ctx);
+
+/**
+ * \fn void ps_draw_picture(ps_context* ctx, const ps_picture* picture, const ps_matrix* matrix)
+ * \brief Draw the recorded commands of a picture.
+ *
+ * \param ctx      Pointer to an existing context object.
+ * \param picture  Pointer to an existing picture object.
+ * \param matrix   A matrix transform the picture to the user space of context. If no transform needed, pass NULL.
+ *
+ * \note The commands are drawn with their recorded states, transformed by the matrix and the current transform
+ *       matrix of context, the alpha value and clip region of context are applied too. If the context is
+ *       recording, the commands are recorded into its picture.
+ *
+ * \sa ps_begin_record, ps_end_record
+ */
+PEXPORT void PICAPI ps_draw_picture(ps_context* ctx, const ps_picture* picture, const ps_matrix* matrix);
+
+/**
+ * \fn void ps_draw_picture_parallel(ps_context* ctx, const ps_picture* picture, const ps_matrix* matrix,
+ *                                                     unsigned int tile_size, unsigned int threads)
+ * \brief Draw the recorded commands of a picture by tiles on multiple threads.
+ *
+ * \param ctx        Pointer to an existing context object.
+ * \param picture    Pointer to an existing picture object.
+ * \param matrix     A matrix transform the picture to the user space of context. If no transform needed, pass NULL.
+ * \param tile_size  The width and height of tiles in pixels, 0 use default size (256).
+ * \param threads    The number of threads to draw, include the calling thread. 0 use the number of processors.
+ *
+ * \note The canvas is divided into tiles, every tile draws the commands which bounding box intersect it,
+ *       clipped by the tile. Tiles are shared by the threads until all done, and the function returns after
+ *       all tiles are drawn. The result is same as \a ps_draw_picture. The picture is drawn on the calling
+ *       thread when it must be drawn in whole, such as commands with blur, a canvas with mask, or the
+ *       context is recording.
+ *
+ * \sa ps_draw_picture, ps_begin_record
+ */
+PEXPORT void PICAPI ps_draw_picture_parallel(ps_context* ctx, const ps_picture* picture, const ps_matrix* matrix,
+                                                                    unsigned int tile_size, unsigned int threads);
+
+/**
+ * \fn ps_picture* ps_picture_ref(ps_picture* picture)
+ * \brief Increases the reference count of the picture by 1.
+ *
+ * \param picture  Pointer to an existing picture object.
+ *
+ * \return If the function succeeds, the return value is the pointer to the picture object.
+ *         If the function fails, the return value is NULL.
+ *
+ * \note To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_begin_record, ps_picture_unref
+ */
+PEXPORT ps_picture* PICAPI ps_picture_ref(ps_picture* picture);
+
+/**
+ * \fn void ps_picture_unref(ps_picture* picture)
+ * \brief Decrements the reference count for the picture object.
+ *        If the reference count on the picture falls to 0, the picture is freed.
+ *
+ * \param picture  Pointer to an existing picture object.
+ *
+ * \sa ps_begin_record, ps_picture_ref
+ */
+PEXPORT void PICAPI ps_picture_unref(ps_picture* picture);
+
+/** @} end of picture functions*/
+
 /** @} end of drawing functions*/
 
 /**
@@ -2074,6 +2329,59 @@ PEXPORT ps_bool PICAPI ps_get_font_info(ps_context* ctx, ps_font_info* info);
  */
 PEXPORT ps_font* PICAPI ps_set_font(ps_context* ctx, const ps_font* font);
 
+/**
+ * \fn void ps_set_glyph_cache_size(unsigned int bytes)
+ * \brief Set the memory budget of the glyph cache shared by all contexts.
+ *
+ * \param bytes  The maximum bytes of glyph caches which are not used by any font.
+ *
+ * \note Glyph caches are shared process wide by the fonts which have same attributes.
+ *       The caches used by fonts are not counted in the budget and never freed, the least
+ *       recently used caches of the others will be freed when over the budget.
+ *       To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_set_font
+ */
+PEXPORT void PICAPI ps_set_glyph_cache_size(unsigned int bytes);
+
+/**
+ * \brief A range of character codes.
+ */
+typedef struct _ps_unicode_range {
+    /**
+     * The first character code of the range.
+     */
+    unsigned int first;
+    /**
+     * The last character code of the range, inclusive.
+     */
+    unsigned int last;
+}ps_unicode_range;
+
+/**
+ * \fn ps_bool ps_font_preload(const ps_font* font, const ps_unicode_range* ranges,
+ *                                                   unsigned int count, ps_bool antialias)
+ * \brief Load glyphs of the font into glyph cache on a background thread.
+ *
+ * \param font       Pointer to an existing font object.
+ * \param ranges     The array of character ranges to be loaded.
+ * \param count      The length of the array.
+ * \param antialias  The text antialias mode of the contexts which will draw the glyphs.
+ *
+ * \return  True if the loading is started, otherwise False.
+ *
+ * \note The glyphs are shared by the contexts which draw text with the same font, antialias
+ *       mode and an identity text matrix. For antialias mode, the coverage masks of glyphs are
+ *       prepared too. Loading stops when the glyph data of the font reaches the cache budget
+ *       of a font, so the glyphs loaded before are not evicted by it. The font and ranges can
+ *       be freed after return, loading still in progress will be cancelled by \a ps_shutdown.
+ *       To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_set_glyph_cache_size, ps_set_text_antialias
+ */
+PEXPORT ps_bool PICAPI ps_font_preload(const ps_font* font, const ps_unicode_range* ranges,
+                                                        unsigned int count, ps_bool antialias);
+
 /** @} end of font functions*/
 
 /**
@@ -2110,7 +2418,8 @@ typedef enum _ps_text_type {
  * \return If the function succeeds, the return value is the size of the text.
  *         If the function fails, the return value is (0,0).
  *
- * \note To get extended error information, call \a ps_last_status.
+ * \note The width includes kerning when it is enabled by \a ps_set_text_kerning.
+ *       To get extended error information, call \a ps_last_status.
  *
  * \sa ps_glyph_get_extent
  */
@@ -2323,6 +2632,24 @@ PEXPORT ps_bool PICAPI ps_get_glyph(ps_context* ctx, int ch, ps_glyph* glyph);
 PEXPORT void PICAPI ps_show_glyphs(ps_context* ctx, float x, float y,
                                                     ps_glyph* glyphs, unsigned int length);
 
+/**
+ * \fn void ps_draw_glyph_run(ps_context* ctx, const unsigned int* glyph_ids,
+ *                                          const ps_point* positions, unsigned int count)
+ * \brief Draw a run of pre-shaped glyphs, using font object which is selected in graphic context.
+ *
+ * \param ctx        Pointer to an existing context object.
+ * \param glyph_ids  The array of glyph indices in the font, not character codes.
+ * \param positions  The array of glyph origins on the baseline in user space.
+ * \param count      The length of the arrays.
+ *
+ * \note Glyphs are drawn exactly at the given positions, no character mapping,
+ *       kerning or advance is applied.
+ *
+ * \sa ps_show_glyphs, ps_text_out_length
+ */
+PEXPORT void PICAPI ps_draw_glyph_run(ps_context* ctx, const unsigned int* glyph_ids,
+                                                const ps_point* positions, unsigned int count);
+
 /**
  * \fn ps_bool ps_get_path_from_glyph(ps_context* ctx, const ps_glyph* glyph, ps_path* path)
  * \brief Get the path from a given glyph object.
@@ -3394,7 +3721,146 @@ typedef enum _ps_path_op {
 PEXPORT void PICAPI ps_path_clipping(ps_path* result, ps_path_operation op,
                                                 const ps_path* a, const ps_path* b);
 
+/**
+ * \fn void ps_path_union_many(ps_path* result, ps_path* const* paths, unsigned int num)
+ *
+ * \brief Union a number of paths in one operation and get the result path.
+ *
+ * \param result  Pointer to an existing path object for result, it can be one of the paths.
+ * \param paths   An array of the paths for union.
+ * \param num     The number of the paths in array.
+ *
+ * \note Empty or unclosed paths are ignored. The result is the same region as calling
+ *       \a ps_path_clipping repeatedly with PATH_OP_UNION, each path filled by the even-odd
+ *       rule. All paths are merged in one sweep line pass, in O((n + k) log n) for n edges
+ *       and k intersections, instead of one clipping per path. Vertices are snapped to an
+ *       integer grid of 2^30 steps over the bounds of all paths, so a vertex may move by
+ *       that step and crossing points are rounded to it.
+ *
+ * \sa ps_path_clipping, ps_path_get_vertex, ps_path_get_vertex_count
+ */
+PEXPORT void PICAPI ps_path_union_many(ps_path* result, ps_path* const* paths, unsigned int num);
+
 /** @} end of path functions*/
+
+/**
+ * \defgroup stats Statistics
+ * @{
+ */
+/**
+ * \brief Counters and timers of the rendering pipeline.
+ */
+typedef struct _ps_stats {
+    /** Vertices fed to rasterizers after flattening and stroking. */
+    unsigned long long vertices;
+    /** Cells generated by rasterizers. */
+    unsigned long long cells;
+    /** Cells sorted by rasterizers. */
+    unsigned long long sorted_cells;
+    /** Scanlines swept. */
+    unsigned long long scanlines;
+    /** Spans swept. */
+    unsigned long long spans;
+    /** Pixels blended, by the composite operation in use. */
+    unsigned long long composite_pixels[COMPOSITE_ERROR];
+    /** Glyphs found in glyph caches. */
+    unsigned long long glyph_hits;
+    /** Glyphs loaded from fonts. */
+    unsigned long long glyph_misses;
+    /** Clipping masks built. */
+    unsigned long long clip_rebuilds;
+    /** Shadows blurred. */
+    unsigned long long shadow_blurs;
+    /** Nanoseconds preparing the vertices of filled shapes. */
+    unsigned long long flatten_ns;
+    /** Nanoseconds stroking and dashing. */
+    unsigned long long stroke_ns;
+    /** Nanoseconds generating cells. */
+    unsigned long long cells_ns;
+    /** Nanoseconds sorting cells. */
+    unsigned long long sort_ns;
+    /** Nanoseconds sweeping scanlines. */
+    unsigned long long sweep_ns;
+    /** Nanoseconds generating spans and blending pixels. */
+    unsigned long long blend_ns;
+}ps_stats;
+
+/**
+ * \fn void ps_enable_stats(ps_bool enable)
+ * \brief Enable or disable the collecting of rendering statistics on the calling thread.
+ *
+ * \param enable  True to collect statistics, False to stop. (Default is False)
+ *
+ * \note Statistics are collected for the drawing of the calling thread, with a small cost to
+ *       each drawing while enabled. Other threads enable their own. Disabling keeps the counters,
+ *       call \a ps_reset_stats to clear them. To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_get_stats, ps_reset_stats
+ */
+PEXPORT void PICAPI ps_enable_stats(ps_bool enable);
+
+/**
+ * \fn ps_bool ps_get_stats(ps_stats* stats)
+ * \brief Return the rendering statistics collected by the calling thread.
+ *
+ * \param stats  Pointer to a structure to receiving the statistics.
+ *
+ * \return  True if is success, otherwise False.
+ *
+ * \note Counters are kept for each thread, the tiles drawn by the worker threads of
+ *       \a ps_draw_picture_parallel are added to the calling thread when it returns.
+ *       Flattening curves while a path is built is not timed, flatten_ns covers transforming
+ *       and flattening done when the shape is drawn. To get extended error information,
+ *       call \a ps_last_status.
+ *
+ * \sa ps_enable_stats, ps_reset_stats
+ */
+PEXPORT ps_bool PICAPI ps_get_stats(ps_stats* stats);
+
+/**
+ * \fn void ps_reset_stats(void)
+ * \brief Clear the rendering statistics of the calling thread.
+ *
+ * \note To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_enable_stats, ps_get_stats
+ */
+PEXPORT void PICAPI ps_reset_stats(void);
+
+/** @} end of stats functions*/
+
+/**
+ * \defgroup trace Trace
+ * @{
+ */
+/**
+ * \fn ps_bool ps_trace_start(const char* file_name)
+ * \brief Start writing trace events of drawing to a file.
+ *
+ * \param file_name  The path of the file to be written, it will be replaced if it exists.
+ *
+ * \return  True if is success, otherwise False.
+ *
+ * \note The file is in Chrome trace event format, open it in chrome://tracing or other
+ *       trace viewers. Begin and end events are written for fill, stroke, paint, text,
+ *       clip, shadow and blur, end events carry the path vertices or the number of glyphs
+ *       and the device bounds of the drawing. Drawings of all threads are traced. Only one trace can be written
+ *       at a time, STATUS_NOT_SUPPORT is set if a trace is running.
+ *       To get extended error information, call \a ps_last_status.
+ *
+ * \sa ps_trace_stop
+ */
+PEXPORT ps_bool PICAPI ps_trace_start(const char* file_name);
+
+/**
+ * \fn void ps_trace_stop(void)
+ * \brief Stop writing trace events and close the trace file.
+ *
+ * \sa ps_trace_start
+ */
+PEXPORT void PICAPI ps_trace_stop(void);
+
+/** @} end of trace functions*/
 /** @} end of graphic functions*/
 
 #ifdef __cplusplus
@@ -34,6 +34,7 @@ objects= \
 		picasso_image.o \
 		picasso_pattern.o \
 		picasso_path.o \
+		picasso_picture.o \
 		picasso_gradient.o \
 		picasso_gradient_api.o \
 		picasso_font.o \
@@ -41,6 +42,8 @@ objects= \
 		picasso_gpc.o \
 		picasso_mask.o \
 		picasso_mask_api.o \
+		picasso_sweep.o \
+		picasso_trace.o \
 		picasso_api.o
 
 all: libpicasso.a
@@ -122,6 +122,24 @@ public:
         return m_vertices.size() * sizeof(vertex_s) + m_cmds.size() * sizeof(unsigned int);
     }
 
+    unsigned int capacity(void) const
+    {
+        return m_vertices.capacity();
+    }
+
+    unsigned int capacity_byte_size(void) const
+    {
+        return m_vertices.capacity() * sizeof(vertex_s) + m_cmds.capacity() * sizeof(unsigned int);
+    }
+
+    void copy_vertices(const graphic_path_impl& o)
+    {
+        for (unsigned int i = 0; i < o.total_vertices(); i++) {
+            m_vertices.push_back(o.m_vertices[i]);
+            m_cmds.push_back(o.m_cmds[i]);
+        }
+    }
+
     unsigned int vertex(unsigned int idx, scalar* x, scalar* y) const
     {
         const vertex_s & v = m_vertices[idx];
@@ -187,6 +205,19 @@ void graphic_path::free_all(void)
     remove_all();
 }
 
+void graphic_path::trim(void)
+{
+    unsigned int num = Max(m_impl->total_vertices(), (unsigned int)DEFAULT_VERTEICES);
+    if (m_impl->capacity() > num) {
+        graphic_path_impl* impl = new graphic_path_impl(num);
+        if (impl) {
+            impl->copy_vertices(*m_impl);
+            delete m_impl;
+            m_impl = impl;
+        }
+    }
+}
+
 unsigned int graphic_path::start_new_path(void)
 {
     if (!is_stop(m_impl->last_command())) {
@@ -409,6 +440,11 @@ unsigned int graphic_path::total_byte_size(void) const
     return m_impl->total_byte_size();
 }
 
+unsigned int graphic_path::capacity_byte_size(void) const
+{
+    return m_impl->capacity_byte_size();
+}
+
 void graphic_path::rel_to_abs(scalar* x, scalar* y) const
 {
     if (m_impl->total_vertices()) {
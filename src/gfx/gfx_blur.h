@@ -229,6 +229,17 @@ public:
         blur_x(img2, radius);
     }
 
+    void free_all(void)
+    {
+        m_buffer.remove_all();
+        m_stack.remove_all();
+    }
+
+    unsigned int byte_size(void) const
+    {
+        return (m_buffer.capacity() + m_stack.capacity()) * sizeof(color_type);
+    }
+
 private:
     stack_blur(const stack_blur&);
     stack_blur& operator=(const stack_blur&);
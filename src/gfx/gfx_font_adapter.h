@@ -33,8 +33,10 @@ public:
     virtual void deactive(void);
 
     virtual bool prepare_glyph(unsigned int code);
+    virtual bool prepare_glyph_index(unsigned int index);
     virtual void write_glyph_to(byte* buffer);
     virtual void add_kerning(unsigned int f, unsigned int s, scalar* x, scalar* y);
+    virtual bool glyph_advance(unsigned int code, unsigned int* index, scalar* x, scalar* y);
 
     virtual unsigned int glyph_index(void) const; 
     virtual unsigned int data_size(void) const;
@@ -47,6 +49,7 @@ public:
     virtual void destroy_storage(void*);
     virtual void translate_storage(void*, scalar x, scalar y);
 private:
+    bool load_glyph(unsigned int code, bool by_index);
     void load_kerning_pairs(void);
     void sort_kerning_pairs(void);
     font_adapter_impl* m_impl;
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include "common.h"
 #include "convert.h"
+#include "thread_lock.h"
 #include "gfx_font_adapter.h"
 #include "gfx_rasterizer_scanline.h"
 #include "gfx_scanline.h"
@@ -18,6 +19,8 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_OUTLINE_H
+#include FT_SIZES_H
+#include FT_ADVANCES_H
 #include "graphic_path.h"
 #include "graphic_helper.h"
 #include "graphic_base.h"
@@ -25,13 +28,22 @@
 namespace gfx {
 
 extern FT_Library g_library;
-extern char * _font_by_name(const char* face);
+extern const char* _font_by_name(const char* face);
+extern FT_Face _face_by_path(const char* path);
+
+// shared face must be used in lock.
+static inline thread_lock& face_lock(FT_Face face)
+{
+    return *static_cast<thread_lock*>(face->generic.data);
+}
 
 class font_adapter_impl
 {
 public:
     font_adapter_impl()
         : font(0)
+        , size(0)
+        , charmap(0)
         , antialias(false)
         , flip_y(false)
         , hinting(false)
@@ -48,19 +60,31 @@ public:
         , cur_bound_rect(0,0,0,0)
         , cur_advance_x(0)
         , cur_advance_y(0)
-
+        , cur_sys_bitmap(false)
     {
     }
 
     ~font_adapter_impl()
     {
-        if (font) {
-            FT_Done_Face(font);
-            font = 0;
+        if (font && size) {
+            scoped_lock lock(face_lock(font));
+            FT_Done_Size(size);
         }
+        size = 0;
+        font = 0; // shared face, not owner.
+    }
+
+    // face is shared by adapters, switch to own size and charmap.
+    void use_face(void)
+    {
+        FT_Activate_Size(size);
+        if (charmap && (font->charmap != charmap))
+            FT_Set_Charmap(font, charmap);
     }
     
     FT_Face font;
+    FT_Size size;
+    FT_CharMap charmap;
     bool antialias;
     bool flip_y;
     bool hinting;
@@ -80,6 +104,7 @@ public:
     rect cur_bound_rect;
     scalar cur_advance_x;
     scalar cur_advance_y;
+    bool cur_sys_bitmap;
     picasso::graphic_path cur_font_path;
     gfx_scanline_storage_bin cur_font_scanlines_bin;
     gfx_serialized_scanlines_adaptor_bin cur_font_storage_bin;
@@ -94,10 +119,16 @@ gfx_font_adapter::gfx_font_adapter(const char* name, int charset, scalar height,
     m_impl->flip_y = flip;
     m_impl->hinting = hint;
     m_impl->weight = weight;
-    int error = FT_New_Face(m_impl->library, _font_by_name(name), 0, &m_impl->font);
-    if ((error == 0) && m_impl->font) {
-        FT_Set_Pixel_Sizes(m_impl->font, 0, uround(height*FLT_TO_SCALAR(64.0f))>>6);
-        FT_Select_Charmap(m_impl->font, char_set);
+    FT_Face face = _face_by_path(_font_by_name(name));
+    if (face) {
+        scoped_lock lock(face_lock(face));
+        if (FT_New_Size(face, &m_impl->size) == 0) {
+            m_impl->font = face;
+            FT_Activate_Size(m_impl->size);
+            FT_Set_Pixel_Sizes(m_impl->font, 0, uround(height*FLT_TO_SCALAR(64.0f))>>6);
+            FT_Select_Charmap(m_impl->font, char_set);
+            m_impl->charmap = m_impl->font->charmap;
+        }
     }
     m_impl->matrix = *static_cast<gfx_trans_affine*>(const_cast<abstract_trans_affine*>(mtx));
     if (italic)
@@ -106,6 +137,8 @@ gfx_font_adapter::gfx_font_adapter(const char* name, int charset, scalar height,
     m_impl->height = height;
 
     if (m_impl->font) {
+        scoped_lock lock(face_lock(m_impl->font));
+        m_impl->use_face();
         scalar top_base = FLT_TO_SCALAR(fabsf(m_impl->font->ascender * m_impl->height / m_impl->font->height));
         scalar top_leading = FLT_TO_SCALAR((m_impl->font->height - 
               (abs(m_impl->font->ascender) + abs(m_impl->font->descender))) * m_impl->height / m_impl->font->height);
@@ -140,10 +173,14 @@ void gfx_font_adapter::add_kerning(unsigned int first, unsigned int second, scal
 {
     if (m_impl->font && first && second && FT_HAS_KERNING(m_impl->font)) {
         FT_Vector delta;
-        FT_Get_Kerning(m_impl->font, first, second, FT_KERNING_DEFAULT, &delta);
+        {
+            scoped_lock lock(face_lock(m_impl->font));
+            m_impl->use_face();
+            FT_Get_Kerning(m_impl->font, first, second, FT_KERNING_DEFAULT, &delta);
+        }
         scalar dx = int26p6_to_flt(delta.x);
         scalar dy = int26p6_to_flt(delta.y);
-        if (m_impl->font->glyph->format != FT_GLYPH_FORMAT_BITMAP)
+        if (!m_impl->cur_sys_bitmap)
             m_impl->matrix.transform_2x2(&dx, &dy);
         *x += dx;
         *y += dy;
@@ -418,10 +455,50 @@ static void decompose_ft_bitmap_mono(const FT_Bitmap& bitmap, int x, int y,
     }
 }
 
+bool gfx_font_adapter::glyph_advance(unsigned int code, unsigned int* index, scalar* x, scalar* y)
+{
+    // embedded bitmap strikes advance differently from outlines, they are measured by loading glyph.
+    if (m_impl->font && !FT_HAS_FIXED_SIZES(m_impl->font)) {
+        FT_Fixed advance = 0;
+        FT_UInt glyph_index = 0;
+        {
+            scoped_lock lock(face_lock(m_impl->font));
+            m_impl->use_face();
+
+            glyph_index = FT_Get_Char_Index(m_impl->font, code);
+            // hinted advance load the glyph metrics only, unhinted one read from metrics table.
+            if (FT_Get_Advance(m_impl->font, glyph_index,
+                        m_impl->hinting ? FT_LOAD_DEFAULT : FT_LOAD_NO_HINTING, &advance))
+                return false;
+        }
+
+        *index = glyph_index;
+        *x = FLT_TO_SCALAR(int26p6_to_flt((advance + 512) >> 10)); // 16.16 to 26.6
+        *y = 0;
+        // face without bitmap strikes is scalable, transformed same as glyphs prepared.
+        m_impl->matrix.transform(x, y);
+        return true;
+    }
+    return false;
+}
+
 bool gfx_font_adapter::prepare_glyph(unsigned int code)
+{
+    return load_glyph(code, false);
+}
+
+bool gfx_font_adapter::prepare_glyph_index(unsigned int index)
+{
+    return load_glyph(index, true);
+}
+
+bool gfx_font_adapter::load_glyph(unsigned int code, bool by_index)
 {
     if (m_impl->font) {
-        m_impl->cur_glyph_index = FT_Get_Char_Index(m_impl->font, code);
+        scoped_lock lock(face_lock(m_impl->font));
+        m_impl->use_face();
+
+        m_impl->cur_glyph_index = by_index ? code : FT_Get_Char_Index(m_impl->font, code);
 
         int error = FT_Load_Glyph(m_impl->font, m_impl->cur_glyph_index, 
                                  m_impl->hinting ? FT_LOAD_DEFAULT : FT_LOAD_NO_HINTING);
@@ -429,6 +506,7 @@ bool gfx_font_adapter::prepare_glyph(unsigned int code)
         bool is_sys_bitmap = false;
         if (m_impl->font->glyph->format == FT_GLYPH_FORMAT_BITMAP)
             is_sys_bitmap = true;
+        m_impl->cur_sys_bitmap = is_sys_bitmap;
 
         if (error == 0) {
             if (m_impl->antialias && !is_sys_bitmap) {
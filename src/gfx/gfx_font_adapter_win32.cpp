@@ -384,12 +384,40 @@ static rect get_bounding_rect(graphic_path& path)
 #define GGO_UNHINTED 0x0100
 #endif
 
+bool gfx_font_adapter::glyph_advance(unsigned int code, unsigned int* index, scalar* x, scalar* y)
+{
+    if (m_impl->dc) {
+        GLYPHMETRICS gm;
+        if (GetGlyphOutlineW(m_impl->dc, code, GGO_METRICS, &gm, 0, 0, &m_impl->mat) == GDI_ERROR)
+            return false;
+
+        *index = code;
+        *x = INT_TO_SCALAR(gm.gmCellIncX);
+        *y = -INT_TO_SCALAR(gm.gmCellIncY);
+        if (m_impl->antialias)
+            m_impl->matrix.transform(x, y);
+        return true;
+    }
+    return false;
+}
+
 bool gfx_font_adapter::prepare_glyph(unsigned int code)
+{
+    return load_glyph(code, false);
+}
+
+bool gfx_font_adapter::prepare_glyph_index(unsigned int index)
+{
+    return load_glyph(index, true);
+}
+
+bool gfx_font_adapter::load_glyph(unsigned int code, bool by_index)
 {
     if (m_impl->dc) {
 
         bool sys_bitmap = false;
         int format = GGO_NATIVE;
+        int index_flag = by_index ? GGO_GLYPH_INDEX : 0;
 
         if (!m_impl->antialias && m_impl->matrix.is_identity()) { //matrix is identity
             sys_bitmap = true;
@@ -399,10 +427,10 @@ bool gfx_font_adapter::prepare_glyph(unsigned int code)
         if(!m_impl->hinting) format |= GGO_UNHINTED;
 
         GLYPHMETRICS gm;
-        int total_size = GetGlyphOutlineW(m_impl->dc, code, format, &gm, 
+        int total_size = GetGlyphOutlineW(m_impl->dc, code, format | index_flag, &gm, 
                                     m_impl->buf_size, m_impl->buf, &m_impl->mat);
         if (total_size < 0) {
-            int total_size = GetGlyphOutlineW(m_impl->dc, code, GGO_METRICS, &gm,
+            int total_size = GetGlyphOutlineW(m_impl->dc, code, GGO_METRICS | index_flag, &gm,
                                         m_impl->buf_size, m_impl->buf, &m_impl->mat);
 
             if(total_size < 0) 
@@ -548,4 +576,10 @@ void platform_font_shutdown(void)
     // win32 do nothing
 }
 
+unsigned int platform_font_bytes(void)
+{
+    // fonts are owned by the system.
+    return 0;
+}
+
 #endif /* WIN32 */
@@ -5,14 +5,23 @@
  */
 
 #include "common.h"
+#include "thread_lock.h"
 #include "picasso_global.h"
 
 #if ENABLE(FREE_TYPE2)
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if !defined(WINCE) && !defined(WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #if defined(WINCE) || defined(WIN32)
 #define strncasecmp _strnicmp
 #endif
@@ -84,13 +93,30 @@ struct font_item {
 };
 
 /*
- * Note : _load_fonts function init the global font map at initialize time.
- * it only be call once and not need thread lock.
+ * Note : the font map is only used to collect fonts while enumerating,
+ * lookups are done on the font index built from it.
  */
 typedef picasso::pod_bvector<font_item*> font_map;
 
 static font_map g_font_map;
 
+// files which the font map is enumerated from.
+typedef picasso::pod_bvector<char*> source_list;
+
+static source_list g_source_list;
+
+static void add_font_source(const char* path)
+{
+    size_t len = strlen(path);
+    char* p = (char*)mem_malloc(len + 1);
+    if (p) {
+        mem_copy(p, path, len + 1);
+        g_source_list.add(p);
+    } else {
+        global_status = STATUS_OUT_OF_MEMORY;
+    }
+}
+
 static font_item* get_font_item(const char* name, const char* path)
 {
     font_item* f = (font_item*)mem_calloc(1, sizeof(font_item));
@@ -105,9 +131,30 @@ static font_item* get_font_item(const char* name, const char* path)
 }
 
 #if ENABLE(FONT_CONFIG)
+static bool g_fontconfig_loaded = false;
+
+static void add_fontconfig_sources(FcStrList* list)
+{
+    if (list) {
+        FcChar8* path = NULL;
+        while ((path = FcStrListNext(list)))
+            add_font_source((const char*)path);
+        FcStrListDone(list);
+    }
+}
+
 static void load_font_from_fontconfig(void)
 {
     FcConfig* config = FcInitLoadConfigAndFonts();
+    if (!config)
+        return;
+
+    g_fontconfig_loaded = true;
+
+    // any change of config files or font directories invalid the index.
+    add_fontconfig_sources(FcConfigGetConfigFiles(config));
+    add_fontconfig_sources(FcConfigGetFontDirs(config));
+
     FcFontSet* fontset = NULL;
     // get application fonts
     fontset = FcConfigGetFonts(config, FcSetApplication);
@@ -268,6 +315,10 @@ static void parse_config_file(const char* file, font_map& map)
 
 static void load_font_from_android(void)
 {
+    add_font_source(SYSTEM_FONTS_FILE);
+    add_font_source(FALLBACK_FONTS_FILE);
+    add_font_source(VENDOR_FONTS_FILE);
+
     parse_config_file(SYSTEM_FONTS_FILE, g_font_map);
     parse_config_file(FALLBACK_FONTS_FILE, g_font_map);
     parse_config_file(VENDOR_FONTS_FILE, g_font_map);
@@ -327,7 +378,377 @@ static void load_font_from_file(FILE * f)
 
 FT_Library g_library = 0;
 
-bool _load_fonts(void)
+/*
+ * Note : font files are opened once and shared by all font adapters,
+ * each adapter create it's own size object. the face is not thread safe,
+ * the lock in generic data of face must be hold when use it.
+ */
+struct font_face {
+    FT_Face face;
+    void* data;
+    size_t size;
+    char path[MAX_FONT_PATH_LENGTH];
+};
+
+typedef picasso::pod_bvector<font_face*> face_list;
+
+static face_list g_face_list;
+static picasso::thread_lock g_face_lock;
+
+static void* map_font_file(const char* path, size_t* size)
+{
+#if !defined(WINCE) && !defined(WIN32)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    void* data = 0;
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+            data = 0;
+        else
+            *size = st.st_size;
+    }
+    close(fd);
+    return data;
+#else
+    return 0;
+#endif
+}
+
+static void unmap_font_file(void* data, size_t size)
+{
+#if !defined(WINCE) && !defined(WIN32)
+    if (data)
+        munmap(data, size);
+#endif
+}
+
+static void free_face_lock(void* object)
+{
+    FT_Face face = (FT_Face)object;
+    delete static_cast<picasso::thread_lock*>(face->generic.data);
+}
+
+FT_Face _face_by_path(const char* path)
+{
+    if (!path)
+        return 0;
+
+    picasso::scoped_lock lock(g_face_lock);
+
+    for (unsigned int i = 0; i < g_face_list.size(); i++)
+        if (strncmp(path, g_face_list[i]->path, MAX_FONT_PATH_LENGTH-1) == 0)
+            return g_face_list[i]->face;
+
+    font_face* f = (font_face*)mem_calloc(1, sizeof(font_face));
+    if (!f) {
+        global_status = STATUS_OUT_OF_MEMORY;
+        return 0;
+    }
+
+    strncpy(f->path, path, MAX_FONT_PATH_LENGTH-1);
+
+    int error = 0;
+    f->data = map_font_file(path, &f->size);
+    if (f->data) 
+        error = FT_New_Memory_Face(g_library, (const FT_Byte*)f->data, (FT_Long)f->size, 0, &f->face);
+    else // fallback to stream from file.
+        error = FT_New_Face(g_library, path, 0, &f->face);
+
+    if (error || !f->face) {
+        unmap_font_file(f->data, f->size);
+        mem_free(f);
+        return 0;
+    }
+
+    f->face->generic.data = new picasso::thread_lock;
+    f->face->generic.finalizer = free_face_lock;
+
+    g_face_list.add(f);
+    return f->face;
+}
+
+unsigned int _font_face_bytes(void)
+{
+    picasso::scoped_lock lock(g_face_lock);
+
+    // only mapped files are counted, streamed faces are owned by freetype.
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < g_face_list.size(); i++)
+        total += (unsigned int)g_face_list[i]->size;
+    return total;
+}
+
+static void free_faces(void)
+{
+    for (unsigned int i = 0; i < g_face_list.size(); i++) {
+        FT_Done_Face(g_face_list[i]->face);
+        unmap_font_file(g_face_list[i]->data, g_face_list[i]->size);
+        mem_free(g_face_list[i]);
+    }
+
+    g_face_list.remove_all();
+}
+
+/*
+ * Note : fonts are enumerated at the first lookup instead of initialize time,
+ * the result is packed into a font index image. Where mmap is available the
+ * image is saved to a cache file, the next process maps it directly when
+ * none of the source files has been modified.
+ */
+#if !defined(WINCE) && !defined(WIN32)
+#define FONT_INDEX_CACHE 1
+#endif
+
+#define FONT_INDEX_MAGIC   0x58494650 // "PFIX"
+#define FONT_INDEX_VERSION 1
+
+struct index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t num_sources;
+    uint32_t num_fonts;
+    uint32_t reserved;
+};
+
+struct index_source {
+    long long mtime; // -1 if the file does not exist.
+    long long size;
+    uint32_t path;
+    uint32_t reserved;
+};
+
+struct index_font {
+    uint32_t name;
+    uint32_t path;
+};
+
+struct font_index {
+    void* data;
+    size_t size;
+    bool mapped;
+    const index_font* fonts;
+    uint32_t num_fonts;
+    const char* strings;
+};
+
+static font_index g_font_index;
+static bool g_font_loaded = false;
+static picasso::thread_lock g_font_lock;
+
+static uint32_t index_strings_offset(uint32_t num_sources, uint32_t num_fonts)
+{
+    return sizeof(index_header) + num_sources * sizeof(index_source) + num_fonts * sizeof(index_font);
+}
+
+static void stat_font_source(const char* path, long long* mtime, long long* size)
+{
+#if FONT_INDEX_CACHE
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        *mtime = (long long)st.st_mtime;
+        *size = (long long)st.st_size;
+        return;
+    }
+#endif
+    *mtime = -1;
+    *size = 0;
+}
+
+static uint32_t add_index_string(char* strings, uint32_t* pos, const char* str)
+{
+    uint32_t offset = *pos;
+    size_t len = strlen(str) + 1;
+    mem_copy(strings + offset, str, len);
+    *pos += (uint32_t)len;
+    return offset;
+}
+
+static bool build_font_index(font_index* index)
+{
+    uint32_t num_sources = g_source_list.size();
+    uint32_t num_fonts = g_font_map.size();
+    uint32_t strings_size = 0;
+
+    for (unsigned int i = 0; i < num_sources; i++)
+        strings_size += strlen(g_source_list[i]) + 1;
+
+    for (unsigned int i = 0; i < num_fonts; i++)
+        strings_size += strlen(g_font_map[i]->font_name) + strlen(g_font_map[i]->font_path) + 2;
+
+    uint32_t offset = index_strings_offset(num_sources, num_fonts);
+    uint32_t size = offset + strings_size;
+
+    byte* data = (byte*)mem_calloc(1, size);
+    if (!data) {
+        global_status = STATUS_OUT_OF_MEMORY;
+        return false;
+    }
+
+    index_header* header = (index_header*)data;
+    index_source* sources = (index_source*)(data + sizeof(index_header));
+    index_font* fonts = (index_font*)(sources + num_sources);
+    char* strings = (char*)(data + offset);
+    uint32_t pos = 0;
+
+    header->magic = FONT_INDEX_MAGIC;
+    header->version = FONT_INDEX_VERSION;
+    header->size = size;
+    header->num_sources = num_sources;
+    header->num_fonts = num_fonts;
+
+    for (unsigned int i = 0; i < num_sources; i++) {
+        stat_font_source(g_source_list[i], &sources[i].mtime, &sources[i].size);
+        sources[i].path = add_index_string(strings, &pos, g_source_list[i]);
+    }
+
+    for (unsigned int i = 0; i < num_fonts; i++) {
+        fonts[i].name = add_index_string(strings, &pos, g_font_map[i]->font_name);
+        fonts[i].path = add_index_string(strings, &pos, g_font_map[i]->font_path);
+    }
+
+    index->data = data;
+    index->size = size;
+    index->mapped = false;
+    index->fonts = fonts;
+    index->num_fonts = num_fonts;
+    index->strings = strings;
+    return true;
+}
+
+#if FONT_INDEX_CACHE
+static bool font_index_file(char* buf, size_t len)
+{
+    const char* file = getenv("PICASSO_FONT_CACHE");
+    if (file)
+        return file[0] && (snprintf(buf, len, "%s", file) < (int)len);
+
+#if ENABLE(FONT_CONFIG) || defined(__ANDROID__)
+    const char* dir = getenv("XDG_CACHE_HOME");
+    if (dir && dir[0])
+        return snprintf(buf, len, "%s/picasso-fonts.idx", dir) < (int)len;
+
+    dir = getenv("HOME");
+    if (dir && dir[0]) {
+        if (snprintf(buf, len, "%s/.cache", dir) >= (int)len)
+            return false;
+        mkdir(buf, 0700); // may be exist already.
+        return snprintf(buf, len, "%s/.cache/picasso-fonts.idx", dir) < (int)len;
+    }
+    return false;
+#else
+    // keep index with the config file.
+    return snprintf(buf, len, "%s", "font_config.idx") < (int)len;
+#endif
+}
+
+static bool check_font_index(const byte* data, size_t size)
+{
+    if (size < sizeof(index_header))
+        return false;
+
+    const index_header* header = (const index_header*)data;
+    if (header->magic != FONT_INDEX_MAGIC || header->version != FONT_INDEX_VERSION
+        || header->size != size || !header->num_fonts)
+        return false;
+
+    // counts are bounded by the file size before any offset is computed.
+    if (header->num_sources > size / sizeof(index_source) || header->num_fonts > size / sizeof(index_font))
+        return false;
+
+    uint32_t offset = index_strings_offset(header->num_sources, header->num_fonts);
+    if (offset >= size || data[size - 1] != 0)
+        return false;
+
+    uint32_t strings_size = size - offset;
+    const index_source* sources = (const index_source*)(data + sizeof(index_header));
+    const index_font* fonts = (const index_font*)(sources + header->num_sources);
+    const char* strings = (const char*)(data + offset);
+
+    for (unsigned int i = 0; i < header->num_fonts; i++)
+        if (fonts[i].name >= strings_size || fonts[i].path >= strings_size)
+            return false;
+
+    for (unsigned int i = 0; i < header->num_sources; i++) {
+        if (sources[i].path >= strings_size)
+            return false;
+
+        long long mtime, fsize;
+        stat_font_source(strings + sources[i].path, &mtime, &fsize);
+        if (mtime != sources[i].mtime || fsize != sources[i].size)
+            return false;
+    }
+    return true;
+}
+
+static bool load_font_index(font_index* index)
+{
+    char file[MAX_PATH_LEN];
+    if (!font_index_file(file, MAX_PATH_LEN))
+        return false;
+
+    size_t size = 0;
+    void* data = map_font_file(file, &size);
+    if (!data)
+        return false;
+
+    if (!check_font_index((const byte*)data, size)) {
+        unmap_font_file(data, size);
+        return false;
+    }
+
+    const index_header* header = (const index_header*)data;
+    index->data = data;
+    index->size = size;
+    index->mapped = true;
+    index->fonts = (const index_font*)((const byte*)data + sizeof(index_header)
+                                        + header->num_sources * sizeof(index_source));
+    index->num_fonts = header->num_fonts;
+    index->strings = (const char*)data + index_strings_offset(header->num_sources, header->num_fonts);
+    return true;
+}
+
+static void save_font_index(const font_index* index)
+{
+    char file[MAX_PATH_LEN];
+    char temp[MAX_PATH_LEN];
+    if (!font_index_file(file, MAX_PATH_LEN))
+        return;
+
+    // write to a temp file and rename, readers never see partial data.
+    if (snprintf(temp, MAX_PATH_LEN, "%s.%d", file, (int)getpid()) >= MAX_PATH_LEN)
+        return;
+
+    FILE* pf = fopen(temp, "wb");
+    if (!pf)
+        return;
+
+    bool done = fwrite(index->data, 1, index->size, pf) == index->size;
+    done = (fclose(pf) == 0) && done;
+
+    if (!done || rename(temp, file) != 0)
+        unlink(temp);
+}
+#endif /* FONT_INDEX_CACHE */
+
+static void free_font_map(void)
+{
+    for (unsigned int i = 0; i < g_font_map.size(); i++)
+        mem_free(g_font_map[i]);
+
+    g_font_map.remove_all();
+
+    for (unsigned int i = 0; i < g_source_list.size(); i++)
+        mem_free(g_source_list[i]);
+
+    g_source_list.remove_all();
+}
+
+static void enum_fonts(void)
 {
 #if ENABLE(FONT_CONFIG)
     load_font_from_fontconfig();
@@ -346,6 +767,9 @@ bool _load_fonts(void)
         // not found config file.
         write_default();
     }
+#if !defined(WINCE)
+    add_font_source(CONFIG_FILE);
+#endif
 #endif
 
     if (!g_font_map.size()) {
@@ -356,7 +780,28 @@ bool _load_fonts(void)
         g_font_map.add(uni_font);
         g_font_map.add(ansi_font);
     }
+}
+
+static bool load_fonts_index(void)
+{
+#if FONT_INDEX_CACHE
+    if (load_font_index(&g_font_index))
+        return true;
+#endif
+
+    enum_fonts();
+    bool done = build_font_index(&g_font_index);
+    free_font_map();
+
+#if FONT_INDEX_CACHE
+    if (done)
+        save_font_index(&g_font_index);
+#endif
+    return done;
+}
 
+bool _load_fonts(void)
+{
     if (FT_Init_FreeType(&g_library) == 0)
         return true;
     else
@@ -365,40 +810,64 @@ bool _load_fonts(void)
 
 void _free_fonts(void)
 {
+    free_faces();
+
     if (g_library)
         FT_Done_FreeType(g_library);
 
-    for (unsigned int i = 0; i < g_font_map.size(); i++)
-        mem_free(g_font_map[i]);
+    g_library = 0;
 
-    g_font_map.remove_all();
+    if (g_font_index.data) {
+#if FONT_INDEX_CACHE
+        if (g_font_index.mapped)
+            unmap_font_file(g_font_index.data, g_font_index.size);
+        else
+#endif
+            mem_free(g_font_index.data);
+    }
+
+    memset(&g_font_index, 0, sizeof(font_index));
+    g_font_loaded = false;
+
+#if ENABLE(FONT_CONFIG)
+    if (g_fontconfig_loaded)
+        FcFini();
+    g_fontconfig_loaded = false;
+#endif
 }
 
-char * _font_by_name(const char* face)
+const char* _font_by_name(const char* face)
 {
-    for (unsigned int i = 0; i < g_font_map.size(); i++)
-        if (strncasecmp(face, g_font_map[i]->font_name, MAX_FONT_NAME_LENGTH-1) == 0)
-            return g_font_map[i]->font_path;
+    picasso::scoped_lock lock(g_font_lock);
+
+    if (!g_font_loaded) {
+        if (!load_fonts_index())
+            return 0;
+        g_font_loaded = true;
+    }
 
-    return g_font_map[0]->font_path;
+    for (unsigned int i = 0; i < g_font_index.num_fonts; i++)
+        if (strncasecmp(face, g_font_index.strings + g_font_index.fonts[i].name, MAX_FONT_NAME_LENGTH-1) == 0)
+            return g_font_index.strings + g_font_index.fonts[i].path;
+
+    return g_font_index.strings + g_font_index.fonts[0].path;
 }
 
 }
 
 bool platform_font_init(void)
 {
-#if ENABLE(FONT_CONFIG)
-    FcInit();    
-#endif
     return gfx::_load_fonts();
 }
 
 void platform_font_shutdown(void)
 {
     gfx::_free_fonts();
-#if ENABLE(FONT_CONFIG)
-    FcFini();
-#endif
+}
+
+unsigned int platform_font_bytes(void)
+{
+    return gfx::_font_face_bytes();
 }
 
 #endif /* FREE_TYPE2 */
@@ -9,6 +9,7 @@
 
 #include "common.h"
 #include "interfaces.h"
+#include "thread_lock.h"
 
 #include "gfx_pixfmt_wrapper.h"
 #include "gfx_span_generator.h"
@@ -205,8 +206,10 @@ public:
         m_matrix *= (*const_cast<gfx_trans_affine*>(m));
     }
 
-    void build(void) 
+    virtual void build(void) 
     {
+        // gradient can be used by contexts on different threads, built by the first one.
+        picasso::scoped_lock lock(m_lock);
         if (!m_build) {
             m_colors.build_table();
             m_build = true;
@@ -223,6 +226,7 @@ private:
     scalar m_start;
     scalar m_length;
     bool m_build;
+    picasso::thread_lock m_lock;
     gfx_trans_affine m_matrix;
     gfx_gradient_table m_colors;
 };
@@ -10,6 +10,8 @@
 #include "common.h"
 #include "interfaces.h"
 #include "convert.h"
+#include "memory_arena.h"
+#include "render_stats.h"
 
 #include "picasso.h"
 #include "picasso_painter.h"
@@ -76,9 +78,15 @@ public:
         , m_shadow_area(0,0,0,0)
         , m_shadow_buffer(0)
     {
+        for (int i = 0; i <= FILTER_GAUSSIAN; i++)
+            m_filters[i] = 0;
     }
 
-    virtual ~gfx_painter() {}
+    virtual ~gfx_painter()
+    {
+        for (int i = 0; i <= FILTER_GAUSSIAN; i++)
+            if (m_filters[i]) delete m_filters[i];
+    }
 
     virtual void attach(abstract_rendering_buffer*); 
     virtual pix_fmt pixel_format(void) const;
@@ -98,10 +106,12 @@ public:
     virtual void apply_fill(abstract_raster_adapter* raster);
     virtual void apply_text_fill(abstract_raster_adapter* rs, text_style style);
     virtual void apply_mono_text_fill(void * storage);
+    virtual void apply_text_mask(const byte* covers, int x, int y, unsigned int width, unsigned int height);
     virtual void apply_clear(const rgba& c);
     virtual void apply_clip_path(const vertex_source& v, int rule, const abstract_trans_affine* mtx);
     virtual void apply_clip_device(const rect_s& rc, scalar xoffset, scalar yoffset);
     virtual void clear_clip(void);
+    virtual void apply_bounds(const rect& rc);
 
     virtual void apply_masking(abstract_mask_layer*);
     virtual void clear_masking(void);
@@ -113,21 +123,44 @@ public:
                                                 const rgba& c, scalar x, scalar y, scalar b);
 
     virtual void copy_rect_from(abstract_rendering_buffer* src, const rect& rc, int x, int y);
+
+    virtual void memory_usage(memory_stats* s);
+    virtual void trim(void);
 private:
+    template <typename Wrapper>
+    pattern_wrapper<pixfmt>* arena_wrap(pixfmt& fmt)
+    {
+        void* p = m_arena.alloc(sizeof(Wrapper));
+        return p ? new (p) Wrapper(fmt) : 0;
+    }
+
+    // the wrapper lives in the arena, it is destroyed by the caller and the
+    // arena is reset when the fill is done.
     pattern_wrapper<pixfmt>* pattern_wrap(int xtype, int ytype, pixfmt& fmt)
     {
         pattern_wrapper<pixfmt>* p = 0;
         if ((xtype == WRAP_TYPE_REPEAT) && (ytype == WRAP_TYPE_REPEAT))
-            p = new pattern_wrapper_adaptor<pixfmt, wrap_mode_repeat, wrap_mode_repeat>(fmt);
+            p = arena_wrap<pattern_wrapper_adaptor<pixfmt, wrap_mode_repeat, wrap_mode_repeat> >(fmt);
         else if ((xtype == WRAP_TYPE_REPEAT) && (ytype == WRAP_TYPE_REFLECT))
-            p = new pattern_wrapper_adaptor<pixfmt, wrap_mode_repeat, wrap_mode_reflect>(fmt);
+            p = arena_wrap<pattern_wrapper_adaptor<pixfmt, wrap_mode_repeat, wrap_mode_reflect> >(fmt);
         else if ((xtype == WRAP_TYPE_REFLECT) && (ytype == WRAP_TYPE_REPEAT))
-            p = new pattern_wrapper_adaptor<pixfmt, wrap_mode_reflect, wrap_mode_repeat>(fmt);
+            p = arena_wrap<pattern_wrapper_adaptor<pixfmt, wrap_mode_reflect, wrap_mode_repeat> >(fmt);
         else if ((xtype == WRAP_TYPE_REFLECT) && (ytype == WRAP_TYPE_REFLECT))
-            p = new pattern_wrapper_adaptor<pixfmt, wrap_mode_reflect, wrap_mode_reflect>(fmt);
+            p = arena_wrap<pattern_wrapper_adaptor<pixfmt, wrap_mode_reflect, wrap_mode_reflect> >(fmt);
 
         return p;
     }
+
+    // filter weights are immutable, build each kind once per painter.
+    image_filter_adapter* image_filter(int filter)
+    {
+        if (filter < 0 || filter > FILTER_GAUSSIAN)
+            return 0;
+
+        if (!m_filters[filter])
+            m_filters[filter] = create_image_filter(filter);
+        return m_filters[filter];
+    }
     //fill
     source_type        m_fill_type; 
     rgba               m_fill_color;
@@ -146,6 +179,12 @@ private:
     gfx_rendering_buffer m_shadow_rb;
     pixfmt_rgba32        m_shadow_fmt;
     gfx_renderer<pixfmt_rgba32> m_shadow_base;
+    //blur stack buffers
+    stack_blur<rgba8> m_blur;
+    //image filters
+    image_filter_adapter* m_filters[FILTER_GAUSSIAN + 1];
+    //per draw temporaries
+    mem_arena m_arena;
     //scanline storage
     gfx_scanline_p8 m_scanline_p;
     gfx_scanline_u8 m_scanline_u;
@@ -173,6 +212,8 @@ template<typename Pixfmt>
 inline void gfx_painter<Pixfmt>::set_composite(comp_op op)
 {
     m_fmt.blend_op(op);
+    if (unlikely(global_stats_enabled))
+        global_stats.comp_op = op;
 }
 
 template<typename Pixfmt> 
@@ -259,6 +300,31 @@ inline void gfx_painter<Pixfmt>::apply_mono_text_fill(void * storage)
     gfx_render_scanlines(*storage_bin, sl, ren_solid);
 }
 
+template<typename Pixfmt> 
+inline void gfx_painter<Pixfmt>::apply_text_mask(const byte* covers, int x, int y, unsigned int width, unsigned int height)
+{
+    typename renderer_base_type::color_type color(m_font_fill_color);
+    if (unlikely(global_stats_enabled))
+        global_stats.pixels[global_stats.comp_op] += width * height;
+
+    for (unsigned int i = 0; i < height; i++) {
+        const byte* row = covers + i * width;
+        unsigned int n = 0;
+        while (n < width) {
+            // blend the runs of covered pixels only.
+            while (n < width && !row[n])
+                n++;
+
+            unsigned int start = n;
+            while (n < width && row[n])
+                n++;
+
+            if (n > start)
+                m_rb.blend_solid_hspan(x + start, y + i, n - start, color, row + start);
+        }
+    }
+}
+
 template<typename Pixfmt> 
 inline void gfx_painter<Pixfmt>::apply_text_fill(abstract_raster_adapter* raster, text_style render_type)
 {
@@ -309,14 +375,12 @@ inline void gfx_painter<Pixfmt>::apply_fill(abstract_raster_adapter* raster)
                 typename painter_raster<Pixfmt>::source_type img_src(canvas_fmt);
 
                 if (m_image_source.filter) {
-                    image_filter_adapter* filter = create_image_filter(m_image_source.filter);
+                    image_filter_adapter* filter = image_filter(m_image_source.filter);
 
                     typename painter_raster<Pixfmt>::span_canvas_filter_type
                         sg(img_src, interpolator, *(filter));
                     gfx_render_scanlines_aa(static_cast<gfx_raster_adapter*>(raster)->fill_impl(),
                                             m_scanline_u, m_rb, m_spans, sg);
-
-                    if (filter) delete filter;
                 } else {
                     typename painter_raster<Pixfmt>::span_canvas_filter_type_nn
                         sg(img_src, interpolator);
@@ -349,7 +413,7 @@ inline void gfx_painter<Pixfmt>::apply_fill(abstract_raster_adapter* raster)
                 typename painter_raster<Pixfmt>::source_type img_src(img_fmt);
 
                 if (m_image_source.filter) {
-                    image_filter_adapter* filter = create_image_filter(m_image_source.filter);
+                    image_filter_adapter* filter = image_filter(m_image_source.filter);
 
                     if (transparent) {
                         typename painter_raster<Pixfmt>::span_canvas_filter_type
@@ -362,8 +426,6 @@ inline void gfx_painter<Pixfmt>::apply_fill(abstract_raster_adapter* raster)
                         gfx_render_scanlines_aa(static_cast<gfx_raster_adapter*>(raster)->fill_impl(),
                                                 m_scanline_u, m_rb, m_spans, sg);
                     }
-
-                    if (filter) delete filter;
                 } else {
                     if (transparent) {
                         typename painter_raster<Pixfmt>::span_canvas_filter_type_nn
@@ -399,7 +461,7 @@ inline void gfx_painter<Pixfmt>::apply_fill(abstract_raster_adapter* raster)
                             pattern_wrap(m_pattern_source.xtype, m_pattern_source.ytype, pattern_fmt);
 
                 if (m_pattern_source.filter) {
-                    image_filter_adapter* filter = create_image_filter(m_pattern_source.filter);
+                    image_filter_adapter* filter = image_filter(m_pattern_source.filter);
 
                     if (transparent) {
                         typename painter_raster<Pixfmt>::span_canvas_pattern_type 
@@ -412,8 +474,6 @@ inline void gfx_painter<Pixfmt>::apply_fill(abstract_raster_adapter* raster)
                         gfx_render_scanlines_aa(static_cast<gfx_raster_adapter*>(raster)->fill_impl(), 
                                                 m_scanline_u, m_rb, m_spans, sg);
                     }
-
-                    if (filter) delete filter;
                 } else {
                     if (transparent) {
                         typename painter_raster<Pixfmt>::span_canvas_pattern_type_nn 
@@ -428,7 +488,8 @@ inline void gfx_painter<Pixfmt>::apply_fill(abstract_raster_adapter* raster)
                     }
                 }
 
-                delete pattern;
+                pattern->~pattern_wrapper<pixfmt>();
+                m_arena.reset();
             }
             break;
         case type_gradient:
@@ -470,6 +531,9 @@ inline void gfx_painter<Pixfmt>::apply_clip_path(const vertex_source& v, int rul
     gfx_trans_affine* m = static_cast<gfx_trans_affine*>(cm);
     conv_transform p(const_cast<vertex_source&>(v), m);
 
+    if (unlikely(global_stats_enabled))
+        global_stats.clip_rebuilds++;
+
     if (m_draw_shadow) { //in shadow draw context.
         m_shadow_base.add_clipping(p, (picasso::filling_rule)rule);
     } else {
@@ -502,8 +566,8 @@ inline void gfx_painter<Pixfmt>::apply_blur(scalar blur)
     if (blur > 0) {
         m_fmt.alpha(FLT_TO_SCALAR(1.0f));
         m_fmt.blend_op(comp_op_src_over);
-        stack_blur<rgba8> b;
-        b.blur(m_fmt, uround(blur * FLT_TO_SCALAR(40.0f)));
+        m_blur.set_shading(rgba8(0, 0, 0, 0));
+        m_blur.blur(m_fmt, uround(blur * FLT_TO_SCALAR(40.0f)));
     }
 }
 
@@ -516,6 +580,12 @@ inline void gfx_painter<Pixfmt>::clear_clip(void)
         m_rb.reset_clipping(true);
 }
 
+template<typename Pixfmt> 
+inline void gfx_painter<Pixfmt>::apply_bounds(const rect& rc)
+{
+    m_rb.bounds(rc);
+}
+
 template<typename Pixfmt> 
 inline void gfx_painter<Pixfmt>::apply_masking(abstract_mask_layer* m)
 {
@@ -536,13 +606,15 @@ inline bool gfx_painter<Pixfmt>::begin_shadow(const rect_s& rc)
 
     unsigned int w = uround(rc.x2 - rc.x1);
     unsigned int h = uround(rc.y2 - rc.y1);
-    m_shadow_buffer = (byte*)mem_calloc(1, h * w * 4);
+    m_shadow_buffer = (byte*)m_arena.alloc(h * w * 4);
 
     if (!m_shadow_buffer) {
         m_draw_shadow = false;
         return false;
     }
 
+    memset(m_shadow_buffer, 0, h * w * 4);
+
     m_shadow_rb.init(m_shadow_buffer, w, h, w * 4);
     m_shadow_fmt.attach(m_shadow_rb);
     m_shadow_base.attach(m_shadow_fmt);
@@ -568,18 +640,21 @@ inline void gfx_painter<Pixfmt>::apply_shadow(abstract_raster_adapter* rs,
     }
 
     if (blur > FLT_TO_SCALAR(0.0f)) {
-        stack_blur<rgba8> b;
-        b.set_shading(rgba8(c));
-        b.blur(m_shadow_fmt, uround(blur * FLT_TO_SCALAR(40.0f)));
+        if (unlikely(global_stats_enabled))
+            global_stats.shadow_blurs++;
+
+        m_blur.set_shading(rgba8(c));
+        m_blur.blur(m_shadow_fmt, uround(blur * FLT_TO_SCALAR(40.0f)));
     }
 
-    //Note: shadow need a no clip render base.
+    //Note: shadow need a no clip render base, only kept in device bounds.
     renderer_base_type rb(m_fmt); 
+    rb.bounds(m_rb.bounds());
     //blend shadow layer to base.
     rb.blend_from(m_shadow_fmt, 0, iround(x+r.x1), iround(y+r.y1));
 
     if (m_shadow_buffer) {
-        mem_free(m_shadow_buffer);
+        m_arena.reset();
         m_shadow_buffer = 0;
     }
     m_draw_shadow = false;
@@ -591,6 +666,28 @@ inline void gfx_painter<Pixfmt>::copy_rect_from(abstract_rendering_buffer* src,
     m_rb.copy_absolute_from(*static_cast<gfx_rendering_buffer*>(src), &rc, x, y);
 }
 
+template<typename Pixfmt> 
+inline void gfx_painter<Pixfmt>::memory_usage(memory_stats* s)
+{
+    s->raster += m_rb.clipping_byte_size() + m_shadow_base.clipping_byte_size();
+    s->scanline += m_scanline_p.byte_size() + m_scanline_u.byte_size() + m_scanline_bin.byte_size();
+    s->span += m_spans.byte_size();
+    s->shadow += m_arena.capacity() + m_blur.byte_size();
+}
+
+template<typename Pixfmt> 
+inline void gfx_painter<Pixfmt>::trim(void)
+{
+    m_rb.trim_clipping();
+    m_shadow_base.trim_clipping();
+    m_scanline_p.free_all();
+    m_scanline_u.free_all();
+    m_scanline_bin.free_all();
+    m_spans.free_all();
+    m_blur.free_all();
+    m_arena.release();
+}
+
 #if ENABLE(FORMAT_RGBA)
 template<> 
 inline pix_fmt gfx_painter<pixfmt_rgba32>::pixel_format(void) const
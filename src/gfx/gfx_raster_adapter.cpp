@@ -9,9 +9,12 @@
 
 #include "gfx_gamma_function.h"
 #include "gfx_raster_adapter.h"
+#include "gfx_scanline.h"
 #include "gfx_trans_affine.h"
+#include "graphic_path.h"
 
 #include "picasso_raster_adapter.h"
+#include "render_stats.h"
 
 namespace gfx {
 
@@ -189,6 +192,28 @@ bool gfx_raster_adapter::is_empty(void)
     return m_sraster.initial() && m_fraster.initial();
 }
 
+// with statistics enabled the pipeline is drained into a path first,
+// so that preparing the vertices is timed apart from making cells.
+template <typename Rasterizer>
+static inline void add_raster_path(Rasterizer& ras, vertex_source& vs, int stage)
+{
+    if (unlikely(global_stats_enabled)) {
+        stats_timer timer;
+        picasso::graphic_path path;
+        path.concat_path(vs);
+        timer.lap(stage);
+
+        unsigned int cells = ras.total_cells();
+        ras.add_path(path);
+        timer.lap(stats_cells);
+
+        global_stats.vertices += path.total_vertices();
+        global_stats.cells += (ras.total_cells() >= cells) ? (ras.total_cells() - cells) : ras.total_cells();
+    } else {
+        ras.add_path(vs);
+    }
+}
+
 void gfx_raster_adapter::setup_stroke_raster(void)
 {
     if (m_impl->m_dashline) {
@@ -212,7 +237,7 @@ void gfx_raster_adapter::setup_stroke_raster(void)
         p.set_inner_join(m_impl->m_inner_join);
         p.set_miter_limit(SCALAR_TO_FLT(m_impl->m_miter_limit));
 
-        m_sraster.add_path(t);
+        add_raster_path(m_sraster, t, stats_stroke);
     } else {
         picasso::conv_curve c(*const_cast<vertex_source*>(m_impl->m_source));
         picasso::conv_stroke p(c); 
@@ -228,17 +253,34 @@ void gfx_raster_adapter::setup_stroke_raster(void)
         p.set_inner_join(m_impl->m_inner_join);
         p.set_miter_limit(SCALAR_TO_FLT(m_impl->m_miter_limit));
 
-        m_sraster.add_path(t);
+        add_raster_path(m_sraster, t, stats_stroke);
     }
 }
 
 void gfx_raster_adapter::setup_fill_raster(void)
 {
     m_fraster.filling(m_impl->m_filling_rule);
+
+    if (m_impl->m_transform->type() == matrix_identity) {
+        add_raster_path(m_fraster, *const_cast<vertex_source*>(m_impl->m_source), stats_flatten);
+        return;
+    }
+
     gfx_trans_affine adjmtx = stable_matrix(*const_cast<gfx_trans_affine*>(m_impl->m_transform));
 
     conv_transform mt(*const_cast<vertex_source*>(m_impl->m_source), &adjmtx);
-    m_fraster.add_path(mt);
+    add_raster_path(m_fraster, mt, stats_flatten);
+}
+
+void gfx_raster_adapter::memory_usage(memory_stats* s)
+{
+    s->raster += m_sraster.byte_size() + m_fraster.byte_size();
+}
+
+void gfx_raster_adapter::trim(void)
+{
+    m_sraster.free_all();
+    m_fraster.free_all();
 }
 
 void gfx_raster_adapter::commit(void)
@@ -271,4 +313,58 @@ bool gfx_raster_adapter::contains(scalar x, scalar y)
     }
 }
 
+bool gfx_raster_adapter::raster_bounds(rect* r)
+{
+    bool ret = false;
+    if (m_fraster.rewind_scanlines()) {
+        r->x1 = m_fraster.min_x();
+        r->y1 = m_fraster.min_y();
+        r->x2 = m_fraster.max_x();
+        r->y2 = m_fraster.max_y();
+        ret = true;
+    }
+
+    if (m_sraster.rewind_scanlines()) {
+        if (ret) {
+            r->x1 = Min(r->x1, m_sraster.min_x());
+            r->y1 = Min(r->y1, m_sraster.min_y());
+            r->x2 = Max(r->x2, m_sraster.max_x());
+            r->y2 = Max(r->y2, m_sraster.max_y());
+        } else {
+            r->x1 = m_sraster.min_x();
+            r->y1 = m_sraster.min_y();
+            r->x2 = m_sraster.max_x();
+            r->y2 = m_sraster.max_y();
+        }
+        ret = true;
+    }
+    return ret;
+}
+
+void gfx_raster_adapter::raster_coverage(byte* covers, const rect& r)
+{
+    unsigned int width = r.x2 - r.x1 + 1;
+    memset(covers, 0, width * (r.y2 - r.y1 + 1));
+
+    if (m_fraster.rewind_scanlines()) {
+        gfx_scanline_u8 sl;
+        sl.reset(m_fraster.min_x(), m_fraster.max_x());
+        while (m_fraster.sweep_scanline(sl)) {
+            if (sl.y() < r.y1 || sl.y() > r.y2)
+                continue;
+
+            byte* row = covers + (sl.y() - r.y1) * width;
+            unsigned int num_spans = sl.num_spans();
+            gfx_scanline_u8::const_iterator span = sl.begin();
+            while (num_spans--) {
+                int x1 = Max(span->x, (gfx_scanline_u8::coord_type)r.x1);
+                int x2 = Min(span->x + span->len - 1, r.x2);
+                if (x1 <= x2)
+                    mem_copy(row + x1 - r.x1, span->covers + x1 - span->x, x2 - x1 + 1);
+                ++span;
+            }
+        }
+    }
+}
+
 }
@@ -40,6 +40,12 @@ public:
     virtual bool is_empty(void);
     virtual bool contains(scalar x, scalar y);
 
+    virtual bool raster_bounds(rect* r);
+    virtual void raster_coverage(byte* covers, const rect& r);
+
+    virtual void memory_usage(memory_stats* s);
+    virtual void trim(void);
+
     unsigned int raster_method(void) const;
     gfx_rasterizer_scanline_aa<>& stroke_impl(void) { return m_sraster; } 
     gfx_rasterizer_scanline_aa<>& fill_impl(void) { return m_fraster; } 
@@ -10,6 +10,7 @@
 #include "common.h"
 
 #include "graphic_base.h"
+#include "render_stats.h"
 
 namespace gfx {
 
@@ -181,6 +182,29 @@ public:
         m_max_y = -0x7FFFFFFF;
     }
 
+    // reset and give back the cell blocks and sort tables.
+    void free_all(void)
+    {
+        reset();
+        while (m_num_blocks)
+            pod_allocator<cell_type>::deallocate(m_cells[--m_num_blocks], cell_block_size);
+
+        pod_allocator<cell_type*>::deallocate(m_cells, m_max_blocks);
+        m_cells = 0;
+        m_max_blocks = 0;
+        m_curr_cell_ptr = 0;
+        m_sorted_cells.remove_all();
+        m_sorted_y.remove_all();
+    }
+
+    unsigned int byte_size(void) const
+    {
+        return m_num_blocks * cell_block_size * sizeof(cell_type)
+             + m_max_blocks * sizeof(cell_type*)
+             + m_sorted_cells.capacity() * sizeof(cell_type*)
+             + m_sorted_y.capacity() * sizeof(sorted_y);
+    }
+
     void style(const cell_type& style_cell)
     {
         m_style_cell.style(style_cell); 
@@ -325,6 +349,36 @@ public:
     int max_y(void) const { return m_max_y; }
 
     void sort_cells(void)
+    {
+        if (unlikely(global_stats_enabled) && !m_sorted) {
+            stats_timer timer;
+            do_sort_cells();
+            global_stats.sorted_cells += m_num_cells;
+            timer.lap(stats_sort);
+        } else {
+            do_sort_cells();
+        }
+    }
+
+    unsigned int total_cells(void) const 
+    {
+        return m_num_cells;
+    }
+
+    unsigned int scanline_num_cells(unsigned int y) const 
+    { 
+        return m_sorted_y[y - m_min_y].num; 
+    }
+
+    const cell_type* const* scanline_cells(unsigned int y) const
+    { 
+        return m_sorted_cells.data() + m_sorted_y[y - m_min_y].start; 
+    }
+
+    bool sorted(void) const { return m_sorted; }
+
+private:
+    void do_sort_cells(void)
     {
         if (m_sorted)
             return; //Perform sort only the first time.
@@ -407,24 +461,6 @@ public:
         m_sorted = true;
     }
 
-    unsigned int total_cells(void) const 
-    {
-        return m_num_cells;
-    }
-
-    unsigned int scanline_num_cells(unsigned int y) const 
-    { 
-        return m_sorted_y[y - m_min_y].num; 
-    }
-
-    const cell_type* const* scanline_cells(unsigned int y) const
-    { 
-        return m_sorted_cells.data() + m_sorted_y[y - m_min_y].start; 
-    }
-
-    bool sorted(void) const { return m_sorted; }
-
-private:
     void set_curr_cell(int x, int y)
     {
         if (m_curr_cell.not_equal(x, y, m_style_cell)) {
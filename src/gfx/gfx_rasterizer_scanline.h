@@ -173,6 +173,14 @@ public:
         m_status = status_initial;
     }
 
+    void free_all(void)
+    {
+        m_outline.free_all();
+        m_status = status_initial;
+    }
+
+    unsigned int byte_size(void) const { return m_outline.byte_size(); }
+
     void filling(filling_rule rule)
     {
         m_filling_rule = rule; 
@@ -298,6 +306,8 @@ public:
     int max_x(void) const { return m_outline.max_x(); }
     int max_y(void) const { return m_outline.max_y(); }
 
+    unsigned int total_cells(void) const { return m_outline.total_cells(); }
+
     void sort(void)
     {
         if (m_auto_close)
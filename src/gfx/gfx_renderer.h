@@ -30,6 +30,7 @@ public:
     explicit gfx_renderer(pixfmt_type& fmt)
         : m_pixfmt(&fmt)
         , m_clip_rect(0, 0, fmt.width() - 1, fmt.height() - 1)
+        , m_bounds(m_clip_rect)
         , m_is_path_clip(false)
     {
     }
@@ -43,12 +44,23 @@ public:
     {
         m_pixfmt = &fmt;
         m_clip_rect = rect(0, 0, fmt.width() - 1, fmt.height() - 1);
+        m_bounds = m_clip_rect;
         m_clip_path.reset();
         m_is_path_clip = false;
     }
 
     const rect& clip_rect(void) const { return m_clip_rect; }
 
+    // pixels out of bounds are never written, clipping is inside of it.
+    const rect& bounds(void) const { return m_bounds; }
+    void bounds(const rect& r)
+    {
+        m_bounds = r;
+        if (!m_bounds.clip(rect(0, 0, width() - 1, height() - 1)))
+            m_bounds = rect(1, 1, 0, 0);
+        reset_clipping(true);
+    }
+
     int xmin(void) const { return m_clip_rect.x1; }
     int ymin(void) const { return m_clip_rect.y1; }
     int xmax(void) const { return m_clip_rect.x2; }
@@ -62,7 +74,7 @@ public:
         rect cb(x1, y1, x2, y2);
         cb.normalize();
 
-        if (cb.clip(rect(0, 0, width() - 1, height() - 1))) {
+        if (cb.clip(m_bounds)) {
             m_clip_rect = cb;
             return true;
         }
@@ -90,16 +102,25 @@ public:
 
     void reset_clipping(bool visibility)
     {
-        m_clip_rect = rect(0, 0, width() - 1, height() - 1);
+        m_clip_rect = m_bounds;
         m_clip_path.reset();
         m_is_path_clip = false;
     }
 
+    // the clip path cells are kept while path clipping is on.
+    void trim_clipping(void)
+    {
+        if (!m_is_path_clip)
+            m_clip_path.free_all();
+    }
+
+    unsigned int clipping_byte_size(void) const { return m_clip_path.byte_size(); }
+
     void clear(const color_type& c)
     {
         if (m_is_path_clip) { // copy for per pixel.
-            for (unsigned i = 0; i < height(); i++)
-                for (unsigned j = 0; j < width(); j++)
+            for (int i = m_bounds.y1; i <= m_bounds.y2; i++)
+                for (int j = m_bounds.x1; j <= m_bounds.x2; j++)
                     if (pixel_in_path(j, i))
                         m_pixfmt->copy_pixel(j, i, c);
         } else {
@@ -433,6 +454,7 @@ private:
 
     pixfmt_type* m_pixfmt;
     rect m_clip_rect;
+    rect m_bounds;
     bool m_is_path_clip;
     gfx_rasterizer_scanline_aa<> m_clip_path;
 };
@@ -86,6 +86,14 @@ public:
     unsigned int num_spans(void) const { return (unsigned int)(m_cur_span - &m_spans[0]); }
     const_iterator begin(void) const { return &m_spans[1]; }
 
+    void free_all(void)
+    {
+        m_spans.remove_all();
+        m_cur_span = 0;
+    }
+
+    unsigned int byte_size(void) const { return m_spans.capacity() * sizeof(span); }
+
 private:
     gfx_scanline_bin(const gfx_scanline_bin&);
     const gfx_scanline_bin operator = (const gfx_scanline_bin&);
@@ -197,6 +205,19 @@ public:
     unsigned int num_spans(void) const { return (unsigned int)(m_cur_span - &m_spans[0]); }
     const_iterator begin(void) const { return &m_spans[1]; }
 
+    void free_all(void)
+    {
+        m_spans.remove_all();
+        m_covers.remove_all();
+        m_cur_span = 0;
+        m_cover_ptr = 0;
+    }
+
+    unsigned int byte_size(void) const
+    {
+        return m_spans.capacity() * sizeof(span) + m_covers.capacity() * sizeof(cover_type);
+    }
+
 private:
     gfx_scanline_p8(const gfx_scanline_p8&);
     const gfx_scanline_p8& operator = (const gfx_scanline_p8&);
@@ -307,6 +328,18 @@ public:
     const_iterator begin(void) const { return &m_spans[1]; }
     iterator begin(void) { return &m_spans[1]; }
 
+    void free_all(void)
+    {
+        m_spans.remove_all();
+        m_covers.remove_all();
+        m_cur_span = 0;
+    }
+
+    unsigned int byte_size(void) const
+    {
+        return m_spans.capacity() * sizeof(span) + m_covers.capacity() * sizeof(cover_type);
+    }
+
 private:
     gfx_scanline_u8(const gfx_scanline_u8&);
     const gfx_scanline_u8& operator = (const gfx_scanline_u8&);
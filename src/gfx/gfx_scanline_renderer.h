@@ -8,6 +8,7 @@
 #define _GFX_SCANLINE_RENDERER_H_
 
 #include "common.h"
+#include "render_stats.h"
 
 namespace gfx {
 
@@ -118,6 +119,28 @@ private:
 };
 
 
+// count the spans and pixels of a scanline for statistics
+template <typename Scanline>
+static inline void stats_scanline(const Scanline& sl)
+{
+    uint64_t pixels = 0;
+    unsigned int num_spans = sl.num_spans();
+    typename Scanline::const_iterator span = sl.begin();
+    for (;;) {
+        pixels += (span->len < 0) ? -span->len : span->len;
+
+        if (--num_spans == 0)
+            break;
+
+        ++span;
+    }
+
+    global_stats.scanlines++;
+    global_stats.spans += sl.num_spans();
+    global_stats.pixels[global_stats.comp_op] += pixels;
+}
+
+
 // render scanlines 
 template <typename Rasterizer, typename Scanline, typename Renderer>
 void gfx_render_scanlines(Rasterizer& ras, Scanline& sl, Renderer& ren)
@@ -125,6 +148,18 @@ void gfx_render_scanlines(Rasterizer& ras, Scanline& sl, Renderer& ren)
     if (ras.rewind_scanlines()) {
         sl.reset(ras.min_x(), ras.max_x());
         ren.prepare();
+        if (unlikely(global_stats_enabled)) {
+            stats_timer timer;
+            while (ras.sweep_scanline(sl)) {
+                timer.lap(stats_sweep);
+                stats_scanline(sl);
+                ren.render(sl);
+                timer.lap(stats_blend);
+            }
+            timer.lap(stats_sweep);
+            return;
+        }
+
         while (ras.sweep_scanline(sl)) {
             ren.render(sl);
         }
@@ -132,6 +167,36 @@ void gfx_render_scanlines(Rasterizer& ras, Scanline& sl, Renderer& ren)
 }
 
 
+// render a scanline with spans generated
+template <typename Scanline, typename Renderer, typename SpanAllocator, typename SpanGenerator>
+static inline void gfx_render_scanline_aa(const Scanline& sl, Renderer& ren,
+                                          SpanAllocator& alloc, SpanGenerator& span_gen)
+{
+    int y = sl.y();
+
+    unsigned int num_spans = sl.num_spans();
+    typename Scanline::const_iterator span = sl.begin();
+    for (;;) {
+        int x = span->x;
+        int len = span->len;
+        const typename Scanline::cover_type* covers = span->covers;
+
+        if (len < 0)
+            len = -len;
+
+        typename Renderer::color_type* colors = alloc.allocate(len);
+        span_gen.generate(colors, x, y, len);
+
+        ren.blend_color_hspan(x, y, len, colors, (span->len < 0) ? 0 : covers, *covers);
+
+        if (--num_spans == 0)
+            break;
+
+        ++span;
+    }
+}
+
+
 // render scanlines antialias
 template <typename Rasterizer, typename Scanline, typename Renderer, 
           typename SpanAllocator, typename SpanGenerator>
@@ -141,29 +206,20 @@ void gfx_render_scanlines_aa(Rasterizer& ras, Scanline& sl, Renderer& ren,
     if (ras.rewind_scanlines()) {
         sl.reset(ras.min_x(), ras.max_x());
         span_gen.prepare();
-        while (ras.sweep_scanline(sl)) {
-            int y = sl.y();
-
-            unsigned int num_spans = sl.num_spans();
-            typename Scanline::const_iterator span = sl.begin();
-            for (;;) {
-                int x = span->x;
-                int len = span->len;
-                const typename Scanline::cover_type* covers = span->covers;
-
-                if (len < 0)
-                    len = -len;
-
-                typename Renderer::color_type* colors = alloc.allocate(len);
-                span_gen.generate(colors, x, y, len);
-
-                ren.blend_color_hspan(x, y, len, colors, (span->len < 0) ? 0 : covers, *covers);
-
-                if (--num_spans == 0)
-                    break;
-
-                ++span;
+        if (unlikely(global_stats_enabled)) {
+            stats_timer timer;
+            while (ras.sweep_scanline(sl)) {
+                timer.lap(stats_sweep);
+                stats_scanline(sl);
+                gfx_render_scanline_aa(sl, ren, alloc, span_gen);
+                timer.lap(stats_blend);
             }
+            timer.lap(stats_sweep);
+            return;
+        }
+
+        while (ras.sweep_scanline(sl)) {
+            gfx_render_scanline_aa(sl, ren, alloc, span_gen);
         }
     }
 }
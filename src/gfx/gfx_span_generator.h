@@ -39,6 +39,9 @@ public:
     color_type* span(void) { return &m_span[0]; }
     unsigned int max_span_len(void) const { return m_span.size(); }
 
+    void free_all(void) { m_span.remove_all(); }
+    unsigned int byte_size(void) const { return m_span.capacity() * sizeof(color_type); }
+
 private:
     pod_array<color_type> m_span;
 };
@@ -69,6 +72,13 @@ public:
         int x1 = iround(tx * subpixel_scale);
         int y1 = iround(ty * subpixel_scale);
 
+        if (!(m_trans->type() & ~matrix_translate)) {
+            // translate only, the span steps one pixel along x.
+            m_li_x = gfx_dda2_line_interpolator(x1, x1 + (int)len * subpixel_scale, len);
+            m_li_y = gfx_dda2_line_interpolator(y1, y1, len);
+            return;
+        }
+
         tx = x + len;
         ty = y;
         m_trans->transform(&tx, &ty);
@@ -23,28 +23,30 @@ public:
         : m_sx(FLT_TO_SCALAR(1.0f)), m_shy(FLT_TO_SCALAR(0.0f))
         , m_shx(FLT_TO_SCALAR(0.0f)), m_sy(FLT_TO_SCALAR(1.0f))
         , m_tx(FLT_TO_SCALAR(0.0f)), m_ty(FLT_TO_SCALAR(0.0f))
+        , m_type(matrix_identity)
     {
     }
 
     gfx_trans_affine(scalar sx, scalar shy, scalar shx, scalar sy, scalar tx, scalar ty)
         : m_sx(sx), m_shy(shy), m_shx(shx), m_sy(sy), m_tx(tx), m_ty(ty)
     {
+        update_type();
     }
 
     virtual ~gfx_trans_affine()
     {
     }
 
-    virtual void sx(scalar v) { m_sx = v; }
-    virtual void sy(scalar v) { m_sy = v; }
+    virtual void sx(scalar v) { m_sx = v; update_type(); }
+    virtual void sy(scalar v) { m_sy = v; update_type(); }
     virtual scalar sx(void) const { return m_sx; }
     virtual scalar sy(void) const { return m_sy; }
-    virtual void shx(scalar v) { m_shx = v; }
-    virtual void shy(scalar v) { m_shy = v; }
+    virtual void shx(scalar v) { m_shx = v; update_type(); }
+    virtual void shy(scalar v) { m_shy = v; update_type(); }
     virtual scalar shx(void) const { return m_shx; }
     virtual scalar shy(void) const { return m_shy; }
-    virtual void tx(scalar v) { m_tx = v; }
-    virtual void ty(scalar v) { m_ty = v; }
+    virtual void tx(scalar v) { m_tx = v; update_type(); }
+    virtual void ty(scalar v) { m_ty = v; update_type(); }
     virtual scalar tx(void) const { return m_tx; }
     virtual scalar ty(void) const { return m_ty; }
 
@@ -52,6 +54,9 @@ public:
     {
         m_tx += x;
         m_ty += y; 
+
+        if ((x != FLT_TO_SCALAR(0.0f)) || (y != FLT_TO_SCALAR(0.0f)))
+            m_type |= matrix_translate;
     }
 
     virtual void scale(scalar x, scalar y)
@@ -64,6 +69,9 @@ public:
         m_shy *= m1;
         m_sy  *= m1;
         m_ty  *= m1;
+
+        if ((x != FLT_TO_SCALAR(1.0f)) || (y != FLT_TO_SCALAR(1.0f)))
+            m_type |= matrix_scale;
     }
 
     virtual void rotate(scalar a)
@@ -79,6 +87,9 @@ public:
         m_sx  = t0;
         m_shx = t2;
         m_tx  = t4;
+
+        if (a != FLT_TO_SCALAR(0.0f))
+            m_type |= matrix_rotate;
     }
 
     virtual void shear(scalar x, scalar y)
@@ -91,6 +102,9 @@ public:
         m_shy += t1;
         m_shx += t2;
         m_sy += t3;
+
+        if ((x != FLT_TO_SCALAR(0.0f)) || (y != FLT_TO_SCALAR(0.0f)))
+            m_type |= matrix_rotate;
     }
 
 
@@ -115,6 +129,7 @@ public:
         m_sx  = -m_sx;
         m_shy = -m_shy;
         m_tx  = -m_tx;
+        m_type |= matrix_scale;
     }
 
     virtual void flip_y(void)
@@ -122,16 +137,29 @@ public:
         m_shx = -m_shx;
         m_sy  = -m_sy;
         m_ty  = -m_ty;
+        m_type |= matrix_scale;
     }
 
     virtual void reset(void)
     {
         m_sx = m_sy = FLT_TO_SCALAR(1.0f); 
         m_shy = m_shx = m_tx = m_ty = FLT_TO_SCALAR(0.0f);
+        m_type = matrix_identity;
     }
 
     virtual void multiply(const abstract_trans_affine* o)
     {
+        unsigned int type = o->type();
+        if (type == matrix_identity)
+            return;
+
+        if (type == matrix_translate) {
+            m_tx += o->tx();
+            m_ty += o->ty();
+            m_type |= matrix_translate;
+            return;
+        }
+
         scalar t0 = m_sx  * o->sx() + m_shy * o->shx();
         scalar t2 = m_shx * o->sx() + m_sy  * o->shx();
         scalar t4 = m_tx  * o->sx() + m_ty  * o->shx() + o->tx();
@@ -141,10 +169,14 @@ public:
         m_sx  = t0;
         m_shx = t2;
         m_tx  = t4;
+        m_type |= type;
     }
 
     virtual bool is_identity(void) const
     {
+        if (m_type == matrix_identity)
+            return true;
+
         return is_equal_eps(m_sx,  FLT_TO_SCALAR(1.0f), affine_epsilon) &&
                is_equal_eps(m_shy, FLT_TO_SCALAR(0.0f), affine_epsilon) &&
                is_equal_eps(m_shx, FLT_TO_SCALAR(0.0f), affine_epsilon) && 
@@ -153,6 +185,11 @@ public:
                is_equal_eps(m_ty,  FLT_TO_SCALAR(0.0f), affine_epsilon);
     }
 
+    virtual unsigned int type(void) const
+    {
+        return m_type;
+    }
+
     virtual scalar determinant(void) const
     {
         return m_sx * m_sy - m_shy * m_shx;
@@ -206,6 +243,12 @@ public:
 
     virtual void transform(scalar* x, scalar* y) const
     {
+        if (!(m_type & ~matrix_translate)) {
+            *x += m_tx;
+            *y += m_ty;
+            return;
+        }
+
         register scalar tmp = *x;
         *x = tmp * m_sx  + *y * m_shx + m_tx;
         *y = tmp * m_shy + *y * m_sy  + m_ty;
@@ -237,6 +280,7 @@ public:
     virtual void load_from(const scalar* m)
     {
         m_sx = *m++; m_shy = *m++; m_shx = *m++; m_sy = *m++; m_tx = *m++; m_ty = *m++;
+        update_type();
     }
 
 public:
@@ -254,6 +298,18 @@ protected:
         return FLT_TO_SCALAR(1.0f) / (m_sx * m_sy - m_shy * m_shx);
     }
 
+    // Classify the matrix from its components
+    void update_type(void)
+    {
+        m_type = matrix_identity;
+        if ((m_tx != FLT_TO_SCALAR(0.0f)) || (m_ty != FLT_TO_SCALAR(0.0f)))
+            m_type |= matrix_translate;
+        if ((m_sx != FLT_TO_SCALAR(1.0f)) || (m_sy != FLT_TO_SCALAR(1.0f)))
+            m_type |= matrix_scale;
+        if ((m_shx != FLT_TO_SCALAR(0.0f)) || (m_shy != FLT_TO_SCALAR(0.0f)))
+            m_type |= matrix_rotate;
+    }
+
 private:
     scalar m_sx;
     scalar m_shy;
@@ -261,6 +317,7 @@ private:
     scalar m_sy;
     scalar m_tx;
     scalar m_ty;
+    unsigned int m_type;
 };
 
 // Translation matrix
@@ -312,7 +369,7 @@ public:
 // hack!! Stable matrix
 inline gfx_trans_affine stable_matrix(const gfx_trans_affine& o)
 {
-    if (is_boxer(o.rotation())) {
+    if (!(o.type() & matrix_rotate) || is_boxer(o.rotation())) {
         scalar tx = Floor(o.tx());
         scalar ty = Floor(o.ty());
         return gfx_trans_affine(o.sx(), o.shy(), o.shx(), o.sy(), SCALAR_TO_FLT(tx), SCALAR_TO_FLT(ty));
@@ -39,4 +39,13 @@ typedef uint8_t byte;
 #define ALIGNED(x)
 #endif
 
+// thread local storage
+#if COMPILER(MSVC)
+#define THREAD_LOCAL  __declspec(thread)
+#elif COMPILER(GCC) || COMPILER(CLANG)
+#define THREAD_LOCAL  __thread
+#else
+#define THREAD_LOCAL
+#endif
+
 #endif /*_COMMON_H_*/
@@ -16,6 +16,7 @@
 #include "interfaces.h"
 #include "picasso_matrix.h"
 #include "picasso_gpc.h"
+#include "picasso_sweep.h"
 
 namespace picasso {
 
@@ -107,23 +108,39 @@ class conv_transform : public vertex_source
 public:
     conv_transform(const vertex_source& v, const trans_affine& m)
         : m_source(const_cast<vertex_source*>(&v)), m_trans(m.impl())
+        , m_type(matrix_rotate), m_tx(FLT_TO_SCALAR(0.0f)), m_ty(FLT_TO_SCALAR(0.0f))
     { 
     }
 
     conv_transform(const vertex_source& v, const abstract_trans_affine* m)
         : m_source(const_cast<vertex_source*>(&v)), m_trans(m)
+        , m_type(matrix_rotate), m_tx(FLT_TO_SCALAR(0.0f)), m_ty(FLT_TO_SCALAR(0.0f))
     { 
     }
 
     void transformer(const trans_affine& t) { m_trans = t.impl(); }
 
-    virtual void rewind(unsigned int id) { m_source->rewind(id); }
+    virtual void rewind(unsigned int id) 
+    { 
+        m_source->rewind(id); 
+        // matrix type is sampled once per pass, pick the cheapest transform.
+        m_type = m_trans->type();
+        m_tx = m_trans->tx();
+        m_ty = m_trans->ty();
+    }
 
     virtual unsigned int vertex(scalar* x, scalar* y) 
     {
         unsigned int cmd = m_source->vertex(x, y);
         if (is_vertex(cmd)) {
-            m_trans->transform(x, y);
+            if (m_type == matrix_identity) {
+                return cmd;
+            } else if (m_type == matrix_translate) {
+                *x += m_tx;
+                *y += m_ty;
+            } else {
+                m_trans->transform(x, y);
+            }
         }
         return cmd;
     }
@@ -133,6 +150,9 @@ private:
 
     vertex_source* m_source;
     const abstract_trans_affine* m_trans;
+    unsigned int m_type;
+    scalar m_tx;
+    scalar m_ty;
 };
 
 // Convert clipper
@@ -145,6 +165,13 @@ public:
         clip_xor,
         clip_diff,
     } clip_op;
+
+    // gpc is the default, the sweep engine snaps vertices to an integer grid
+    // and unions many sources in one pass.
+    typedef enum {
+        clip_engine_gpc,
+        clip_engine_sweep,
+    } clip_engine;
     
     typedef enum {
         status_move_to,
@@ -158,13 +185,33 @@ public:
         vertex_s* vertices;
     } contour_header;
 
-    conv_clipper(const vertex_source& a, const vertex_source& b, clip_op op) 
+    conv_clipper(const vertex_source& a, const vertex_source& b, clip_op op, clip_engine engine = clip_engine_gpc)
         : m_src_a(const_cast<vertex_source*>(&a))
         , m_src_b(const_cast<vertex_source*>(&b))
+        , m_sources(0)
+        , m_num_sources(0)
         , m_status(status_move_to)
         , m_vertex(-1)
         , m_contour(-1)
         , m_operation(op)
+        , m_engine(engine)
+    {
+        memset(&m_poly_a, 0, sizeof(m_poly_a));
+        memset(&m_poly_b, 0, sizeof(m_poly_b));
+        memset(&m_result, 0, sizeof(m_result));
+    }
+
+    // union of many sources, the sources array must be valid until rewind.
+    conv_clipper(vertex_source* const* sources, unsigned int num, clip_engine engine = clip_engine_gpc)
+        : m_src_a(0)
+        , m_src_b(0)
+        , m_sources(sources)
+        , m_num_sources(num)
+        , m_status(status_move_to)
+        , m_vertex(-1)
+        , m_contour(-1)
+        , m_operation(clip_union)
+        , m_engine(engine)
     {
         memset(&m_poly_a, 0, sizeof(m_poly_a));
         memset(&m_poly_b, 0, sizeof(m_poly_b));
@@ -179,25 +226,38 @@ public:
     virtual void rewind(unsigned int id) 
     {
         free_result();
-        m_src_a->rewind(id);
-        m_src_b->rewind(id);
-        add(m_poly_a, *m_src_a);
-        add(m_poly_b, *m_src_b);
+        if (m_sources) {
+            if (m_engine == clip_engine_sweep)
+                sweep_all(id);
+            else
+                union_all(id);
+        } else {
+            m_src_a->rewind(id);
+            m_src_b->rewind(id);
+            add(m_poly_a, *m_src_a);
+            add(m_poly_b, *m_src_b);
 
-        switch(m_operation)
-        {
-           case clip_union:
-               gpc_polygon_clip(GPC_UNION, &m_poly_a, &m_poly_b, &m_result);
-               break;
-           case clip_intersect:
-               gpc_polygon_clip(GPC_INT, &m_poly_a, &m_poly_b, &m_result);
-               break;
-           case clip_xor:
-               gpc_polygon_clip(GPC_XOR, &m_poly_a, &m_poly_b, &m_result);
-               break;
-           case clip_diff:
-               gpc_polygon_clip(GPC_DIFF, &m_poly_a, &m_poly_b, &m_result);
-               break;
+            gpc_op op = GPC_UNION;
+            switch(m_operation)
+            {
+               case clip_union:
+                   op = GPC_UNION;
+                   break;
+               case clip_intersect:
+                   op = GPC_INT;
+                   break;
+               case clip_xor:
+                   op = GPC_XOR;
+                   break;
+               case clip_diff:
+                   op = GPC_DIFF;
+                   break;
+            }
+
+            if (m_engine == clip_engine_sweep)
+                sweep_polygon_clip(op, &m_poly_a, &m_poly_b, &m_result);
+            else
+                gpc_polygon_clip(op, &m_poly_a, &m_poly_b, &m_result);
         }
 
         m_status = status_move_to;
@@ -227,6 +287,180 @@ public:
         return path_cmd_stop;
     }
 private:
+    typedef struct {
+        gpc_polygon poly;
+        scalar x1;
+        scalar y1;
+        scalar x2;
+        scalar y2;
+        unsigned int layer;
+    } union_item;
+
+    typedef struct {
+        gpc_polygon poly;
+        bool gpc_owned; // result of gpc, free by gpc_free_polygon.
+    } union_layer;
+
+    static bool union_item_less(const union_item& a, const union_item& b)
+    {
+        return a.x1 < b.x1;
+    }
+
+    static bool polygon_bounds(const gpc_polygon& p, scalar* x1, scalar* y1, scalar* x2, scalar* y2)
+    {
+        bool first = true;
+        for (int i = 0; i < p.num_contours; i++) {
+            const gpc_vertex_list& vlist = p.contour[i];
+            for (int j = 0; j < vlist.num_vertices; j++) {
+                const vertex_s& v = vlist.vertex[j];
+                if (first) {
+                    *x1 = *x2 = v.x;
+                    *y1 = *y2 = v.y;
+                    first = false;
+                } else {
+                    if (v.x < *x1) *x1 = v.x;
+                    if (v.y < *y1) *y1 = v.y;
+                    if (v.x > *x2) *x2 = v.x;
+                    if (v.y > *y2) *y2 = v.y;
+                }
+            }
+        }
+        return !first;
+    }
+
+    void free_layer(union_layer& l)
+    {
+        if (l.gpc_owned) {
+            gpc_free_polygon(&l.poly);
+            memset(&l.poly, 0, sizeof(gpc_polygon));
+        } else {
+            free_polygon(l.poly);
+        }
+    }
+
+    // all sources in one sweep, see sweep_polygon_union.
+    void sweep_all(unsigned int id)
+    {
+        pod_array<gpc_polygon> polys(m_num_sources);
+        memset(polys.data(), 0, sizeof(gpc_polygon) * m_num_sources);
+        for (unsigned int i = 0; i < m_num_sources; i++) {
+            m_sources[i]->rewind(id);
+            add(polys[i], *m_sources[i]);
+        }
+
+        sweep_polygon_union(polys.data(), m_num_sources, &m_result);
+
+        for (unsigned int i = 0; i < m_num_sources; i++)
+            free_polygon(polys[i]);
+    }
+
+    // Union of the gpc engine, which takes two operands per call.
+    // Sources whose bounding boxes do not overlap can not change each other
+    // under the even-odd rule, so they are packed into one layer and swept
+    // in a single pass. The layers are merged by pairs in a balanced tree,
+    // instead of a chain of unions with growing intermediate results.
+    // It is still gpc for every sweep. The packing scans the active boxes for
+    // each source, and heavy overlap makes one layer per source, so it falls
+    // back to O(n^2) checks and a tree of n unions.
+    void union_all(unsigned int id)
+    {
+        pod_bvector<union_item> items;
+        for (unsigned int i = 0; i < m_num_sources; i++) {
+            union_item item;
+            memset(&item, 0, sizeof(item));
+            m_sources[i]->rewind(id);
+            add(item.poly, *m_sources[i]);
+            if (polygon_bounds(item.poly, &item.x1, &item.y1, &item.x2, &item.y2))
+                items.add(item);
+            else
+                free_polygon(item.poly);
+        }
+
+        if (!items.size())
+            return;
+
+        quick_sort(items, union_item_less);
+
+        // put each source into the first layer which has no active member overlapping it.
+        pod_bvector<unsigned int> active;
+        pod_bvector<unsigned int> marks;
+        unsigned int num_layers = 0;
+        for (unsigned int i = 0; i < items.size(); i++) {
+            union_item& item = items[i];
+            unsigned int j = 0;
+            while (j < active.size()) {
+                const union_item& o = items[active[j]];
+                if (o.x2 < item.x1) { // left behind, never overlaps again.
+                    active[j] = active.last();
+                    active.remove_last();
+                    continue;
+                }
+                if (o.y1 <= item.y2 && item.y1 <= o.y2)
+                    marks[o.layer] = i + 1;
+                j++;
+            }
+
+            unsigned int layer = 0;
+            while (layer < num_layers && marks[layer] == i + 1)
+                layer++;
+
+            if (layer == num_layers) {
+                marks.add(0);
+                num_layers++;
+            }
+            item.layer = layer;
+            active.add(i);
+        }
+
+        pod_array<union_layer> layers(num_layers);
+        memset(layers.data(), 0, sizeof(union_layer) * num_layers);
+
+        for (unsigned int i = 0; i < items.size(); i++)
+            layers[items[i].layer].poly.num_contours += items[i].poly.num_contours;
+
+        for (unsigned int i = 0; i < num_layers; i++) {
+            layers[i].poly.contour = pod_allocator<gpc_vertex_list>::allocate(layers[i].poly.num_contours);
+            layers[i].poly.num_contours = 0;
+        }
+
+        // move the contours into layers, the vertices are owned by layers now.
+        for (unsigned int i = 0; i < items.size(); i++) {
+            gpc_polygon& p = items[i].poly;
+            gpc_polygon& l = layers[items[i].layer].poly;
+            mem_copy(l.contour + l.num_contours, p.contour, sizeof(gpc_vertex_list) * p.num_contours);
+            l.num_contours += p.num_contours;
+            pod_allocator<gpc_vertex_list>::deallocate(p.contour, p.num_contours);
+        }
+
+        if (num_layers == 1) {
+            // still sweep it once, to resolve the self intersections.
+            gpc_polygon empty;
+            memset(&empty, 0, sizeof(empty));
+            gpc_polygon_clip(GPC_UNION, &layers[0].poly, &empty, &m_result);
+            free_layer(layers[0]);
+            return;
+        }
+
+        unsigned int n = num_layers;
+        while (n > 1) {
+            unsigned int k = 0;
+            for (unsigned int i = 0; i + 1 < n; i += 2) {
+                union_layer r;
+                r.gpc_owned = true;
+                gpc_polygon_clip(GPC_UNION, &layers[i].poly, &layers[i + 1].poly, &r.poly);
+                free_layer(layers[i]);
+                free_layer(layers[i + 1]);
+                layers[k++] = r;
+            }
+
+            if (n & 1)
+                layers[k++] = layers[n - 1];
+
+            n = k;
+        }
+        m_result = layers[0].poly;
+    }
+
     void free_result(void) 
     {
         if (m_result.contour) {
@@ -374,10 +608,13 @@ private:
 
     vertex_source* m_src_a;
     vertex_source* m_src_b;
+    vertex_source* const* m_sources;
+    unsigned int m_num_sources;
     status m_status;
     int m_vertex;
     int m_contour;
     clip_op m_operation;
+    clip_engine m_engine;
     pod_bvector<vertex_s> m_vertex_accumulator;
     pod_bvector<contour_header> m_contour_accumulator;
     gpc_polygon m_poly_a;
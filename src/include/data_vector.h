@@ -72,7 +72,16 @@ public:
         return *this;
     }
 
+    // free the storage.
+    void remove_all(void)
+    {
+        pod_allocator<T>::deallocate(m_array, m_capacity);
+        m_array = 0;
+        m_size = m_capacity = 0;
+    }
+
     unsigned int size(void) const { return m_size; }
+    unsigned int capacity(void) const { return m_capacity; }
 
     const T& operator [] (unsigned i) const { return m_array[i]; }
     T& operator [] (unsigned i) { return m_array[i]; }
@@ -149,6 +158,14 @@ public:
     void remove_last(void) { if (m_size) --m_size; }
     void cut_at(unsigned int num) { if (num < m_size) m_size = num; }
 
+    // free the storage.
+    void remove_all(void)
+    {
+        pod_allocator<T>::deallocate(m_array, m_capacity);
+        m_array = 0;
+        m_size = m_capacity = 0;
+    }
+
 protected:
     unsigned int m_size;
     unsigned int m_capacity;
@@ -272,6 +272,14 @@ typedef enum {
     inner_round
 } inner_join;
 
+// matrix type, combined as bit mask
+typedef enum {
+    matrix_identity  = 0,
+    matrix_translate = 1,
+    matrix_scale     = 2,
+    matrix_rotate    = 4, // rotate or shear
+} matrix_type;
+
 // fill rule
 typedef enum {
     fill_non_zero,
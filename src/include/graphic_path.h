@@ -34,6 +34,8 @@ public:
     graphic_path& operator=(const graphic_path& o);
 
     void free_all(void);
+    // shrink the storage to the vertices in use.
+    void trim(void);
 
     //Make path functions
     unsigned int start_new_path(void);
@@ -80,6 +82,7 @@ public:
 
     unsigned int total_vertices(void) const;
     unsigned int total_byte_size(void) const;
+    unsigned int capacity_byte_size(void) const;
     void rel_to_abs(scalar* x, scalar* y) const;
 
     unsigned int vertex(unsigned int idx, scalar* x, scalar* y) const;
@@ -46,6 +46,7 @@ public:
     virtual void multiply(const abstract_trans_affine* o) = 0;
 
     virtual bool is_identity(void) const = 0;
+    virtual unsigned int type(void) const = 0;
     virtual scalar determinant(void) const = 0;
     virtual scalar rotation(void) const = 0;
     virtual void translation(scalar* dx, scalar* dy) const = 0;
@@ -90,6 +91,17 @@ private:
     abstract_rendering_buffer& operator=(const abstract_rendering_buffer&);
 };
 
+// bytes held by working storages, each object adds its own.
+typedef struct _memory_stats {
+    unsigned int raster;
+    unsigned int scanline;
+    unsigned int span;
+    unsigned int shadow;
+    unsigned int path;
+    unsigned int glyph;
+    unsigned int font;
+} memory_stats;
+
 //Raster adapter interface
 class abstract_raster_adapter
 {
@@ -111,6 +123,14 @@ public:
     virtual void commit(void) = 0;
     virtual bool is_empty(void) = 0;
     virtual bool contains(scalar x, scalar y) = 0;
+
+    // bounds of the fill and stroke rasters and coverage of the fill raster in device pixels.
+    virtual bool raster_bounds(rect* r) = 0;
+    virtual void raster_coverage(byte* covers, const rect& r) = 0;
+
+    // memory accounting, trim frees the storages kept for reuse.
+    virtual void memory_usage(memory_stats* s) = 0;
+    virtual void trim(void) = 0;
 protected:
     abstract_raster_adapter() {}
 private:
@@ -150,6 +170,8 @@ public:
     virtual void clear_stops(void) = 0;
 
     virtual void transform(const abstract_trans_affine* mtx) = 0;
+
+    virtual void build(void) = 0;
 protected:
     abstract_gradient_adapter() {}
 private:
@@ -185,6 +207,9 @@ public:
     // FIXME: own mono storage implements needed!
     virtual void apply_mono_text_fill(void * storage) = 0;
 
+    // coverage mask of pre-rasterized glyph, rows of width bytes.
+    virtual void apply_text_mask(const byte* covers, int x, int y, unsigned int width, unsigned int height) = 0;
+
     // clear
     virtual void apply_clear(const rgba& c) = 0;
 
@@ -196,6 +221,9 @@ public:
     virtual void apply_clip_device(const rect_s& rc, scalar xoffset, scalar yoffset) = 0;
     virtual void clear_clip(void) = 0;
 
+    // device bounds, nothing is drawn out of them, clipping included.
+    virtual void apply_bounds(const rect& rc) = 0;
+
     // masking
     virtual void apply_masking(abstract_mask_layer*) = 0;
     virtual void clear_masking(void) = 0;
@@ -207,6 +235,10 @@ public:
 
     //data copy
     virtual void copy_rect_from(abstract_rendering_buffer* src, const rect& rc, int x, int y) = 0;
+
+    // memory accounting, trim frees the storages kept for reuse.
+    virtual void memory_usage(memory_stats* s) = 0;
+    virtual void trim(void) = 0;
 protected:
     abstract_painter() {}
 private:
@@ -231,8 +263,11 @@ public:
 public:
     // glyph create
     virtual bool prepare_glyph(unsigned int code) = 0;
+    virtual bool prepare_glyph_index(unsigned int index) = 0;
     virtual void write_glyph_to(byte* buffer) = 0;
     virtual void add_kerning(unsigned int first, unsigned int second, scalar* x, scalar* y) = 0;
+    // advance and glyph index of a code, without loading outline.
+    virtual bool glyph_advance(unsigned int code, unsigned int* index, scalar* x, scalar* y) = 0;
 
     virtual unsigned int glyph_index(void) const = 0; 
     virtual unsigned int data_size(void) const = 0;
@@ -0,0 +1,128 @@
+/* Picasso - a vector graphics library
+ *
+ *  Copyright (C) 2015 Zhang Ji Peng.
+ *  Contact: onecoolx@gmail.com
+ */
+
+#ifndef _MEMORY_ARENA_H_
+#define _MEMORY_ARENA_H_
+
+#include "common.h"
+#include "math_type.h"
+
+namespace picasso {
+
+// bump allocator for temporaries living during one draw call.
+// memory is handed out from a chain of blocks and released all at
+// once by reset(), which folds the chain into a single block large
+// enough for the next call, so a warmed up arena no longer allocates.
+class mem_arena
+{
+public:
+    enum {
+        arena_align = 16,
+        arena_min_block = 4096,
+    };
+
+    mem_arena()
+        : m_blocks(0)
+    {
+    }
+
+    ~mem_arena()
+    {
+        release();
+    }
+
+    void* alloc(unsigned int size)
+    {
+        size = align(size);
+        if (!m_blocks || (m_blocks->size - m_blocks->used) < size) {
+            unsigned int bsize = Max(size, (unsigned int)arena_min_block);
+            if (m_blocks) // grow geometrically to keep the chain short.
+                bsize = Max(bsize, m_blocks->size * 2);
+            if (!new_block(bsize))
+                return 0;
+        }
+
+        byte* p = (byte*)m_blocks + header_size() + m_blocks->used;
+        m_blocks->used += size;
+        return p;
+    }
+
+    // give back everything allocated since the last reset.
+    void reset(void)
+    {
+        if (!m_blocks)
+            return;
+
+        if (m_blocks->next) {
+            unsigned int total = 0;
+            for (block* b = m_blocks; b; b = b->next)
+                total += b->size;
+            release();
+            new_block(total);
+        } else {
+            m_blocks->used = 0;
+        }
+    }
+
+    // return all blocks to the allocator.
+    void release(void)
+    {
+        while (m_blocks) {
+            block* b = m_blocks;
+            m_blocks = b->next;
+            mem_free(b);
+        }
+    }
+
+    unsigned int capacity(void) const
+    {
+        unsigned int total = 0;
+        for (block* b = m_blocks; b; b = b->next)
+            total += b->size;
+        return total;
+    }
+
+private:
+    mem_arena(const mem_arena&);
+    mem_arena& operator=(const mem_arena&);
+
+    struct block {
+        block* next;
+        unsigned int size;
+        unsigned int used;
+    };
+
+    static unsigned int align(unsigned int size)
+    {
+        return (size + (arena_align - 1)) & ~(arena_align - 1);
+    }
+
+    static unsigned int header_size(void)
+    {
+        return align(sizeof(block));
+    }
+
+    bool new_block(unsigned int size)
+    {
+        block* b = (block*)mem_malloc(header_size() + size);
+        if (!b)
+            return false;
+
+        b->next = m_blocks;
+        b->size = size;
+        b->used = 0;
+        m_blocks = b;
+        return true;
+    }
+
+    block* m_blocks;
+};
+
+}
+
+using picasso::mem_arena;
+
+#endif /* _MEMORY_ARENA_H_ */
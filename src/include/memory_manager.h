@@ -13,12 +13,20 @@
 
 #include "fastcopy.h"
 
-// common memory managers
-
-#define mem_malloc(n)         malloc(n)
-#define mem_calloc(n, s)      calloc(n, s)
-#define mem_realloc(p, s)     realloc(p, s)
-#define mem_free(p)           free(p)
+// common memory managers, the functions can be replaced by ps_set_allocator.
+typedef struct _mem_allocator {
+    void* (*malloc_func)(size_t size);
+    void* (*calloc_func)(size_t num, size_t size);
+    void* (*realloc_func)(void* p, size_t size);
+    void (*free_func)(void* p);
+} mem_allocator;
+
+extern mem_allocator global_allocator;
+
+#define mem_malloc(n)         global_allocator.malloc_func(n)
+#define mem_calloc(n, s)      global_allocator.calloc_func(n, s)
+#define mem_realloc(p, s)     global_allocator.realloc_func(p, s)
+#define mem_free(p)           global_allocator.free_func(p)
 
 #define mem_deep_copy(d, s, l)    memmove(d, s, l)
 #define mem_copy(d, s, l)         fastcopy(d, s, l)
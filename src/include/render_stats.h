@@ -0,0 +1,115 @@
+/* Picasso - a vector graphics library
+ *
+ *  Copyright (C) 2015 Zhang Ji Peng.
+ *  Contact: onecoolx@gmail.com
+ */
+
+#ifndef _RENDER_STATS_H_
+#define _RENDER_STATS_H_
+
+#include "common.h"
+#include "graphic_base.h"
+
+#if defined(WIN32) || defined(WINCE)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace picasso {
+
+// rendering stages timed by statistics.
+enum {
+    stats_flatten,
+    stats_stroke,
+    stats_cells,
+    stats_sort,
+    stats_sweep,
+    stats_blend,
+    stats_stages,
+};
+
+// counters of the drawing done by one thread.
+typedef struct _render_stats {
+    uint64_t vertices;
+    uint64_t cells;
+    uint64_t sorted_cells;
+    uint64_t scanlines;
+    uint64_t spans;
+    uint64_t pixels[end_of_comp_op];
+    uint64_t glyph_hits;
+    uint64_t glyph_misses;
+    uint64_t clip_rebuilds;
+    uint64_t shadow_blurs;
+    uint64_t nsec[stats_stages];
+    int comp_op; // operator of the pixels being blended.
+} render_stats;
+
+}
+
+// statistics are collected when it is true, both kept per thread.
+extern THREAD_LOCAL bool global_stats_enabled;
+extern THREAD_LOCAL picasso::render_stats global_stats;
+
+namespace picasso {
+
+// add the counters of another thread, the operator in use is kept.
+static inline void stats_add(render_stats& to, const render_stats& from)
+{
+    to.vertices += from.vertices;
+    to.cells += from.cells;
+    to.sorted_cells += from.sorted_cells;
+    to.scanlines += from.scanlines;
+    to.spans += from.spans;
+    for (int i = 0; i < end_of_comp_op; i++)
+        to.pixels[i] += from.pixels[i];
+    to.glyph_hits += from.glyph_hits;
+    to.glyph_misses += from.glyph_misses;
+    to.clip_rebuilds += from.clip_rebuilds;
+    to.shadow_blurs += from.shadow_blurs;
+    for (int i = 0; i < stats_stages; i++)
+        to.nsec[i] += from.nsec[i];
+}
+
+// monotonic clock in nanoseconds.
+static inline uint64_t stats_clock(void)
+{
+#if defined(WIN32) || defined(WINCE)
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// each lap adds the time since the previous one to a stage.
+class stats_timer
+{
+public:
+    stats_timer()
+        : m_last(global_stats_enabled ? stats_clock() : 0)
+    {
+    }
+
+    void lap(int stage)
+    {
+        if (m_last) {
+            uint64_t now = stats_clock();
+            global_stats.nsec[stage] += now - m_last;
+            m_last = now;
+        }
+    }
+
+private:
+    uint64_t m_last;
+};
+
+}
+
+using picasso::stats_timer;
+
+#endif /* _RENDER_STATS_H_ */
@@ -0,0 +1,236 @@
+/* Picasso - a vector graphics library
+ *
+ *  Copyright (C) 2015 Zhang Ji Peng.
+ *  Contact: onecoolx@gmail.com
+ */
+
+#ifndef _THREAD_LOCK_H_
+#define _THREAD_LOCK_H_
+
+#include "common.h"
+
+#if defined(WIN32) || defined(WINCE)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace picasso {
+
+// mutex lock
+class thread_lock
+{
+public:
+    thread_lock()
+    {
+#if defined(WIN32) || defined(WINCE)
+        InitializeCriticalSection(&m_lock);
+#else
+        pthread_mutex_init(&m_lock, NULL);
+#endif
+    }
+
+    ~thread_lock()
+    {
+#if defined(WIN32) || defined(WINCE)
+        DeleteCriticalSection(&m_lock);
+#else
+        pthread_mutex_destroy(&m_lock);
+#endif
+    }
+
+    void lock(void)
+    {
+#if defined(WIN32) || defined(WINCE)
+        EnterCriticalSection(&m_lock);
+#else
+        pthread_mutex_lock(&m_lock);
+#endif
+    }
+
+    void unlock(void)
+    {
+#if defined(WIN32) || defined(WINCE)
+        LeaveCriticalSection(&m_lock);
+#else
+        pthread_mutex_unlock(&m_lock);
+#endif
+    }
+
+private:
+    thread_lock(const thread_lock&);
+    thread_lock& operator=(const thread_lock&);
+
+#if defined(WIN32) || defined(WINCE)
+    CRITICAL_SECTION m_lock;
+#else
+    pthread_mutex_t m_lock;
+#endif
+};
+
+// lock in scope
+class scoped_lock
+{
+public:
+    scoped_lock(thread_lock& l)
+        : m_lock(l)
+    {
+        m_lock.lock();
+    }
+
+    ~scoped_lock()
+    {
+        m_lock.unlock();
+    }
+
+private:
+    scoped_lock(const scoped_lock&);
+    scoped_lock& operator=(const scoped_lock&);
+
+    thread_lock& m_lock;
+};
+
+// atomic counter operations, return the new value.
+static inline int atomic_increment(volatile int* v)
+{
+#if defined(WIN32) || defined(WINCE)
+    return (int)InterlockedIncrement((volatile LONG*)v);
+#elif COMPILER(GCC) || COMPILER(CLANG)
+    return __sync_add_and_fetch(v, 1);
+#else
+    return ++(*v);
+#endif
+}
+
+static inline int atomic_decrement(volatile int* v)
+{
+#if defined(WIN32) || defined(WINCE)
+    return (int)InterlockedDecrement((volatile LONG*)v);
+#elif COMPILER(GCC) || COMPILER(CLANG)
+    return __sync_sub_and_fetch(v, 1);
+#else
+    return --(*v);
+#endif
+}
+
+// flags written by one thread and read by others.
+static inline int atomic_load(volatile int* v)
+{
+#if defined(WIN32) || defined(WINCE)
+    return *v;
+#elif COMPILER(GCC) || COMPILER(CLANG)
+    return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+#else
+    return *v;
+#endif
+}
+
+static inline void atomic_store(volatile int* v, int n)
+{
+#if defined(WIN32) || defined(WINCE)
+    InterlockedExchange((volatile LONG*)v, n);
+#elif COMPILER(GCC) || COMPILER(CLANG)
+    __atomic_store_n(v, n, __ATOMIC_RELEASE);
+#else
+    *v = n;
+#endif
+}
+
+// number of online processors
+static inline unsigned int cpu_count(void)
+{
+#if defined(WIN32) || defined(WINCE)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (unsigned int)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned int)n : 1;
+#endif
+}
+
+// joinable thread
+class worker_thread
+{
+public:
+    typedef void (*thread_func)(void* data);
+
+    worker_thread()
+        : m_func(0)
+        , m_data(0)
+        , m_started(false)
+    {
+    }
+
+    ~worker_thread()
+    {
+        join();
+    }
+
+    bool start(thread_func func, void* data)
+    {
+        m_func = func;
+        m_data = data;
+#if defined(WIN32) || defined(WINCE)
+        m_thread = CreateThread(NULL, 0, thread_proc, this, 0, NULL);
+        m_started = (m_thread != NULL);
+#else
+        m_started = (pthread_create(&m_thread, NULL, thread_proc, this) == 0);
+#endif
+        return m_started;
+    }
+
+    void join(void)
+    {
+        if (m_started) {
+#if defined(WIN32) || defined(WINCE)
+            WaitForSingleObject(m_thread, INFINITE);
+            CloseHandle(m_thread);
+#else
+            pthread_join(m_thread, NULL);
+#endif
+            m_started = false;
+        }
+    }
+
+private:
+    worker_thread(const worker_thread&);
+    worker_thread& operator=(const worker_thread&);
+
+#if defined(WIN32) || defined(WINCE)
+    static DWORD WINAPI thread_proc(LPVOID param)
+    {
+        worker_thread* t = static_cast<worker_thread*>(param);
+        t->m_func(t->m_data);
+        return 0;
+    }
+
+    HANDLE m_thread;
+#else
+    static void* thread_proc(void* param)
+    {
+        worker_thread* t = static_cast<worker_thread*>(param);
+        t->m_func(t->m_data);
+        return NULL;
+    }
+
+    pthread_t m_thread;
+#endif
+    thread_func m_func;
+    void* m_data;
+    bool m_started;
+};
+
+}
+
+using picasso::thread_lock;
+using picasso::scoped_lock;
+using picasso::worker_thread;
+using picasso::atomic_increment;
+using picasso::atomic_decrement;
+using picasso::atomic_load;
+using picasso::atomic_store;
+using picasso::cpu_count;
+
+#endif /* _THREAD_LOCK_H_ */
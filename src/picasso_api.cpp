@@ -15,30 +15,44 @@
 #include "picasso_objects.h"
 #include "picasso_painter.h"
 #include "picasso_private.h"
+#include "render_stats.h"
 
 namespace picasso {
 
 static inline void _clip_path(context_state* state, const graphic_path& p, filling_rule r)
 {
-    if (!state->clip.path.total_vertices()) {
-        state->clip.path = p;
+    clip_area& clip = state->clip.write();
+    if (!clip.path.total_vertices()) {
+        clip.path = p;
     } else if (p.total_vertices()) {
         graphic_path rp;
-        _path_operation(conv_clipper::clip_intersect, state->clip.path, p, rp);
-        state->clip.path = rp;
+        _path_operation(conv_clipper::clip_intersect, clip.path, p, rp);
+        clip.path = rp;
     }
-    state->clip.rule = r;
+    clip.rule = r;
+}
+
+static inline void _render_clip(ps_context* ctx, bool clip)
+{
+    ctx->canvas->p->render_clip(ctx->state, clip);
+    if (ctx->record)
+        _record_clip(ctx, clip);
 }
 
 }
 
 #define PICASSO_VERSION 21050     // version 2.1.5
 
+mem_allocator global_allocator = { malloc, calloc, realloc, free };
+
+THREAD_LOCAL bool global_stats_enabled = false;
+THREAD_LOCAL picasso::render_stats global_stats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-ps_status global_status = STATUS_SUCCEED;
+THREAD_LOCAL ps_status global_status = STATUS_SUCCEED;
 
 int PICAPI ps_version(void)
 {
@@ -59,6 +73,34 @@ void PICAPI ps_shutdown(void)
     picasso::_destroy_system_device();
 }
 
+ps_bool PICAPI ps_set_allocator(const ps_allocator* allocator)
+{
+    if (picasso::is_valid_system_device()) {
+        // memory allocated must be freed by the same allocator.
+        global_status = STATUS_DEVICE_ERROR;
+        return False;
+    }
+
+    if (allocator) {
+        if (!allocator->malloc_func || !allocator->calloc_func
+            || !allocator->realloc_func || !allocator->free_func) {
+            global_status = STATUS_INVALID_ARGUMENT;
+            return False;
+        }
+        global_allocator.malloc_func = allocator->malloc_func;
+        global_allocator.calloc_func = allocator->calloc_func;
+        global_allocator.realloc_func = allocator->realloc_func;
+        global_allocator.free_func = allocator->free_func;
+    } else {
+        global_allocator.malloc_func = malloc;
+        global_allocator.calloc_func = calloc;
+        global_allocator.realloc_func = realloc;
+        global_allocator.free_func = free;
+    }
+    global_status = STATUS_SUCCEED;
+    return True;
+}
+
 ps_status PICAPI ps_last_status(void)
 {
     return global_status;
@@ -97,9 +139,13 @@ ps_context* PICAPI ps_context_create(ps_canvas* canvas, ps_context* ctx)
             c->parent = 0;
             c->fonts = new picasso::font_engine;
         }
+        new ((void*)&(c->states)) picasso::state_stack;
         new ((void*)&(c->text_matrix)) picasso::trans_affine;
         new ((void*)&(c->path)) picasso::graphic_path;
         new ((void*)&(c->raster)) picasso::raster_adapter;
+        new ((void*)&(c->text_pen)) picasso::cow_data<picasso::graphic_pen>;
+        new ((void*)&(c->text_brush)) picasso::cow_data<picasso::graphic_brush>;
+        c->record = 0;
         global_status = STATUS_SUCCEED;
         return c;
     } else {
@@ -144,6 +190,131 @@ ps_canvas* PICAPI ps_context_get_canvas(ps_context* ctx)
     return canvas;
 }
 
+ps_bool PICAPI ps_get_memory_stats(const ps_context* ctx, ps_memory_stats* stats)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return False;
+    }
+
+    if (!stats) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return False;
+    }
+
+    picasso::memory_stats s;
+    memset(&s, 0, sizeof(picasso::memory_stats));
+
+    if (ctx) {
+        ps_context* c = const_cast<ps_context*>(ctx);
+        c->raster.memory_usage(&s);
+        c->canvas->p->memory_usage(&s);
+        c->fonts->memory_usage(&s);
+        s.path += c->path.capacity_byte_size() + c->state->clip->path.capacity_byte_size();
+    } else {
+        s.glyph = picasso::glyph_cache_pool::byte_size();
+        s.font = platform_font_bytes();
+    }
+
+    stats->raster_bytes = s.raster;
+    stats->scanline_bytes = s.scanline;
+    stats->span_bytes = s.span;
+    stats->shadow_bytes = s.shadow;
+    stats->path_bytes = s.path;
+    stats->glyph_bytes = s.glyph;
+    stats->font_bytes = s.font;
+    stats->total_bytes = s.raster + s.scanline + s.span + s.shadow + s.path + s.glyph + s.font;
+    global_status = STATUS_SUCCEED;
+    return True;
+}
+
+void PICAPI ps_context_trim(ps_context* ctx)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!ctx) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    ctx->raster.trim();
+    ctx->canvas->p->trim();
+    ctx->fonts->trim();
+    ctx->path.trim();
+    global_status = STATUS_SUCCEED;
+}
+
+void PICAPI ps_trim_caches(void)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    picasso::glyph_cache_pool::purge();
+    global_status = STATUS_SUCCEED;
+}
+
+void PICAPI ps_enable_stats(ps_bool enable)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    global_stats_enabled = enable ? true : false;
+    global_status = STATUS_SUCCEED;
+}
+
+ps_bool PICAPI ps_get_stats(ps_stats* stats)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return False;
+    }
+
+    if (!stats) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return False;
+    }
+
+    stats->vertices = global_stats.vertices;
+    stats->cells = global_stats.cells;
+    stats->sorted_cells = global_stats.sorted_cells;
+    stats->scanlines = global_stats.scanlines;
+    stats->spans = global_stats.spans;
+    for (int i = 0; i < COMPOSITE_ERROR; i++)
+        stats->composite_pixels[i] = global_stats.pixels[i];
+    stats->glyph_hits = global_stats.glyph_hits;
+    stats->glyph_misses = global_stats.glyph_misses;
+    stats->clip_rebuilds = global_stats.clip_rebuilds;
+    stats->shadow_blurs = global_stats.shadow_blurs;
+    stats->flatten_ns = global_stats.nsec[picasso::stats_flatten];
+    stats->stroke_ns = global_stats.nsec[picasso::stats_stroke];
+    stats->cells_ns = global_stats.nsec[picasso::stats_cells];
+    stats->sort_ns = global_stats.nsec[picasso::stats_sort];
+    stats->sweep_ns = global_stats.nsec[picasso::stats_sweep];
+    stats->blend_ns = global_stats.nsec[picasso::stats_blend];
+    global_status = STATUS_SUCCEED;
+    return True;
+}
+
+void PICAPI ps_reset_stats(void)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    int op = global_stats.comp_op;
+    memset(&global_stats, 0, sizeof(picasso::render_stats));
+    global_stats.comp_op = op;
+    global_status = STATUS_SUCCEED;
+}
+
 ps_context* PICAPI ps_context_ref(ps_context* ctx)
 {
     if (!picasso::is_valid_system_device()) {
@@ -175,12 +346,17 @@ void PICAPI ps_context_unref(ps_context* ctx)
 
     ctx->refcount--;
     if (ctx->refcount <= 0) {
+        if (ctx->record)
+            ps_picture_unref(ctx->record);
         ps_canvas_unref(ctx->canvas);
-        while (ctx->state) {
+        while (ctx->state->next) {
             picasso::context_state * p = ctx->state;
             ctx->state = ctx->state->next;
-            delete p;
+            p->~context_state();
+            ctx->states.pop();
         }
+        delete ctx->state;
+        (&ctx->states)->state_stack::~state_stack();
         if (ctx->parent) {
             ps_context_unref(ctx->parent);
         } else {
@@ -189,6 +365,8 @@ void PICAPI ps_context_unref(ps_context* ctx)
         (&ctx->path)->graphic_path::~graphic_path();
         (&ctx->raster)->raster_adapter::~raster_adapter();
         (&ctx->text_matrix)->trans_affine::~trans_affine();
+        (&ctx->text_pen)->picasso::cow_data<picasso::graphic_pen>::~cow_data();
+        (&ctx->text_brush)->picasso::cow_data<picasso::graphic_brush>::~cow_data();
         mem_free(ctx);
     }
     global_status = STATUS_SUCCEED;
@@ -205,8 +383,8 @@ void PICAPI ps_set_source_gradient(ps_context* ctx, const ps_gradient* gradient)
         global_status = STATUS_INVALID_ARGUMENT;
         return;
     }
-    ctx->state->brush.clear(); //clear source
-    ctx->state->brush.set_gradient_brush(const_cast<ps_gradient*>(gradient));
+    ctx->state->brush.write().clear(); //clear source
+    ctx->state->brush.write().set_gradient_brush(const_cast<ps_gradient*>(gradient));
     global_status = STATUS_SUCCEED;
 }
 
@@ -227,8 +405,8 @@ void PICAPI ps_set_source_pattern(ps_context* ctx, const ps_pattern* pattern)
         return;
     }
 
-    ctx->state->brush.clear(); //clear source
-    ctx->state->brush.set_pattern_brush(const_cast<ps_pattern*>(pattern));
+    ctx->state->brush.write().clear(); //clear source
+    ctx->state->brush.write().set_pattern_brush(const_cast<ps_pattern*>(pattern));
     global_status = STATUS_SUCCEED;
 }
 
@@ -249,8 +427,8 @@ void PICAPI ps_set_source_image(ps_context* ctx, const ps_image* image)
         return;
     }
 
-    ctx->state->brush.clear(); //clear source
-    ctx->state->brush.set_image_brush(const_cast<ps_image*>(image));
+    ctx->state->brush.write().clear(); //clear source
+    ctx->state->brush.write().set_image_brush(const_cast<ps_image*>(image));
     global_status = STATUS_SUCCEED;
 }
 
@@ -266,11 +444,11 @@ void PICAPI ps_set_source_color(ps_context* ctx, const ps_color* color)
         return;
     }
 
-    ctx->state->brush.clear(); //clear source
-    ctx->state->brush.color.r = FLT_TO_SCALAR(color->r);
-    ctx->state->brush.color.g = FLT_TO_SCALAR(color->g);
-    ctx->state->brush.color.b = FLT_TO_SCALAR(color->b);
-    ctx->state->brush.color.a = FLT_TO_SCALAR(color->a);
+    ctx->state->brush.write().clear(); //clear source
+    ctx->state->brush.write().color.r = FLT_TO_SCALAR(color->r);
+    ctx->state->brush.write().color.g = FLT_TO_SCALAR(color->g);
+    ctx->state->brush.write().color.b = FLT_TO_SCALAR(color->b);
+    ctx->state->brush.write().color.a = FLT_TO_SCALAR(color->a);
     global_status = STATUS_SUCCEED;
 }
 
@@ -291,8 +469,8 @@ void PICAPI ps_set_source_canvas(ps_context* ctx, const ps_canvas* canvas)
         return;
     }
 
-    ctx->state->brush.clear(); //clear source
-    ctx->state->brush.set_canvas_brush(const_cast<ps_canvas*>(canvas));
+    ctx->state->brush.write().clear(); //clear source
+    ctx->state->brush.write().set_canvas_brush(const_cast<ps_canvas*>(canvas));
     global_status = STATUS_SUCCEED;
 }
 
@@ -308,10 +486,10 @@ void PICAPI ps_set_stroke_color(ps_context* ctx, const ps_color* color)
         return;
     }
 
-    ctx->state->pen.color.r = FLT_TO_SCALAR(color->r);
-    ctx->state->pen.color.g = FLT_TO_SCALAR(color->g);
-    ctx->state->pen.color.b = FLT_TO_SCALAR(color->b);
-    ctx->state->pen.color.a = FLT_TO_SCALAR(color->a);
+    ctx->state->pen.write().color.r = FLT_TO_SCALAR(color->r);
+    ctx->state->pen.write().color.g = FLT_TO_SCALAR(color->g);
+    ctx->state->pen.write().color.b = FLT_TO_SCALAR(color->b);
+    ctx->state->pen.write().color.a = FLT_TO_SCALAR(color->a);
     global_status = STATUS_SUCCEED;
 }
 
@@ -346,9 +524,17 @@ void PICAPI ps_stroke(ps_context* ctx)
         return;
     }
 
-    ctx->canvas->p->render_shadow(ctx->state, ctx->path, false, true);
-    ctx->canvas->p->render_stroke(ctx->state, ctx->raster, ctx->path);
-    ctx->canvas->p->render_blur(ctx->state);
+    if (ctx->record) {
+        if (!picasso::_record_shape(ctx, picasso::picture_op_stroke, ctx->path)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
+    } else {
+        ctx->canvas->p->render_shadow(ctx->state, ctx->path, false, true);
+        ctx->canvas->p->render_stroke(ctx->state, ctx->raster, ctx->path);
+        ctx->canvas->p->render_blur(ctx->state);
+        picasso::_damage_raster(ctx->canvas, ctx->state, ctx->raster, true);
+    }
     ctx->path.free_all();
     ctx->raster.reset();
     global_status = STATUS_SUCCEED;
@@ -366,9 +552,17 @@ void PICAPI ps_fill(ps_context* ctx)
         return;
     }
 
-    ctx->canvas->p->render_shadow(ctx->state, ctx->path, true, false);
-    ctx->canvas->p->render_fill(ctx->state, ctx->raster, ctx->path);
-    ctx->canvas->p->render_blur(ctx->state);
+    if (ctx->record) {
+        if (!picasso::_record_shape(ctx, picasso::picture_op_fill, ctx->path)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
+    } else {
+        ctx->canvas->p->render_shadow(ctx->state, ctx->path, true, false);
+        ctx->canvas->p->render_fill(ctx->state, ctx->raster, ctx->path);
+        ctx->canvas->p->render_blur(ctx->state);
+        picasso::_damage_raster(ctx->canvas, ctx->state, ctx->raster, true);
+    }
     ctx->path.free_all();
     ctx->raster.reset();
     global_status = STATUS_SUCCEED;
@@ -386,9 +580,17 @@ void PICAPI ps_paint(ps_context* ctx)
         return;
     }
 
-    ctx->canvas->p->render_shadow(ctx->state, ctx->path, true, true);
-    ctx->canvas->p->render_paint(ctx->state, ctx->raster, ctx->path);
-    ctx->canvas->p->render_blur(ctx->state);
+    if (ctx->record) {
+        if (!picasso::_record_shape(ctx, picasso::picture_op_paint, ctx->path)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
+    } else {
+        ctx->canvas->p->render_shadow(ctx->state, ctx->path, true, true);
+        ctx->canvas->p->render_paint(ctx->state, ctx->raster, ctx->path);
+        ctx->canvas->p->render_blur(ctx->state);
+        picasso::_damage_raster(ctx->canvas, ctx->state, ctx->raster, true);
+    }
     ctx->path.free_all();
     ctx->raster.reset();
     global_status = STATUS_SUCCEED;
@@ -406,7 +608,15 @@ void PICAPI ps_clear(ps_context* ctx)
         return;
     }
     
-    ctx->canvas->p->render_clear(ctx->state);
+    if (ctx->record) {
+        if (!picasso::_record_shape(ctx, picasso::picture_op_clear, picasso::graphic_path())) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
+    } else {
+        ctx->canvas->p->render_clear(ctx->state);
+        picasso::_damage_clear(ctx->canvas, ctx->state);
+    }
     global_status = STATUS_SUCCEED;
 }
 
@@ -523,10 +733,10 @@ void PICAPI ps_set_shadow(ps_context* ctx, float x, float y, float b)
     else if (b > 1.0f)
         b = 1.0f;
 
-    ctx->state->shadow.use_shadow = true;
-    ctx->state->shadow.x_offset = FLT_TO_SCALAR(x);
-    ctx->state->shadow.y_offset = FLT_TO_SCALAR(y);
-    ctx->state->shadow.blur = FLT_TO_SCALAR(b);
+    ctx->state->shadow.write().use_shadow = true;
+    ctx->state->shadow.write().x_offset = FLT_TO_SCALAR(x);
+    ctx->state->shadow.write().y_offset = FLT_TO_SCALAR(y);
+    ctx->state->shadow.write().blur = FLT_TO_SCALAR(b);
     global_status = STATUS_SUCCEED;
 }
 
@@ -542,7 +752,7 @@ void PICAPI ps_set_shadow_color(ps_context* ctx, const ps_color* c)
         return;
     }
 
-    ctx->state->shadow.color = 
+    ctx->state->shadow.write().color = 
         picasso::rgba(FLT_TO_SCALAR(c->r), FLT_TO_SCALAR(c->g), FLT_TO_SCALAR(c->b), FLT_TO_SCALAR(c->a));
     global_status = STATUS_SUCCEED;
 }
@@ -559,7 +769,7 @@ void PICAPI ps_reset_shadow(ps_context* ctx)
         return;
     }
 
-    ctx->state->shadow = picasso::shadow_state();
+    ctx->state->shadow.write() = picasso::shadow_state();
     global_status = STATUS_SUCCEED;
 }
 
@@ -575,14 +785,14 @@ ps_fill_rule PICAPI ps_set_fill_rule(ps_context* ctx, ps_fill_rule rule)
         return FILL_RULE_ERROR;
     }
 
-    ps_fill_rule rl = (ps_fill_rule)(ctx->state->brush.rule);
+    ps_fill_rule rl = (ps_fill_rule)(ctx->state->brush->rule);
     switch (rule) 
     {
         case FILL_RULE_WINDING:
-            ctx->state->brush.rule = picasso::fill_non_zero;
+            ctx->state->brush.write().rule = picasso::fill_non_zero;
             break;
         case FILL_RULE_EVEN_ODD:
-            ctx->state->brush.rule = picasso::fill_even_odd;
+            ctx->state->brush.write().rule = picasso::fill_even_odd;
             break;
         default:
             global_status = STATUS_UNKNOWN_ERROR;
@@ -607,13 +817,13 @@ void PICAPI ps_set_line_cap(ps_context* ctx, ps_line_cap line_cap)
     switch (line_cap) 
     {
         case LINE_CAP_BUTT:
-            ctx->state->pen.cap = picasso::butt_cap;
+            ctx->state->pen.write().cap = picasso::butt_cap;
             break;
         case LINE_CAP_SQUARE:
-            ctx->state->pen.cap = picasso::square_cap;
+            ctx->state->pen.write().cap = picasso::square_cap;
             break;
         case LINE_CAP_ROUND:
-            ctx->state->pen.cap = picasso::round_cap;
+            ctx->state->pen.write().cap = picasso::round_cap;
             break;
         default:
             global_status = STATUS_UNKNOWN_ERROR;
@@ -637,16 +847,16 @@ void PICAPI ps_set_line_inner_join(ps_context* ctx, ps_line_inner_join line_inne
     switch (line_inner_join) 
     {
         case LINE_INNER_MITER:
-            ctx->state->pen.inner = picasso::inner_miter;
+            ctx->state->pen.write().inner = picasso::inner_miter;
             break;
         case LINE_INNER_ROUND:
-            ctx->state->pen.inner = picasso::inner_round;
+            ctx->state->pen.write().inner = picasso::inner_round;
             break;
         case LINE_INNER_BEVEL:
-            ctx->state->pen.inner = picasso::inner_bevel;
+            ctx->state->pen.write().inner = picasso::inner_bevel;
             break;
         case LINE_INNER_JAG:
-            ctx->state->pen.inner = picasso::inner_jag;
+            ctx->state->pen.write().inner = picasso::inner_jag;
             break;
         default:
             global_status = STATUS_UNKNOWN_ERROR;
@@ -670,19 +880,19 @@ void PICAPI ps_set_line_join(ps_context* ctx, ps_line_join line_join)
     switch (line_join) 
     {
         case LINE_JOIN_MITER:
-            ctx->state->pen.join = picasso::miter_join;
+            ctx->state->pen.write().join = picasso::miter_join;
             break;
         case LINE_JOIN_MITER_REVERT:
-            ctx->state->pen.join = picasso::miter_join_revert;
+            ctx->state->pen.write().join = picasso::miter_join_revert;
             break;
         case LINE_JOIN_MITER_ROUND:
-            ctx->state->pen.join = picasso::miter_join_round;
+            ctx->state->pen.write().join = picasso::miter_join_round;
             break;
         case LINE_JOIN_ROUND:
-            ctx->state->pen.join = picasso::round_join;
+            ctx->state->pen.write().join = picasso::round_join;
             break;
         case LINE_JOIN_BEVEL:
-            ctx->state->pen.join = picasso::bevel_join;
+            ctx->state->pen.write().join = picasso::bevel_join;
             break;
         default:
             global_status = STATUS_UNKNOWN_ERROR;
@@ -706,8 +916,8 @@ float PICAPI ps_set_line_width(ps_context* ctx, float width)
     if (width < 0.0f)
         width = 0.0f;
 
-    float rw = SCALAR_TO_FLT(ctx->state->pen.width);
-    ctx->state->pen.width = FLT_TO_SCALAR(width);
+    float rw = SCALAR_TO_FLT(ctx->state->pen->width);
+    ctx->state->pen.write().width = FLT_TO_SCALAR(width);
     global_status = STATUS_SUCCEED;
     return rw;
 }
@@ -727,8 +937,8 @@ float PICAPI ps_set_miter_limit(ps_context* ctx, float limit)
     if (limit < 0.0f)
         limit = 0.0f;
 
-    float rd = SCALAR_TO_FLT(ctx->state->pen.miter_limit);
-    ctx->state->pen.miter_limit = FLT_TO_SCALAR(limit);
+    float rd = SCALAR_TO_FLT(ctx->state->pen->miter_limit);
+    ctx->state->pen.write().miter_limit = FLT_TO_SCALAR(limit);
     global_status = STATUS_SUCCEED;
     return rd;
 }
@@ -748,8 +958,8 @@ void PICAPI ps_set_line_dash(ps_context* ctx, float start, float* dashes, unsign
     if (start < 0.0f)
         start = 0.0f;
 
-    ctx->state->pen.clear_dash();
-    ctx->state->pen.set_dash(start, dashes, num_dashes);
+    ctx->state->pen.write().clear_dash();
+    ctx->state->pen.write().set_dash(start, dashes, num_dashes);
     global_status = STATUS_SUCCEED;
 }
 
@@ -765,7 +975,7 @@ void PICAPI ps_reset_line_dash(ps_context* ctx)
         return;
     }
 
-    ctx->state->pen.clear_dash();
+    ctx->state->pen.write().clear_dash();
     global_status = STATUS_SUCCEED;
 }
 
@@ -1320,9 +1530,9 @@ void PICAPI ps_clip(ps_context* ctx)
         return;
     }
 
-    ctx->state->clip.type = picasso::clip_content;
-    picasso::_clip_path(ctx->state, ctx->path, ctx->state->brush.rule);
-    ctx->canvas->p->render_clip(ctx->state, true);
+    ctx->state->clip.write().type = picasso::clip_content;
+    picasso::_clip_path(ctx->state, ctx->path, ctx->state->brush->rule);
+    picasso::_render_clip(ctx, true);
     ctx->path.free_all();
     global_status = STATUS_SUCCEED;
 }
@@ -1339,9 +1549,9 @@ void PICAPI ps_clip_path(ps_context* ctx, const ps_path* p, ps_fill_rule r)
         return;
     }    
 
-    ctx->state->clip.type = picasso::clip_content;
+    ctx->state->clip.write().type = picasso::clip_content;
     picasso::_clip_path(ctx->state, p->path, (picasso::filling_rule)r);
-    ctx->canvas->p->render_clip(ctx->state, true);
+    picasso::_render_clip(ctx, true);
     global_status = STATUS_SUCCEED;
 }
 
@@ -1368,16 +1578,16 @@ void PICAPI ps_clip_device_rect(ps_context* ctx, const ps_rect* r)
     mtx.transform(&(tr.x1), &(tr.y1));
     mtx.transform(&(tr.x2), &(tr.y2));
 
-    if (ctx->state->clip.type == picasso::clip_device) { //clip device rect.
-        picasso::rect_s cr = ctx->state->clip.rect;
+    if (ctx->state->clip->type == picasso::clip_device) { //clip device rect.
+        picasso::rect_s cr = ctx->state->clip->rect;
         if (cr.clip(tr)) {
-            ctx->state->clip.rect = cr;
+            ctx->state->clip.write().rect = cr;
         }
     } else {
-        ctx->state->clip.rect = tr;
+        ctx->state->clip.write().rect = tr;
     }
-    ctx->state->clip.type = picasso::clip_device;
-    ctx->canvas->p->render_clip(ctx->state, true);
+    ctx->state->clip.write().type = picasso::clip_device;
+    picasso::_render_clip(ctx, true);
     global_status = STATUS_SUCCEED;
 }
 
@@ -1400,9 +1610,9 @@ void PICAPI ps_clip_rect(ps_context* ctx, const ps_rect* r)
     path.hline_rel(-FLT_TO_SCALAR(r->w));
     path.end_poly();
 
-    ctx->state->clip.type = picasso::clip_content;
+    ctx->state->clip.write().type = picasso::clip_content;
     picasso::_clip_path(ctx->state, path, picasso::fill_non_zero);
-    ctx->canvas->p->render_clip(ctx->state, true);
+    picasso::_render_clip(ctx, true);
     global_status = STATUS_SUCCEED;
 }
 
@@ -1426,9 +1636,9 @@ void PICAPI ps_clip_rects(ps_context* ctx, const ps_rect* rs, unsigned int num_r
         path.hline_rel(-FLT_TO_SCALAR(rs[i].w));
         path.end_poly();
     }
-    ctx->state->clip.type = picasso::clip_content;
+    ctx->state->clip.write().type = picasso::clip_content;
     picasso::_clip_path(ctx->state, path, picasso::fill_non_zero);
-    ctx->canvas->p->render_clip(ctx->state, true);
+    picasso::_render_clip(ctx, true);
     global_status = STATUS_SUCCEED;
 }
 
@@ -1444,11 +1654,11 @@ void PICAPI ps_reset_clip(ps_context* ctx)
         return;
     }
 
-    ctx->canvas->p->render_clip(ctx->state, false);
-    ctx->state->clip.rule = picasso::fill_non_zero;
-    ctx->state->clip.path.free_all();
-    ctx->state->clip.rect = picasso::rect_s(0,0,0,0);
-    ctx->state->clip.type = picasso::clip_none;
+    picasso::_render_clip(ctx, false);
+    ctx->state->clip.write().rule = picasso::fill_non_zero;
+    ctx->state->clip.write().path.free_all();
+    ctx->state->clip.write().rect = picasso::rect_s(0,0,0,0);
+    ctx->state->clip.write().type = picasso::clip_none;
     global_status = STATUS_SUCCEED;
 }
 
@@ -1464,12 +1674,15 @@ void PICAPI ps_save(ps_context* ctx)
          return;
     }
 
-    picasso::context_state * new_state = new picasso::context_state(*ctx->state); //copy constructor
-    if (!new_state) {
+    void* slot = ctx->states.push();
+    if (!slot) {
         global_status = STATUS_OUT_OF_MEMORY;
         return;
     }
 
+    // pen, brush, clip and shadow are shared until modified.
+    picasso::context_state * new_state = new (slot) picasso::context_state(*ctx->state);
+
     new_state->next = ctx->state;
     ctx->state = new_state;
     global_status = STATUS_SUCCEED;
@@ -1491,9 +1704,10 @@ void PICAPI ps_restore(ps_context* ctx)
 
     ctx->state = ctx->state->next;
 
-    if (old_state->clip.is_not_same(ctx->state->clip)) {
-        ctx->canvas->p->render_clip(ctx->state, false);
-        ctx->canvas->p->render_clip(ctx->state, true);
+    // clip is shared with the saved state unless modified after ps_save.
+    if (!old_state->clip.is_same(ctx->state->clip)) {
+        picasso::_render_clip(ctx, false);
+        picasso::_render_clip(ctx, true);
     }
 
     if ((old_state->gamma != ctx->state->gamma) 
@@ -1501,7 +1715,8 @@ void PICAPI ps_restore(ps_context* ctx)
         ctx->canvas->p->render_gamma(ctx->state, ctx->raster);
     }
 
-    delete old_state;
+    old_state->~context_state();
+    ctx->states.pop();
     global_status = STATUS_SUCCEED;
 }
 
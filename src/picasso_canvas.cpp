@@ -5,10 +5,12 @@
  */
 
 #include "common.h"
+#include "thread_lock.h"
 #include "device.h"
 #include "graphic_path.h"
 #include "geometry.h"
 #include "convert.h"
+#include "graphic_helper.h"
 
 #include "picasso.h"
 #include "picasso_global.h"
@@ -102,6 +104,161 @@ static inline painter* get_painter_from_format(ps_color_format fmt)
     }
 }
 
+static inline rect _rect_union(const rect& a, const rect& b)
+{
+    return rect(MIN(a.x1, b.x1), MIN(a.y1, b.y1), MAX(a.x2, b.x2), MAX(a.y2, b.y2));
+}
+
+static inline scalar _rect_area(const rect& r)
+{
+    return INT_TO_SCALAR(r.x2 - r.x1) * INT_TO_SCALAR(r.y2 - r.y1);
+}
+
+// pixels of device clip, renderer rounds the edges and keeps x2 and y2 in.
+static inline rect _clip_device_bounds(const context_state* state)
+{
+    const rect_s& c = state->clip->rect;
+    return rect(_iround(c.x1), _iround(c.y1), _iround(c.x2) + 1, _iround(c.y2) + 1);
+}
+
+// merge the pair of rectangles which add least area, until no more than max.
+static void _merge_damage(rect* rs, unsigned int& num, unsigned int max)
+{
+    while (num > max) {
+        unsigned int mi = 0, mj = 1;
+        scalar best = 0;
+        for (unsigned int i = 0; i < num; i++) {
+            for (unsigned int j = i + 1; j < num; j++) {
+                scalar cost = _rect_area(_rect_union(rs[i], rs[j])) - _rect_area(rs[i]) - _rect_area(rs[j]);
+                if ((!i && (j == 1)) || (cost < best)) {
+                    best = cost;
+                    mi = i;
+                    mj = j;
+                }
+            }
+        }
+        rs[mi] = _rect_union(rs[mi], rs[mj]);
+        rs[mj] = rs[--num];
+    }
+}
+
+// canvas which shares the pixels, through the images created between them.
+static ps_canvas* _host_canvas(const ps_canvas* canvas)
+{
+    unsigned int flage = canvas->flage;
+    void* host = canvas->host;
+
+    while (host) {
+        if (flage == buffer_alloc_canvas)
+            return static_cast<ps_canvas*>(host);
+        if (flage != buffer_alloc_image)
+            break;
+        flage = static_cast<ps_image*>(host)->flage;
+        host = static_cast<ps_image*>(host)->host;
+    }
+    return 0;
+}
+
+// position of canvas in the host, both are rows of the same stride.
+static void _host_position(const ps_canvas* canvas, const ps_canvas* host, int* x, int* y)
+{
+    int stride = host->buffer.stride();
+    int offset = (int)(canvas->buffer.buffer() - host->buffer.buffer());
+    int row = offset / stride;
+    int bytes = offset - row * stride;
+    if (bytes < 0) {
+        bytes += (stride > 0) ? stride : -stride;
+        row += (stride > 0) ? -1 : 1;
+    }
+    *x = bytes / _byte_pre_color(host->fmt);
+    *y = row;
+}
+
+// damage rectangles are half open, x2 and y2 are out of them.
+void _canvas_damage(ps_canvas* canvas, const rect& r)
+{
+    rect dr(r);
+    if (!dr.clip(rect(0, 0, canvas->buffer.width(), canvas->buffer.height())) || (dr.x1 == dr.x2) || (dr.y1 == dr.y2))
+        return;
+
+    // pixels are shared with the host, damage it too.
+    ps_canvas* host = _host_canvas(canvas);
+    if (host) {
+        int x = 0, y = 0;
+        _host_position(canvas, host, &x, &y);
+        _canvas_damage(host, rect(dr.x1 + x, dr.y1 + y, dr.x2 + x, dr.y2 + y));
+    }
+
+    scoped_lock guard(canvas->damage_lock);
+
+    // absorb the rectangles overlap or touch with the new one.
+    unsigned int i = 0;
+    while (i < canvas->num_damage) {
+        const rect& d = canvas->damage[i];
+        if ((d.x1 <= dr.x1) && (d.y1 <= dr.y1) && (d.x2 >= dr.x2) && (d.y2 >= dr.y2))
+            return; // already damaged.
+
+        if ((d.x1 <= dr.x2) && (dr.x1 <= d.x2) && (d.y1 <= dr.y2) && (dr.y1 <= d.y2)) {
+            dr = _rect_union(d, dr);
+            canvas->damage[i] = canvas->damage[--canvas->num_damage];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    canvas->damage[canvas->num_damage++] = dr;
+    _merge_damage(canvas->damage, canvas->num_damage, MAX_DAMAGE_RECTS);
+}
+
+void _damage_raster(ps_canvas* canvas, const context_state* state, raster_adapter& raster, bool effects)
+{
+    if (effects && (state->blur > FLT_TO_SCALAR(0.0f))) {
+        // blur the whole canvas.
+        _canvas_damage(canvas, rect(0, 0, canvas->buffer.width(), canvas->buffer.height()));
+        return;
+    }
+
+    rect r;
+    if (!raster.raster_bounds(&r))
+        return;
+
+    r.x2++; // raster bounds include the last pixel.
+    r.y2++;
+
+    if (effects && state->shadow->use_shadow) {
+        // shadow spill, same as shadow layer of painter, one more for the floored offset.
+        int spill = SCALAR_TO_INT(Ceil(state->shadow->blur * 40 + 5));
+        int dx = SCALAR_TO_INT(Floor(state->shadow->x_offset));
+        int dy = SCALAR_TO_INT(Floor(state->shadow->y_offset));
+        rect sr(r.x1 + dx - spill, r.y1 + dy - spill, r.x2 + dx + spill + 1, r.y2 + dy + spill + 1);
+        if (state->clip->type == clip_device)
+            sr.clip(_clip_device_bounds(state));
+        _canvas_damage(canvas, sr);
+    }
+
+    if (state->clip->type == clip_device)
+        r.clip(_clip_device_bounds(state));
+    _canvas_damage(canvas, r);
+}
+
+void _damage_clear(ps_canvas* canvas, const context_state* state)
+{
+    rect r(0, 0, canvas->buffer.width(), canvas->buffer.height());
+    if (state->clip->type == clip_device) {
+        r.clip(_clip_device_bounds(state));
+    } else if (state->clip->type == clip_content) {
+        scalar x1 = 1, y1 = 1, x2 = 0, y2 = 0;
+        conv_transform tp(state->clip->path, state->world_matrix);
+        bounding_rect(tp, 0, &x1, &y1, &x2, &y2);
+        if (x1 > x2 || y1 > y2)
+            return;
+        r.clip(rect(SCALAR_TO_INT(Floor(x1)), SCALAR_TO_INT(Floor(y1)),
+                    SCALAR_TO_INT(Ceil(x2)), SCALAR_TO_INT(Ceil(y2))));
+    }
+    _canvas_damage(canvas, r);
+}
+
 }
 
 #ifdef __cplusplus
@@ -132,7 +289,9 @@ ps_canvas* PICAPI ps_canvas_create(ps_color_format fmt, int w, int h)
         p->p = pa;
         p->host = 0;
         p->mask = 0;
+        p->num_damage = 0;
         new ((void*)&(p->buffer)) picasso::rendering_buffer; 
+        new ((void*)&(p->damage_lock)) picasso::thread_lock;
         int pitch = picasso::_byte_pre_color(fmt) * w;
         byte* buf = 0;
         if ((buf = (byte*)BufferAlloc(h * pitch))) {
@@ -190,7 +349,9 @@ ps_canvas* PICAPI ps_canvas_create_compatible(const ps_canvas* c, int w, int h)
         p->p = pa;
         p->host = 0;
         p->mask = 0;
+        p->num_damage = 0;
         new ((void*)&(p->buffer)) picasso::rendering_buffer; 
+        new ((void*)&(p->damage_lock)) picasso::thread_lock;
         int pitch = picasso::_byte_pre_color(c->fmt) * w;
         byte* buf = 0;
         if ((buf = (byte*)BufferAlloc(h * pitch))) {
@@ -256,11 +417,13 @@ ps_canvas* PICAPI ps_canvas_create_from_canvas(ps_canvas* c, const ps_rect* r)
         p->refcount = 1;
         p->fmt = c->fmt;
         p->p = pa;
-        p->flage = buffer_alloc_image;
+        p->flage = buffer_alloc_canvas;
         p->host = (void*)ps_canvas_ref(c);
         p->mask = 0;
+        p->num_damage = 0;
         int bpp = picasso::_byte_pre_color(c->fmt);
         new ((void*)&(p->buffer)) picasso::rendering_buffer; 
+        new ((void*)&(p->damage_lock)) picasso::thread_lock;
         p->buffer.attach(c->buffer.buffer()+_iround(rc.y*c->buffer.stride()+rc.x*bpp), 
                                        _iround(rc.w), _iround(rc.h), c->buffer.stride());
         p->p->attach(p->buffer);
@@ -310,8 +473,10 @@ ps_canvas* PICAPI ps_canvas_create_from_image(ps_image* i, const ps_rect* r)
         p->flage = buffer_alloc_image;
         p->host = (void*)ps_image_ref(i);
         p->mask = 0;
+        p->num_damage = 0;
         int bpp = picasso::_byte_pre_color(i->fmt);
         new ((void*)&(p->buffer)) picasso::rendering_buffer; 
+        new ((void*)&(p->damage_lock)) picasso::thread_lock;
         p->buffer.attach(i->buffer.buffer()+_iround(rc.y*i->buffer.stride()+rc.x*bpp), 
                                        _iround(rc.w), _iround(rc.h), i->buffer.stride());
         p->p->attach(p->buffer);
@@ -349,7 +514,9 @@ ps_canvas* PICAPI ps_canvas_create_with_data(ps_byte * addr, ps_color_format fmt
         p->flage = buffer_alloc_none;
         p->host = 0;
         p->mask = 0;
+        p->num_damage = 0;
         new ((void*)&(p->buffer)) picasso::rendering_buffer; 
+        new ((void*)&(p->damage_lock)) picasso::thread_lock;
         p->buffer.attach(addr, w, h, pitch);
         p->p->attach(p->buffer);
         global_status = STATUS_SUCCEED;
@@ -402,7 +569,7 @@ ps_canvas* PICAPI ps_canvas_ref(ps_canvas* canvas)
         return 0;
     }
 
-    canvas->refcount++;
+    atomic_increment(&canvas->refcount);
     global_status = STATUS_SUCCEED;
     return canvas;
 }
@@ -419,8 +586,7 @@ void PICAPI ps_canvas_unref(ps_canvas* canvas)
         return;
     }
 
-    canvas->refcount--;
-    if (canvas->refcount <= 0) {
+    if (atomic_decrement(&canvas->refcount) <= 0) {
         delete canvas->p; //mem_free painter
         if (canvas->flage == buffer_alloc_surface)
             BufferFree(canvas->buffer.buffer());
@@ -435,6 +601,7 @@ void PICAPI ps_canvas_unref(ps_canvas* canvas)
             ps_mask_unref(canvas->mask);
 
         (&canvas->buffer)->picasso::rendering_buffer::~rendering_buffer();
+        (&canvas->damage_lock)->picasso::thread_lock::~thread_lock();
         mem_free(canvas);
     }
     global_status = STATUS_SUCCEED;
@@ -533,13 +700,76 @@ void PICAPI ps_canvas_bitblt(ps_canvas* src, const ps_rect* r, ps_canvas* dst, c
     }
 
     if (r) {
+        // source rectangle of renderer include the right and bottom edge.
         picasso::rect rc(_iround(r->x), _iround(r->y), 
-                         _iround(r->x+r->w), _iround(r->y+r->h));
+                         _iround(r->x+r->w) - 1, _iround(r->y+r->h) - 1);
         src->p->render_copy(src->buffer, &rc, dst->p, x, y);
+
+        // the part out of source is not copied.
+        picasso::rect sr(rc);
+        if (sr.clip(picasso::rect(0, 0, src->buffer.width() - 1, src->buffer.height() - 1)))
+            picasso::_canvas_damage(dst, picasso::rect(x + sr.x1 - rc.x1, y + sr.y1 - rc.y1,
+                                                       x + sr.x2 - rc.x1 + 1, y + sr.y2 - rc.y1 + 1));
     } else {
         src->p->render_copy(src->buffer, 0, dst->p, x, y);
+        picasso::_canvas_damage(dst, picasso::rect(x, y, x + src->buffer.width(), y + src->buffer.height()));
+    }
+
+    global_status = STATUS_SUCCEED;
+}
+
+unsigned int PICAPI ps_canvas_get_damage(const ps_canvas* canvas, ps_rect* rects, unsigned int max)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return 0;
+    }
+
+    if (!canvas) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return 0;
+    }
+
+    picasso::rect damage[MAX_DAMAGE_RECTS + 1];
+    unsigned int num = 0;
+    {
+        picasso::scoped_lock guard(const_cast<ps_canvas*>(canvas)->damage_lock);
+        num = canvas->num_damage;
+        for (unsigned int i = 0; i < num; i++)
+            damage[i] = canvas->damage[i];
+    }
+
+    if (!rects || !max) {
+        global_status = STATUS_SUCCEED;
+        return num;
+    }
+
+    picasso::_merge_damage(damage, num, max);
+
+    for (unsigned int i = 0; i < num; i++) {
+        rects[i].x = (float)damage[i].x1;
+        rects[i].y = (float)damage[i].y1;
+        rects[i].w = (float)(damage[i].x2 - damage[i].x1);
+        rects[i].h = (float)(damage[i].y2 - damage[i].y1);
+    }
+    global_status = STATUS_SUCCEED;
+    return num;
+}
+
+void PICAPI ps_canvas_reset_damage(ps_canvas* canvas)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!canvas) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
     }
 
+    picasso::scoped_lock guard(canvas->damage_lock);
+    canvas->num_damage = 0;
     global_status = STATUS_SUCCEED;
 }
 
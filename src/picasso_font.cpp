@@ -15,31 +15,137 @@
 #include "picasso_private.h"
 #include "picasso_painter.h"
 #include "picasso_font.h"
+#include "render_stats.h"
 
 namespace picasso {
 
+static inline unsigned int _font_key_hash(const font_key& key)
+{
+    const unsigned int* p = (const unsigned int*)&key;
+    unsigned int h = 2166136261u;
+    for (unsigned int i = 0; i < sizeof(font_key) / sizeof(unsigned int); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h & (FONT_BUCKETS - 1);
+}
+
+static inline unsigned int _text_layout_hash(const text_layout_key& key, const void* text, unsigned int size)
+{
+    const byte* p = (const byte*)text;
+    unsigned int h = 2166136261u ^ key.length;
+    for (unsigned int i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
 font_engine::font_engine(unsigned int max_fonts)
-    : m_fonts(pod_allocator<font_adapter*>::allocate(max_fonts))
+    : m_num_layouts(0)
+    , m_head(0)
+    , m_tail(0)
     , m_current(0)
     , m_max_fonts(max_fonts)
     , m_num_fonts(0)
-    , m_signature(0)
     , m_stamp_change(false)
     , m_antialias(false)
 {
-    memset(m_fonts, 0, sizeof(font_adapter*) * max_fonts);
-    m_signature = (char*)mem_calloc(1, MAX_FONT_NAME_LENGTH + 128);
+    memset(m_layouts, 0, sizeof(m_layouts));
+    memset(m_buckets, 0, sizeof(m_buckets));
 }
 
 font_engine::~font_engine()
 {
-    if (m_signature)
-        mem_free(m_signature);
+    for (unsigned int i = 0; i < m_num_layouts; i++)
+        delete m_layouts[i];
 
-    for (unsigned int i = 0; i < m_num_fonts; ++i) 
-        delete m_fonts[i];
-    
-    pod_allocator<font_adapter*>::deallocate(m_fonts, m_max_fonts);
+    while (m_head) 
+        remove_font(m_head);
+}
+
+const graphic_path* font_engine::find_layout(const text_layout_key& key, const char* name, const void* text, unsigned int size)
+{
+    if (!m_num_layouts || !size || size > MAX_LAYOUT_TEXT)
+        return 0;
+
+    unsigned int hash = _text_layout_hash(key, text, size);
+    for (unsigned int i = 0; i < m_num_layouts; i++) {
+        text_layout* l = m_layouts[i];
+        if ((l->hash == hash) && (l->size == size)
+            && (memcmp(&l->key, &key, sizeof(text_layout_key)) == 0)
+            && (strcmp(l->name, name) == 0)
+            && (memcmp(l->text, text, size) == 0)) {
+            // move to front
+            memmove(m_layouts + 1, m_layouts, i * sizeof(text_layout*));
+            m_layouts[0] = l;
+            return &l->path;
+        }
+    }
+    return 0;
+}
+
+void font_engine::store_layout(const text_layout_key& key, const char* name, const void* text, unsigned int size, const graphic_path& path)
+{
+    if (!size || size > MAX_LAYOUT_TEXT)
+        return;
+
+    text_layout* l = 0;
+    if (m_num_layouts == MAX_TEXT_LAYOUTS) { // reuse the least recently used
+        l = m_layouts[--m_num_layouts];
+        mem_free(l->text);
+        l->text = 0;
+    } else {
+        l = new text_layout;
+        if (!l)
+            return;
+    }
+
+    l->text = (byte*)mem_malloc(size);
+    if (!l->text) {
+        delete l;
+        return;
+    }
+
+    mem_copy(l->text, text, size);
+    l->size = size;
+    l->key = key;
+    strncpy(l->name, name, MAX_FONT_NAME_LENGTH - 1);
+    l->name[MAX_FONT_NAME_LENGTH - 1] = 0;
+    l->hash = _text_layout_hash(key, text, size);
+    l->path = path;
+
+    memmove(m_layouts + 1, m_layouts, m_num_layouts * sizeof(text_layout*));
+    m_layouts[0] = l;
+    m_num_layouts++;
+}
+
+void font_engine::memory_usage(memory_stats* s)
+{
+    for (unsigned int i = 0; i < m_num_layouts; i++)
+        s->path += m_layouts[i]->path.capacity_byte_size() + m_layouts[i]->size;
+
+    // glyph caches are shared with the other contexts use the same font.
+    for (font_adapter* f = m_head; f; f = f->m_lru_next) {
+        s->path += f->m_path_adaptor.capacity_byte_size();
+        f->m_mask_raster.memory_usage(s);
+
+        f->m_cache->lock();
+        s->glyph += f->m_cache->byte_size();
+        f->m_cache->unlock();
+    }
+}
+
+void font_engine::trim(void)
+{
+    for (unsigned int i = 0; i < m_num_layouts; i++)
+        delete m_layouts[i];
+    m_num_layouts = 0;
+
+    for (font_adapter* f = m_head; f; f = f->m_lru_next) {
+        f->m_path_adaptor.trim();
+        f->m_mask_raster.trim();
+    }
 }
 
 void font_engine::set_antialias(bool b)
@@ -58,38 +164,87 @@ void font_engine::set_transform(const trans_affine& mtx)
     }
 }
 
-int font_engine::find_font(const char* font_signature)
+font_adapter* font_engine::find_font(const font_key& key, const char* name)
 {
-    for (unsigned int i = 0; i < m_num_fonts; i++) {
-        if(strcmp(m_fonts[i]->signature(), font_signature) == 0) 
-            return (int)i;
+    font_adapter* f = m_buckets[_font_key_hash(key)];
+    while (f) {
+        if ((f->key() == key) && (strcmp(f->desc().name(), name) == 0))
+            return f;
+        f = f->m_hash_next;
     }
-    return -1;
+    return 0;
+}
+
+void font_engine::remove_font(font_adapter* font)
+{
+    font_adapter** p = &m_buckets[_font_key_hash(font->key())];
+    while (*p != font)
+        p = &(*p)->m_hash_next;
+    *p = font->m_hash_next;
+
+    if (font->m_lru_prev)
+        font->m_lru_prev->m_lru_next = font->m_lru_next;
+    else
+        m_head = font->m_lru_next;
+
+    if (font->m_lru_next)
+        font->m_lru_next->m_lru_prev = font->m_lru_prev;
+    else
+        m_tail = font->m_lru_prev;
+
+    if (m_current == font)
+        m_current = 0;
+
+    m_num_fonts--;
+    delete font;
 }
 
 bool font_engine::create_font(const font_desc& desc)
 {
-    if (!font_adapter::create_signature(desc, m_affine, m_antialias, m_signature))
-        return false;
+    font_key key;
+    font_adapter::create_key(desc, m_affine, m_antialias, &key);
 
     if (m_current)
         m_current->deactive();
 
-    int idx = find_font(m_signature);
-    if (idx >= 0) {
-        m_current = m_fonts[idx];
-    } else {
-        if (m_num_fonts >= m_max_fonts) {
-            delete m_fonts[0];
-            mem_copy(m_fonts, m_fonts + 1, (m_max_fonts - 1) * sizeof(font_adapter*)); 
-            m_num_fonts = m_max_fonts - 1;
+    font_adapter* f = find_font(key, desc.name());
+    if (f) {
+        if (f != m_head) { // move to front
+            f->m_lru_prev->m_lru_next = f->m_lru_next;
+            if (f->m_lru_next)
+                f->m_lru_next->m_lru_prev = f->m_lru_prev;
+            else
+                m_tail = f->m_lru_prev;
+
+            f->m_lru_prev = 0;
+            f->m_lru_next = m_head;
+            m_head->m_lru_prev = f;
+            m_head = f;
         }
+    } else {
+        char signature[MAX_FONT_NAME_LENGTH + 128];
+        if (!font_adapter::create_signature(desc, m_affine, m_antialias, signature))
+            return false;
+
+        if (m_num_fonts >= m_max_fonts)
+            remove_font(m_tail);
 
-        m_fonts[m_num_fonts] = new font_adapter(desc, m_signature, m_affine, m_antialias);
-        m_current = m_fonts[m_num_fonts];
+        f = new font_adapter(desc, key, signature, m_affine, m_antialias);
+
+        unsigned int h = _font_key_hash(key);
+        f->m_hash_next = m_buckets[h];
+        m_buckets[h] = f;
+
+        f->m_lru_next = m_head;
+        if (m_head)
+            m_head->m_lru_prev = f;
+        else
+            m_tail = f;
+        m_head = f;
         m_num_fonts++;
     }
 
+    m_current = f;
     m_current->active();
     m_stamp_change = false;
     return true;
@@ -102,9 +257,303 @@ bool font_engine::initialize(void)
 
 void font_engine::shutdown(void)
 {
+    glyph_preloader::shutdown();
+    glyph_cache_pool::shutdown();
     platform_font_shutdown();
 }
 
+// glyph preloader
+struct preload_task {
+    preload_task(const font_desc& d)
+        : desc(d), antialias(false), ranges(0), count(0), done(false), next(0)
+    {
+    }
+
+    ~preload_task()
+    {
+        thread.join();
+        mem_free(ranges);
+    }
+
+    worker_thread thread;
+    font_desc desc;
+    bool antialias;
+    glyph_range* ranges;
+    unsigned int count;
+    bool done;
+    preload_task* next;
+};
+
+static thread_lock g_preload_lock;
+static preload_task* g_preload_tasks = 0;
+static bool g_preload_cancel = false;
+
+static bool preload_cancelled(void)
+{
+    scoped_lock lock(g_preload_lock);
+    return g_preload_cancel;
+}
+
+void glyph_preloader::run(void* data)
+{
+    preload_task* task = static_cast<preload_task*>(data);
+
+    // same font as the context with identity text matrix.
+    trans_affine mtx;
+    font_key key;
+    char signature[MAX_FONT_NAME_LENGTH + 128];
+    font_adapter::create_key(task->desc, mtx, task->antialias, &key);
+    if (font_adapter::create_signature(task->desc, mtx, task->antialias, signature)) {
+        font_adapter* font = new font_adapter(task->desc, key, signature, mtx, task->antialias);
+        font->active();
+        // stop at the data budget, more glyphs will evict the ones loaded before.
+        bool full = font->cache_full();
+        for (unsigned int i = 0; i < task->count && !full && !preload_cancelled(); i++) {
+            unsigned int code = task->ranges[i].first;
+            while (!preload_cancelled()) {
+                const glyph* g = font->get_glyph(code);
+                if (g && task->antialias) {
+                    // coverage masks for all subpixel offsets, text is drawn from them at first frame.
+                    for (unsigned int sub = 0; sub < GLYPH_SUBPIXELS; sub++)
+                        font->get_glyph_mask(g, sub);
+                }
+
+                if ((full = font->cache_full()) || code == task->ranges[i].last)
+                    break;
+                code++;
+            }
+        }
+        font->deactive();
+        delete font;
+    }
+
+    scoped_lock lock(g_preload_lock);
+    task->done = true;
+}
+
+void glyph_preloader::reap(void)
+{
+    // Note: must be called in g_preload_lock.
+    preload_task** p = &g_preload_tasks;
+    while (*p) {
+        preload_task* t = *p;
+        if (t->done) {
+            *p = t->next;
+            delete t; // thread is finished, join will not block.
+        } else {
+            p = &t->next;
+        }
+    }
+}
+
+bool glyph_preloader::preload(const font_desc& desc, const glyph_range* ranges, unsigned int count, bool antialias)
+{
+    scoped_lock lock(g_preload_lock);
+    reap();
+
+    preload_task* task = new preload_task(desc);
+    if (!task)
+        return false;
+
+    task->antialias = antialias;
+    task->ranges = (glyph_range*)mem_malloc(sizeof(glyph_range) * count);
+    if (!task->ranges) {
+        delete task;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        task->ranges[i].first = MIN(ranges[i].first, ranges[i].last);
+        task->ranges[i].last = MAX(ranges[i].first, ranges[i].last);
+    }
+    task->count = count;
+
+    if (!task->thread.start(run, task)) {
+        delete task;
+        return false;
+    }
+
+    task->next = g_preload_tasks;
+    g_preload_tasks = task;
+    return true;
+}
+
+void glyph_preloader::shutdown(void)
+{
+    preload_task* tasks = 0;
+    {
+        scoped_lock lock(g_preload_lock);
+        g_preload_cancel = true;
+        tasks = g_preload_tasks;
+        g_preload_tasks = 0;
+    }
+
+    // workers need the lock to finish, join them out of lock.
+    while (tasks) {
+        preload_task* t = tasks;
+        tasks = tasks->next;
+        delete t;
+    }
+
+    scoped_lock lock(g_preload_lock);
+    g_preload_cancel = false;
+}
+
+// glyph cache pool
+static thread_lock g_cache_lock;
+static glyph_cache_manager* g_cache_head = 0; // most recently used
+static glyph_cache_manager* g_cache_tail = 0; // least recently used
+static unsigned int g_cache_budget = GLYPH_CACHE_BUDGET;
+
+void glyph_cache_pool::unlink_cache(glyph_cache_manager* c)
+{
+    if (c->m_prev)
+        c->m_prev->m_next = c->m_next;
+    else
+        g_cache_head = c->m_next;
+
+    if (c->m_next)
+        c->m_next->m_prev = c->m_prev;
+    else
+        g_cache_tail = c->m_prev;
+
+    c->m_prev = c->m_next = 0;
+}
+
+void glyph_cache_pool::link_cache_head(glyph_cache_manager* c)
+{
+    c->m_prev = 0;
+    c->m_next = g_cache_head;
+    if (g_cache_head)
+        g_cache_head->m_prev = c;
+    else
+        g_cache_tail = c;
+    g_cache_head = c;
+}
+
+glyph_cache_manager* glyph_cache_pool::acquire(const char* font_signature)
+{
+    scoped_lock lock(g_cache_lock);
+
+    glyph_cache_manager* c = g_cache_head;
+    while (c) {
+        if (strcmp(c->signature(), font_signature) == 0)
+            break;
+        c = c->m_next;
+    }
+
+    if (c) {
+        unlink_cache(c);
+    } else {
+        c = new glyph_cache_manager;
+        c->set_signature(font_signature);
+    }
+
+    c->m_refcount++;
+    link_cache_head(c);
+    return c;
+}
+
+void glyph_cache_pool::release(glyph_cache_manager* c)
+{
+    if (!c)
+        return;
+
+    scoped_lock lock(g_cache_lock);
+    c->m_refcount--;
+    if (c->m_refcount <= 0) {
+        if (c->m_detached)
+            delete c; // pool is shutdown already.
+        else
+            trim(); // unused cache can be free now.
+    }
+}
+
+void glyph_cache_pool::set_budget(unsigned int bytes)
+{
+    scoped_lock lock(g_cache_lock);
+    g_cache_budget = bytes;
+    trim();
+}
+
+unsigned int glyph_cache_pool::budget(void)
+{
+    return g_cache_budget;
+}
+
+unsigned int glyph_cache_pool::byte_size(void)
+{
+    scoped_lock lock(g_cache_lock);
+    unsigned int total = 0;
+    for (glyph_cache_manager* c = g_cache_head; c; c = c->m_next) {
+        c->lock();
+        total += c->byte_size();
+        c->unlock();
+    }
+    return total;
+}
+
+void glyph_cache_pool::purge(void)
+{
+    scoped_lock lock(g_cache_lock);
+    glyph_cache_manager* c = g_cache_tail;
+    while (c) {
+        glyph_cache_manager* p = c->m_prev;
+        if (c->m_refcount <= 0) {
+            unlink_cache(c);
+            delete c;
+        }
+        c = p;
+    }
+}
+
+void glyph_cache_pool::trim(void)
+{
+    // Note: must be called in g_cache_lock.
+    // only the caches which no font hold are counted in budget.
+    unsigned int total = 0;
+    glyph_cache_manager* c = g_cache_head;
+    while (c) {
+        if (c->m_refcount <= 0) {
+            c->lock();
+            total += c->byte_size();
+            c->unlock();
+        }
+        c = c->m_next;
+    }
+
+    // free the least recently used caches which no font hold.
+    c = g_cache_tail;
+    while (c && total > g_cache_budget) {
+        glyph_cache_manager* p = c->m_prev;
+        if (c->m_refcount <= 0) {
+            total -= c->byte_size();
+            unlink_cache(c);
+            delete c;
+        }
+        c = p;
+    }
+}
+
+void glyph_cache_pool::shutdown(void)
+{
+    scoped_lock lock(g_cache_lock);
+    while (g_cache_head) {
+        glyph_cache_manager* c = g_cache_head;
+        unlink_cache(c);
+        if (c->m_refcount > 0) {
+            // a font is still alive, it will free the cache when released.
+#if _DEBUG
+            fprintf(stderr, "picasso: glyph cache \"%s\" is still used by %d font(s) at shutdown.\n",
+                    c->signature(), c->m_refcount);
+#endif
+            c->m_detached = true;
+        } else {
+            delete c;
+        }
+    }
+}
+
 // font adapter
 bool font_adapter::create_signature(const font_desc& desc, const trans_affine& mtx, bool anti, char* recv_sig)
 {
@@ -138,6 +587,27 @@ bool font_adapter::create_signature(const font_desc& desc, const trans_affine& m
     return true;
 }
 
+void font_adapter::create_key(const font_desc& desc, const trans_affine& mtx, bool anti, font_key* recv_key)
+{
+    memset(recv_key, 0, sizeof(font_key));
+
+    recv_key->name_hash = desc.name_hash();
+    recv_key->charset = desc.charset();
+    recv_key->height = (int)desc.height();
+    recv_key->weight = (int)desc.weight();
+    recv_key->flags = (desc.italic() ? font_key_italic : 0)
+                    | (desc.hint() ? font_key_hint : 0)
+                    | (desc.flip_y() ? font_key_flip_y : 0)
+                    | (anti ? font_key_antialias : 0);
+
+    recv_key->matrix[0] = fxmath::flt_to_fixed(SCALAR_TO_FLT(mtx.sx()));
+    recv_key->matrix[1] = fxmath::flt_to_fixed(SCALAR_TO_FLT(mtx.sy()));
+    recv_key->matrix[2] = fxmath::flt_to_fixed(SCALAR_TO_FLT(mtx.shx()));
+    recv_key->matrix[3] = fxmath::flt_to_fixed(SCALAR_TO_FLT(mtx.shy()));
+    recv_key->matrix[4] = fxmath::flt_to_fixed(SCALAR_TO_FLT(mtx.tx()));
+    recv_key->matrix[5] = fxmath::flt_to_fixed(SCALAR_TO_FLT(mtx.ty()));
+}
+
 void font_adapter::active(void)
 {
     m_impl->active(); 
@@ -147,26 +617,100 @@ void font_adapter::active(void)
 void font_adapter::deactive(void)
 {
     m_prev_glyph = m_last_glyph = 0;
+    m_cache->lock();
+    unpin_raster_glyph();
+    m_cache->unlock();
     m_impl->deactive();
 }
 
 void font_adapter::add_kerning(scalar* x, scalar* y)
 {
     if (m_prev_glyph && m_last_glyph)
-        m_impl->add_kerning(m_prev_glyph->index, m_last_glyph->index, x, y);
+        add_kerning(m_prev_glyph->index, m_last_glyph->index, x, y);
 }
 
-const glyph* font_adapter::get_glyph(unsigned int code)
+void font_adapter::add_kerning(unsigned int first, unsigned int second, scalar* x, scalar* y)
 {
-    const glyph* gl = m_cache->find_glyph(code);
-    if (gl) {
-        m_prev_glyph = m_last_glyph;
-        m_last_glyph = gl;
-        return gl;
+    if (!first || !second)
+        return;
+
+    scalar dx = 0, dy = 0;
+    m_cache->lock();
+    const glyph_metrics* k = m_cache->find_kerning(first, second);
+    if (k) {
+        dx = k->x;
+        dy = k->y;
+    } else {
+        m_impl->add_kerning(first, second, &dx, &dy);
+        m_cache->cache_kerning(first, second, dx, dy);
+    }
+    m_cache->unlock();
+
+    *x += dx;
+    *y += dy;
+}
+
+bool font_adapter::get_advance(unsigned int code, unsigned int* index, scalar* x, scalar* y)
+{
+    // measure only, outline is not loaded if the glyph is not in cache,
+    // unless the font engine can not measure it without loading.
+    bool ret = true;
+    code &= ~GLYPH_INDEX_CODE;
+    m_cache->lock();
+    const glyph* g = m_cache->find_glyph(code);
+    if (g) {
+        *index = g->index;
+        *x = g->advance_x;
+        *y = g->advance_y;
     } else {
-        if (m_impl->prepare_glyph(code)) {
-            m_prev_glyph = m_last_glyph;
-            gl = m_cache->cache_glyph(code,
+        const glyph_metrics* m = m_cache->find_advance(code);
+        if (m) {
+            *index = m->index;
+            *x = m->x;
+            *y = m->y;
+        } else if (m_impl->glyph_advance(code, index, x, y)) {
+            m_cache->cache_advance(code, *index, *x, *y);
+        } else if ((g = load_glyph(code)) != 0) {
+            *index = g->index;
+            *x = g->advance_x;
+            *y = g->advance_y;
+        } else {
+            ret = false;
+        }
+    }
+    m_cache->unlock();
+    return ret;
+}
+
+bool font_adapter::cache_full(void)
+{
+    m_cache->lock();
+    bool full = m_cache->data_full();
+    m_cache->unlock();
+    return full;
+}
+
+bool font_adapter::prepare_impl_glyph(unsigned int code)
+{
+    if (code & GLYPH_INDEX_CODE)
+        return m_impl->prepare_glyph_index(code & ~GLYPH_INDEX_CODE);
+    else
+        return m_impl->prepare_glyph(code);
+}
+
+const glyph* font_adapter::load_glyph(unsigned int code)
+{
+    // Note: must be called in cache lock.
+    const glyph* gl = m_cache->find_glyph(code);
+    if (unlikely(global_stats_enabled)) {
+        if (gl)
+            global_stats.glyph_hits++;
+        else
+            global_stats.glyph_misses++;
+    }
+
+    if (!gl && prepare_impl_glyph(code)) {
+        glyph* g = m_cache->cache_glyph(code,
                                  m_impl->glyph_index(),
                                  m_impl->data_size(),
                                  m_impl->data_type(),
@@ -174,30 +718,134 @@ const glyph* font_adapter::get_glyph(unsigned int code)
                                  m_impl->height(),
                                  m_impl->advance_x(),
                                  m_impl->advance_y());  
-            m_impl->write_glyph_to(gl->data);
-            m_last_glyph = gl;
-            return gl;
-        }
+        if (g)
+            m_impl->write_glyph_to(g->data);
+        gl = g;
+    }
+    return gl;
+}
+
+const glyph* font_adapter::get_glyph(unsigned int code)
+{
+    m_cache->lock();
+    // Note: sign extended char is not a valid code, it must not be taken as glyph index.
+    const glyph* gl = load_glyph(code & ~GLYPH_INDEX_CODE);
+    m_cache->unlock();
+
+    if (gl) {
+        m_prev_glyph = m_last_glyph;
+        m_last_glyph = gl;
+    }
+    return gl;
+}
+
+const glyph* font_adapter::get_glyph_by_index(unsigned int index)
+{
+    m_cache->lock();
+    const glyph* gl = load_glyph(index | GLYPH_INDEX_CODE);
+    m_cache->unlock();
+    return gl;
+}
+
+void font_adapter::unpin_raster_glyph(void)
+{
+    // Note: must be called in cache lock.
+    if (m_raster_glyph) {
+        m_cache->unpin_glyph(m_raster_glyph);
+        m_raster_glyph = 0;
+    }
+}
+
+void font_adapter::hold_raster_glyph(const glyph* g)
+{
+    // Note: must be called in cache lock.
+    // mono storage and mask refer to cache data, keep it until next raster.
+    if (g != m_raster_glyph) {
+        unpin_raster_glyph();
+        m_cache->pin_glyph(g);
+        m_raster_glyph = g;
+    }
+}
+
+const glyph* font_adapter::prepare_raster_glyph(const glyph* g)
+{
+    // Note: must be called in cache lock.
+    if (m_cache->find_glyph(g->code) != g) {
+        // glyph from other font, its cache is not locked here and can evict it at any time,
+        // use the same code in this font's cache.
+        g = load_glyph(g->code);
+        if (!g)
+            return 0;
+    }
+
+    if (m_cache->is_evicted(g)) {
+        glyph* eg = const_cast<glyph*>(g);
+        if (!prepare_impl_glyph(g->code) || !m_cache->restore_glyph(eg))
+            return 0;
+        m_impl->write_glyph_to(eg->data);
+    }
+
+    hold_raster_glyph(g);
+    return g;
+}
+
+void font_adapter::serialize_glyph(const glyph* g, scalar x, scalar y)
+{
+    if (g->type == glyph_type_mono) {
+        m_mono_storage.serialize_from(g->data, g->data_size, x, y);
+    } else {
+        unsigned int count = 0;
+        unsigned int offset = sizeof(unsigned int);
+        mem_copy(&count, g->data, offset);
+        m_path_adaptor.serialize_from(count, g->data+offset, g->data_size-offset);
+        m_path_adaptor.translate(x, y);
     }
-    return 0;
 }
 
 bool font_adapter::generate_raster(const glyph* g, scalar x, scalar y)
 {
     if (g) {
-        if (g->type == glyph_type_mono) {
-            m_mono_storage.serialize_from(g->data, g->data_size, x, y);
-            return true;
-        } else {
-            unsigned int count = 0;
-            unsigned int offset = sizeof(unsigned int);
-            mem_copy(&count, g->data, offset);
-            m_path_adaptor.serialize_from(count, g->data+offset, g->data_size-offset);
-            m_path_adaptor.translate(x, y);
-        }
-        return true;
+        m_cache->lock();
+        g = prepare_raster_glyph(g);
+        if (g)
+            serialize_glyph(g, x, y);
+        m_cache->unlock();
+        return g ? true : false;
     } else
         return false;
 }
 
+const glyph_mask* font_adapter::get_glyph_mask(const glyph* g, unsigned int subpixel)
+{
+    const glyph_mask* m = 0;
+    m_cache->lock();
+    if (g && (g->type == glyph_type_outline) && (m_cache->find_glyph(g->code) == g)) {
+        m = m_cache->find_mask(g, subpixel);
+        if (m) {
+            hold_raster_glyph(g);
+        } else if (prepare_raster_glyph(g)) {
+            serialize_glyph(g, INT_TO_SCALAR(subpixel) / GLYPH_SUBPIXELS, 0);
+
+            trans_affine mtx;
+            conv_curve curve(m_path_adaptor);
+            m_mask_raster.set_raster_method(raster_fill);
+            m_mask_raster.set_fill_attr(FIA_FILL_RULE, fill_non_zero);
+            m_mask_raster.set_transform(mtx);
+            m_mask_raster.add_shape(curve);
+            m_mask_raster.commit();
+
+            rect r(0, 0, -1, -1); // blank glyph
+            m_mask_raster.raster_bounds(&r);
+            glyph_mask* nm = m_cache->cache_mask(g, subpixel, r);
+            if (nm && nm->width)
+                m_mask_raster.raster_coverage(nm->covers, r);
+
+            m_mask_raster.reset();
+            m = nm;
+        }
+    }
+    m_cache->unlock();
+    return m;
+}
+
 }
@@ -14,6 +14,7 @@
 #include "graphic_path.h"
 #include "picasso_global.h"
 #include "picasso_matrix.h"
+#include "picasso_raster_adapter.h"
 #include "picasso_font_cache.h"
 
 #if ENABLE(LOW_MEMORY)
@@ -24,6 +25,18 @@
 
 #define MAX_FONT_NAME_LENGTH 128
 
+// hash buckets of font engine, must be power of 2.
+#define FONT_BUCKETS 32
+
+#if ENABLE(LOW_MEMORY)
+#define MAX_TEXT_LAYOUTS 4
+#else
+#define MAX_TEXT_LAYOUTS 16
+#endif
+
+// longer text is not kept in layout cache.
+#define MAX_LAYOUT_TEXT 1024
+
 namespace picasso {
 
 enum {
@@ -31,23 +44,34 @@ enum {
     charset_unicode,
 };
 
+inline unsigned int font_name_hash(const char* name)
+{
+    unsigned int h = 2166136261u; // FNV-1a
+    while (name && *name) {
+        h ^= (unsigned char)(*name++);
+        h *= 16777619u;
+    }
+    return h;
+}
+
 // font desc
 class font_desc
 {
 public:
     font_desc()
-        : m_name(0), m_charset(charset_latin)
+        : m_name(0), m_name_hash(0), m_charset(charset_latin)
         , m_height(0), m_weight(0), m_italic(false), m_hint(false), m_flip_y(false)
     {
     }
 
     font_desc(const char* face_name)
-        : m_name(0), m_charset(charset_latin)
+        : m_name(0), m_name_hash(0), m_charset(charset_latin)
         , m_height(0), m_weight(0), m_italic(false), m_hint(false), m_flip_y(false)
     {
         size_t len = MIN(strlen(face_name)+1, MAX_FONT_NAME_LENGTH);
         m_name = (char*)mem_malloc(len);
         strncpy(m_name, face_name, len);
+        m_name_hash = font_name_hash(m_name);
     }
 
     ~font_desc()
@@ -62,6 +86,7 @@ public:
         m_name = (char*)mem_malloc(len);
         strncpy(m_name, o.m_name, len);
 
+        m_name_hash = o.m_name_hash;
         m_charset = o.m_charset;
         m_height = o.m_height;
         m_weight = o.m_weight;
@@ -82,6 +107,7 @@ public:
         m_name = (char*)mem_malloc(len);
         strncpy(m_name, o.m_name, len);
 
+        m_name_hash = o.m_name_hash;
         m_charset = o.m_charset;
         m_height = o.m_height;
         m_weight = o.m_weight;
@@ -100,6 +126,7 @@ public:
     void set_flip_y(bool f) { m_flip_y = f; }
 
     const char* name(void) const { return m_name; }
+    unsigned int name_hash(void) const { return m_name_hash; }
     int charset(void) const { return m_charset; }
     scalar height(void) const { return m_height; }
     scalar weight(void) const { return m_weight; }
@@ -109,6 +136,7 @@ public:
 
 private:
     char*  m_name;
+    unsigned int m_name_hash;
     int    m_charset;
     scalar m_height;
     scalar m_weight;
@@ -119,7 +147,8 @@ private:
 
 inline bool operator == (const font_desc& a, const font_desc& b)
 {
-    return (a.charset() == b.charset()) &&
+    return (a.name_hash() == b.name_hash()) &&
+           (a.charset() == b.charset()) &&
            (a.height() == b.height()) &&
            (a.weight() == b.weight()) &&
            (a.italic() == b.italic()) &&
@@ -129,6 +158,28 @@ inline bool operator == (const font_desc& a, const font_desc& b)
 }
 
 
+// binary key of font adapter
+typedef struct _font_key {
+    unsigned int name_hash;
+    int          charset;
+    int          height;
+    int          weight;
+    unsigned int flags;
+    int          matrix[6]; // fixed point
+} font_key;
+
+enum {
+    font_key_italic    = 1,
+    font_key_hint      = 2,
+    font_key_flip_y    = 4,
+    font_key_antialias = 8,
+};
+
+inline bool operator == (const font_key& a, const font_key& b)
+{
+    return memcmp(&a, &b, sizeof(font_key)) == 0;
+}
+
 // mono glyph storage
 class mono_storage
 {
@@ -183,14 +234,18 @@ private:
 class font_adapter
 {
 public:
-    font_adapter(const font_desc& desc, const char* signature, const trans_affine& mtx, bool antialias)
+    font_adapter(const font_desc& desc, const font_key& key, const char* signature, const trans_affine& mtx, bool antialias)
         : m_desc(desc)
-        , m_cache(new glyph_cache_manager)
+        , m_key(key)
+        , m_cache(glyph_cache_pool::acquire(signature))
         , m_impl(0)
         , m_prev_glyph(0)
         , m_last_glyph(0)
+        , m_raster_glyph(0)
+        , m_hash_next(0)
+        , m_lru_prev(0)
+        , m_lru_next(0)
     {
-        m_cache->set_signature(signature);
         m_impl = get_system_device()->create_font_adapter(desc.name(), desc.charset(), desc.height(),
                                     desc.weight(), desc.italic(), desc.hint(), desc.flip_y(), antialias, mtx.impl());
 
@@ -203,8 +258,12 @@ public:
         // for mono font
         m_mono_storage.clear();
 
+        m_cache->lock();
+        unpin_raster_glyph();
+        m_cache->unlock();
+
         get_system_device()->destroy_font_adapter(m_impl);
-        delete m_cache;
+        glyph_cache_pool::release(m_cache);
     }
 
     scalar height(void) const { return m_impl->height(); }
@@ -214,12 +273,18 @@ public:
     unsigned int units_per_em(void) const { return m_impl->units_per_em(); }
 
     const glyph* get_glyph(unsigned int code);
+    const glyph* get_glyph_by_index(unsigned int index);
 
     const char* signature(void) const { return m_cache->signature(); }
+    const font_key& key(void) const { return m_key; }
     const font_desc& desc(void) const{ return m_desc; }
 
     bool generate_raster(const glyph* g, scalar x, scalar y);
+    const glyph_mask* get_glyph_mask(const glyph* g, unsigned int subpixel);
     void add_kerning(scalar* x, scalar* y);
+    void add_kerning(unsigned int first, unsigned int second, scalar* x, scalar* y);
+    bool get_advance(unsigned int code, unsigned int* index, scalar* x, scalar* y);
+    bool cache_full(void);
     graphic_path& path_adaptor(void) { return m_path_adaptor; }
     mono_storage& mono_adaptor(void) { return m_mono_storage; }
 public:
@@ -227,20 +292,85 @@ public:
     void deactive(void);
 
     static bool create_signature(const font_desc&, const trans_affine& m, bool a, char* recv_sig);
+    static void create_key(const font_desc&, const trans_affine& m, bool a, font_key* recv_key);
 private:
     font_adapter(const font_adapter&);
     font_adapter& operator=(const font_adapter&);
 
+    friend class font_engine;
+
+    const glyph* load_glyph(unsigned int code);
+    bool prepare_impl_glyph(unsigned int code);
+    void unpin_raster_glyph(void);
+    void hold_raster_glyph(const glyph* g);
+    const glyph* prepare_raster_glyph(const glyph* g);
+    void serialize_glyph(const glyph* g, scalar x, scalar y);
+
     font_desc m_desc;
+    font_key m_key;
     glyph_cache_manager * m_cache;
     abstract_font_adapter * m_impl;
     graphic_path m_path_adaptor;
     mono_storage m_mono_storage;
+    raster_adapter m_mask_raster;
     const glyph* m_prev_glyph;
     const glyph* m_last_glyph;
+    const glyph* m_raster_glyph;
+    // manage by font_engine
+    font_adapter* m_hash_next;
+    font_adapter* m_lru_prev;
+    font_adapter* m_lru_next;
 };
 
 
+// parameters of text layout besides the text, compare by memcmp.
+typedef struct _text_layout_key {
+    font_key     font;
+    float        area[4];
+    unsigned int length;
+    int          align;
+    int          kerning;
+} text_layout_key;
+
+// laid out text path of ps_draw_text.
+struct text_layout {
+    text_layout()
+        : hash(0), text(0), size(0)
+    {
+        memset(&key, 0, sizeof(text_layout_key));
+        memset(name, 0, sizeof(name));
+    }
+
+    ~text_layout()
+    {
+        mem_free(text);
+    }
+
+    unsigned int hash;
+    text_layout_key key;
+    char name[MAX_FONT_NAME_LENGTH]; // key has the hash of font name only.
+    byte* text;
+    unsigned int size;
+    graphic_path path;
+};
+
+// range of codes to be preloaded
+typedef struct _glyph_range {
+    unsigned int first;
+    unsigned int last;
+} glyph_range;
+
+// load glyphs into shared glyph caches on worker threads.
+class glyph_preloader
+{
+public:
+    static bool preload(const font_desc& desc, const glyph_range* ranges, unsigned int count, bool antialias);
+    static void shutdown(void);
+private:
+    static void run(void* data);
+    static void reap(void);
+};
+
 // font engine
 class font_engine
 {
@@ -253,23 +383,33 @@ public:
 
     bool create_font(const font_desc& desc);
 
+    const graphic_path* find_layout(const text_layout_key& key, const char* name, const void* text, unsigned int size);
+    void store_layout(const text_layout_key& key, const char* name, const void* text, unsigned int size, const graphic_path& path);
+
     bool stamp_change(void) const { return m_stamp_change; }
     bool antialias(void) const { return m_antialias; }
     font_adapter* current_font(void) const { return m_current; }
 
+    void memory_usage(memory_stats* s);
+    void trim(void);
+
     static bool initialize(void);
     static void shutdown(void);
 private:
     font_engine(const font_engine&);
     font_engine& operator=(const font_engine&);
 
-    int find_font(const char* font_signature);
+    font_adapter* find_font(const font_key& key, const char* name);
+    void remove_font(font_adapter* font);
 
-    font_adapter** m_fonts;
+    text_layout* m_layouts[MAX_TEXT_LAYOUTS]; // most recently used first
+    unsigned int m_num_layouts;
+    font_adapter* m_buckets[FONT_BUCKETS];
+    font_adapter* m_head; // most recently used
+    font_adapter* m_tail;
     font_adapter* m_current;
     unsigned int m_max_fonts;
     unsigned int m_num_fonts;
-    char* m_signature;
     trans_affine m_affine;
     bool m_stamp_change;
     bool m_antialias;
@@ -6,10 +6,12 @@
 
 #include "common.h"
 #include "device.h"
+#include "thread_lock.h"
 
 #include "picasso.h"
 #include "picasso_global.h"
 #include "picasso_font.h"
+#include "picasso_trace.h"
 #include "picasso_objects.h"
 
 namespace picasso {
@@ -64,6 +66,133 @@ static bool inline create_device_font(ps_context* ctx)
         return false;
 }
 
+static inline bool _glyph_mask_enabled(ps_context* ctx)
+{
+    // pre-rasterized glyph coverage can be used for antialias text without transform.
+    // glyphs are blended one by one, overlapped pixels are blended twice, so only
+    // opaque source over text gives the same result with the combined coverage.
+    return (ctx->font_render_type != TEXT_TYPE_MONO)
+        && ctx->state->antialias && (ctx->state->gamma == FLT_TO_SCALAR(1.0f))
+        && (ctx->state->composite == picasso::comp_op_src_over)
+        && (ctx->state->alpha == FLT_TO_SCALAR(1.0f))
+        && (ctx->state->font_fcolor.a == FLT_TO_SCALAR(1.0f))
+        && (ctx->state->brush->rule == picasso::fill_non_zero)
+        && !(ctx->state->world_matrix.type() & ~picasso::matrix_translate);
+}
+
+static inline void _render_glyph(ps_context* ctx, const picasso::glyph* g, scalar x, scalar y, bool use_mask,
+                                                                picasso::trace_scope& trace)
+{
+    if (ctx->record) {
+        picasso::_record_glyph(ctx, g->code, x, y);
+        return;
+    }
+
+    picasso::font_adapter* font = ctx->fonts->current_font();
+
+    if (use_mask && (g->type == picasso::glyph_type_outline)) {
+        // masks are cached at subpixel x offsets, y offset is round to pixel.
+        scalar px = x + Floor(ctx->state->world_matrix.tx());
+        scalar py = y + Floor(ctx->state->world_matrix.ty());
+        int ix = SCALAR_TO_INT(Floor(px));
+        int iy = SCALAR_TO_INT(Floor(py + FLT_TO_SCALAR(0.5f)));
+        int sub = SCALAR_TO_INT(Floor((px - INT_TO_SCALAR(ix)) * GLYPH_SUBPIXELS + FLT_TO_SCALAR(0.5f)));
+        if (sub == GLYPH_SUBPIXELS) {
+            ix++;
+            sub = 0;
+        }
+
+        const picasso::glyph_mask* m = font->get_glyph_mask(g, sub);
+        if (m) {
+            if (m->width) {
+                ctx->canvas->p->render_glyph_mask(ctx->state, m->covers,
+                                    ix + m->left, iy + m->top, m->width, m->height);
+                picasso::_canvas_damage(ctx->canvas, picasso::rect(ix + m->left, iy + m->top,
+                                    ix + m->left + m->width, iy + m->top + m->height));
+                trace.add_bounds(picasso::rect(ix + m->left, iy + m->top,
+                                    ix + m->left + m->width - 1, iy + m->top + m->height - 1));
+            }
+            return;
+        }
+    }
+
+    if (font->generate_raster(g, x, y)) {
+        ctx->canvas->p->render_glyph(ctx->state, ctx->raster, font, g->type);
+        if (g->type == picasso::glyph_type_mono) {
+            // mono glyph is drawn at once, translated by matrix.
+            int tx = SCALAR_TO_INT(Floor(x + ctx->state->world_matrix.tx()));
+            int ty = SCALAR_TO_INT(Floor(y + ctx->state->world_matrix.ty()));
+            picasso::_canvas_damage(ctx->canvas, picasso::rect(tx + g->bounds.x1 - 1, ty + g->bounds.y1 - 1,
+                                    tx + g->bounds.x2 + 2, ty + g->bounds.y2 + 2));
+            trace.add_bounds(picasso::rect(tx + g->bounds.x1 - 1, ty + g->bounds.y1 - 1,
+                                    tx + g->bounds.x2 + 1, ty + g->bounds.y2 + 1));
+        }
+    }
+}
+
+static inline void _trace_glyphs_raster(ps_context* ctx, picasso::trace_scope& trace)
+{
+    picasso::rect r;
+    if (trace.enabled() && ctx->raster.raster_bounds(&r))
+        trace.add_bounds(r);
+}
+
+static inline bool _render_glyphs_raster(ps_context* ctx, picasso::trace_scope& trace)
+{
+    if (ctx->record)
+        return picasso::_record_glyphs(ctx);
+
+    picasso::_damage_raster(ctx->canvas, ctx->state, ctx->raster, false);
+    _trace_glyphs_raster(ctx, trace);
+    ctx->canvas->p->render_glyphs_raster(ctx->state, ctx->raster, ctx->font_render_type);
+    return true;
+}
+
+namespace picasso {
+
+void _draw_picture_glyphs(ps_context* ctx, context_state* state, const picture_op* op)
+{
+    // glyphs are drawn with the state and text attributes they are recorded.
+    context_state* old_state = ctx->state;
+    trans_affine old_matrix = ctx->text_matrix;
+    ps_bool old_antialias = ctx->font_antialias;
+    ps_text_type old_type = ctx->font_render_type;
+
+    ctx->state = state;
+    ctx->text_matrix = op->text_matrix;
+    ctx->font_antialias = op->text_antialias;
+    ctx->font_render_type = op->text_type;
+
+    trace_scope trace("text");
+    trace.glyphs(op->num_glyphs);
+
+    if (create_device_font(ctx)) {
+        bool use_mask = _glyph_mask_enabled(ctx);
+        font_adapter* font = ctx->fonts->current_font();
+        for (unsigned int i = 0; i < op->num_glyphs; i++) {
+            const picture_glyph& pg = op->glyphs[i];
+            const glyph* g = 0;
+            if (pg.code & GLYPH_INDEX_CODE)
+                g = font->get_glyph_by_index(pg.code & ~GLYPH_INDEX_CODE);
+            else
+                g = font->get_glyph(pg.code);
+
+            if (g)
+                _render_glyph(ctx, g, pg.x, pg.y, use_mask, trace);
+        }
+        _damage_raster(ctx->canvas, ctx->state, ctx->raster, false);
+        _trace_glyphs_raster(ctx, trace);
+        ctx->canvas->p->render_glyphs_raster(ctx->state, ctx->raster, ctx->font_render_type);
+    }
+
+    ctx->state = old_state;
+    ctx->text_matrix = old_matrix;
+    ctx->font_antialias = old_antialias;
+    ctx->font_render_type = old_type;
+}
+
+}
+
 static inline void _add_glyph_to_path(ps_context* ctx, picasso::graphic_path& path)    
 {
     picasso::conv_curve curve(ctx->fonts->current_font()->path_adaptor());
@@ -81,6 +210,103 @@ static inline void _add_glyph_to_path(ps_context* ctx, picasso::graphic_path& pa
     }
 }
 
+static void _layout_text(ps_context* ctx, const ps_rect* area, const void* text, unsigned int len,
+                                                        ps_text_align align, picasso::graphic_path& text_path)
+{
+    scalar x = FLT_TO_SCALAR(area->x);
+    scalar y = FLT_TO_SCALAR(area->y);
+
+    // align layout
+    scalar w = 0, h = 0, ay = 0;
+    unsigned int index = 0;
+    bool measured = false;
+
+    if (ctx->state->font->desc.charset() == CHARSET_ANSI) {
+        const char* p = (const char*)text;
+        measured = ctx->fonts->current_font()->get_advance(*p, &index, &w, &ay);
+    } else {
+        const ps_uchar16* p = (const ps_uchar16*)text;
+        measured = ctx->fonts->current_font()->get_advance(*p, &index, &w, &ay);
+    }
+
+    if (measured)
+        h = ctx->fonts->current_font()->height(); //Note: advance_y always 0.
+
+    w *= len; //FIXME: estimate!
+
+    if (align & TEXT_ALIGN_LEFT)
+        x = FLT_TO_SCALAR(area->x);
+    else if (align & TEXT_ALIGN_RIGHT)
+        x = FLT_TO_SCALAR(area->x + (area->w - w));
+    else
+        x = FLT_TO_SCALAR(area->x + (area->w - w)/2);
+
+    if (align & TEXT_ALIGN_TOP) {
+        y = FLT_TO_SCALAR(area->y);
+        y += ctx->fonts->current_font()->ascent();
+    } else if (align & TEXT_ALIGN_BOTTOM) {
+        y = FLT_TO_SCALAR(area->y + (area->h - SCALAR_TO_FLT(h)));
+        y -= ctx->fonts->current_font()->descent();
+    } else {
+        y = FLT_TO_SCALAR(area->y + (area->h - SCALAR_TO_FLT(h))/2);
+        y += (ctx->fonts->current_font()->ascent() - ctx->fonts->current_font()->descent())/2;
+    }
+
+    // draw the text
+    if (ctx->state->font->desc.charset() == CHARSET_ANSI) {
+        const char* p = (const char*)text;
+        while (*p && len) {
+            register char c = *p;
+            const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph(c);
+            if (glyph) {
+                if (ctx->font_kerning)
+                    ctx->fonts->current_font()->add_kerning(&x, &y);
+                if (ctx->fonts->current_font()->generate_raster(glyph, x, y))
+                    _add_glyph_to_path(ctx, text_path);
+
+                x += glyph->advance_x;
+                y += glyph->advance_y;
+            }
+            len--;
+            p++;
+        }
+    } else {
+        const ps_uchar16* p = (const ps_uchar16*)text;
+        while (*p && len) {
+            register ps_uchar16 c = *p;
+            const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph(c);
+            if (glyph) {
+                if (ctx->font_kerning)
+                    ctx->fonts->current_font()->add_kerning(&x, &y);
+                if (ctx->fonts->current_font()->generate_raster(glyph, x, y))
+                    _add_glyph_to_path(ctx, text_path);
+
+                x += glyph->advance_x;
+                y += glyph->advance_y;
+            }
+            len--;
+            p++;
+        }
+    }
+}
+
+static inline unsigned int _text_byte_size(ps_context* ctx, const void* text, unsigned int len)
+{
+    // text is end with zero or length.
+    unsigned int n = 0;
+    if (ctx->state->font->desc.charset() == CHARSET_ANSI) {
+        const char* p = (const char*)text;
+        while (n < len && p[n])
+            n++;
+        return n * sizeof(char);
+    } else {
+        const ps_uchar16* p = (const ps_uchar16*)text;
+        while (n < len && p[n])
+            n++;
+        return n * sizeof(ps_uchar16);
+    }
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -157,7 +383,8 @@ ps_font* PICAPI ps_font_ref(ps_font* f)
         return 0;
     }
 
-    f->refcount++;
+    // fonts may be referenced by states on different threads.
+    atomic_increment(&f->refcount);
     global_status = STATUS_SUCCEED;
     return f;
 }
@@ -174,8 +401,7 @@ void PICAPI ps_font_unref(ps_font* f)
         return;
     }
 
-    f->refcount--;
-    if (f->refcount <= 0) {
+    if (atomic_decrement(&f->refcount) <= 0) {
         (&f->desc)->font_desc::~font_desc();
         mem_free(f);
     }
@@ -291,10 +517,14 @@ void PICAPI ps_text_out_length(ps_context* ctx, float x, float y, const char* te
         return;
     }
 
+    picasso::trace_scope trace("text");
+    trace.glyphs(len);
+
     scalar gx = FLT_TO_SCALAR(x);
     scalar gy = FLT_TO_SCALAR(y);
 
     if (create_device_font(ctx)) {
+        bool use_mask = _glyph_mask_enabled(ctx);
         gy += ctx->fonts->current_font()->ascent();
 
         const char* p = text;
@@ -304,8 +534,7 @@ void PICAPI ps_text_out_length(ps_context* ctx, float x, float y, const char* te
             if (glyph) {
                 if (ctx->font_kerning)
                     ctx->fonts->current_font()->add_kerning(&gx, &gy);
-                if (ctx->fonts->current_font()->generate_raster(glyph, gx, gy)) 
-                   ctx->canvas->p->render_glyph(ctx->state, ctx->raster, ctx->fonts->current_font(), glyph->type);
+                _render_glyph(ctx, glyph, gx, gy, use_mask, trace);
 
                 gx += glyph->advance_x;
                 gy += glyph->advance_y;
@@ -313,7 +542,10 @@ void PICAPI ps_text_out_length(ps_context* ctx, float x, float y, const char* te
             len--;
             p++;
         }
-        ctx->canvas->p->render_glyphs_raster(ctx->state, ctx->raster, ctx->font_render_type);
+        if (!_render_glyphs_raster(ctx, trace)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
     }
     global_status = STATUS_SUCCEED;
 }
@@ -330,10 +562,14 @@ void PICAPI ps_wide_text_out_length(ps_context* ctx, float x, float y, const ps_
         return;
     }
 
+    picasso::trace_scope trace("text");
+    trace.glyphs(len);
+
     scalar gx = FLT_TO_SCALAR(x);
     scalar gy = FLT_TO_SCALAR(y);
 
     if (create_device_font(ctx)) {
+        bool use_mask = _glyph_mask_enabled(ctx);
         gy += ctx->fonts->current_font()->ascent();
 
         const ps_uchar16* p = text;
@@ -343,8 +579,7 @@ void PICAPI ps_wide_text_out_length(ps_context* ctx, float x, float y, const ps_
             if (glyph) {
                 if (ctx->font_kerning)
                     ctx->fonts->current_font()->add_kerning(&gx, &gy);
-                if (ctx->fonts->current_font()->generate_raster(glyph, gx, gy)) 
-                   ctx->canvas->p->render_glyph(ctx->state, ctx->raster, ctx->fonts->current_font(), glyph->type);
+                _render_glyph(ctx, glyph, gx, gy, use_mask, trace);
 
                 gx += glyph->advance_x;
                 gy += glyph->advance_y;
@@ -352,7 +587,10 @@ void PICAPI ps_wide_text_out_length(ps_context* ctx, float x, float y, const ps_
             len--;
             p++;
         }
-        ctx->canvas->p->render_glyphs_raster(ctx->state, ctx->raster, ctx->font_render_type);
+        if (!_render_glyphs_raster(ctx, trace)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
     }
     global_status = STATUS_SUCCEED;
 }
@@ -370,122 +608,93 @@ void PICAPI ps_draw_text(ps_context* ctx, const ps_rect* area, const void* text,
         return;
     }
 
-    scalar x = FLT_TO_SCALAR(area->x);
-    scalar y = FLT_TO_SCALAR(area->y);
+    picasso::trace_scope trace("text");
+    trace.glyphs(len);
 
     picasso::graphic_path text_path;
+    const picasso::graphic_path* draw_path = &text_path;
 
     ps_bool text_antialias = ctx->font_antialias;
     ctx->font_antialias = True;
     if (create_device_font(ctx)) {
-
-        // align layout
-        scalar w = 0, h = 0;
-        const picasso::glyph* glyph_test = 0;
-
-        if (ctx->state->font->desc.charset() == CHARSET_ANSI) {
-            const char* p = (const char*)text;
-            glyph_test = ctx->fonts->current_font()->get_glyph(*p);
+        // static labels are drawn again and again, reuse the layout.
+        picasso::text_layout_key key;
+        memset(&key, 0, sizeof(picasso::text_layout_key));
+        key.font = ctx->fonts->current_font()->key();
+        key.area[0] = area->x;
+        key.area[1] = area->y;
+        key.area[2] = area->w;
+        key.area[3] = area->h;
+        key.length = len;
+        key.align = align;
+        key.kerning = ctx->font_kerning;
+
+        const char* name = ctx->fonts->current_font()->desc().name();
+        unsigned int size = _text_byte_size(ctx, text, len);
+        const picasso::graphic_path* layout = ctx->fonts->find_layout(key, name, text, size);
+        if (layout) {
+            draw_path = layout;
         } else {
-            const ps_uchar16* p = (const ps_uchar16*)text;
-            glyph_test = ctx->fonts->current_font()->get_glyph(*p);
-        }
-
-        if (glyph_test) {
-            w = glyph_test->advance_x;
-            h = glyph_test->height; //Note: advance_y always 0.
-        }
-
-        w *= len; //FIXME: estimate!
-
-        if (align & TEXT_ALIGN_LEFT)
-            x = FLT_TO_SCALAR(area->x);
-        else if (align & TEXT_ALIGN_RIGHT)
-            x = FLT_TO_SCALAR(area->x + (area->w - w));
-        else
-            x = FLT_TO_SCALAR(area->x + (area->w - w)/2);
-
-        if (align & TEXT_ALIGN_TOP) {
-            y = FLT_TO_SCALAR(area->y);
-            y += ctx->fonts->current_font()->ascent();
-        } else if (align & TEXT_ALIGN_BOTTOM) {
-            y = FLT_TO_SCALAR(area->y + (area->h - SCALAR_TO_FLT(h)));
-            y -= ctx->fonts->current_font()->descent();
-        } else {
-            y = FLT_TO_SCALAR(area->y + (area->h - SCALAR_TO_FLT(h))/2);
-            y += (ctx->fonts->current_font()->ascent() - ctx->fonts->current_font()->descent())/2;
-        }
-
-        // draw the text
-        if (ctx->state->font->desc.charset() == CHARSET_ANSI) {
-            const char* p = (const char*)text;
-            while (*p && len) {
-                register char c = *p;
-                const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph(c);
-                if (glyph) {
-                    if (ctx->font_kerning)
-                        ctx->fonts->current_font()->add_kerning(&x, &y);
-                    if (ctx->fonts->current_font()->generate_raster(glyph, x, y))
-                        _add_glyph_to_path(ctx, text_path);
-
-                    x += glyph->advance_x;
-                    y += glyph->advance_y;
-                }
-                len--;
-                p++;
-            }
-        } else {
-            const ps_uchar16* p = (const ps_uchar16*)text;
-            while (*p && len) {
-                register ps_uchar16 c = *p;
-                const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph(c);
-                if (glyph) {
-                    if (ctx->font_kerning)
-                        ctx->fonts->current_font()->add_kerning(&x, &y);
-                    if (ctx->fonts->current_font()->generate_raster(glyph, x, y))
-                        _add_glyph_to_path(ctx, text_path);
-
-                    x += glyph->advance_x;
-                    y += glyph->advance_y;
-                }
-                len--;
-                p++;
-            }
+            _layout_text(ctx, area, text, len, align, text_path);
+            text_path.close_polygon();
+            ctx->fonts->store_layout(key, name, text, size, text_path);
         }
     }
 
-    text_path.close_polygon();
     ctx->font_antialias = text_antialias;
 
-    //store the old color
-    picasso::rgba bc = ctx->state->brush.color;
-    picasso::rgba pc = ctx->state->pen.color;
-
-    ctx->state->brush.color = ctx->state->font_fcolor;
-    ctx->state->pen.color = ctx->state->font_scolor;
-
-    switch (type) {
-        case DRAW_TEXT_FILL:
-            ctx->canvas->p->render_shadow(ctx->state, text_path, true, false);
-            ctx->canvas->p->render_fill(ctx->state, ctx->raster, text_path);
-            ctx->canvas->p->render_blur(ctx->state);
-            break;
-        case DRAW_TEXT_STROKE:
-            ctx->canvas->p->render_shadow(ctx->state, text_path, false, true);
-            ctx->canvas->p->render_stroke(ctx->state, ctx->raster, text_path);
-            ctx->canvas->p->render_blur(ctx->state);
-            break;
-        case DRAW_TEXT_BOTH:
-            ctx->canvas->p->render_shadow(ctx->state, text_path, true, true);
-            ctx->canvas->p->render_paint(ctx->state, ctx->raster, text_path);
-            ctx->canvas->p->render_blur(ctx->state);
-            break;
+    //store the old pen and brush, draw with the context's own copies which have text colors.
+    //the states shared with saved ones are not detached, the copies are not shared except recording.
+    picasso::cow_data<picasso::graphic_brush> brush = ctx->state->brush;
+    picasso::cow_data<picasso::graphic_pen> pen = ctx->state->pen;
+
+    picasso::graphic_brush& text_brush = ctx->text_brush.write();
+    text_brush = brush.get();
+    text_brush.color = ctx->state->font_fcolor;
+
+    picasso::graphic_pen& text_pen = ctx->text_pen.write();
+    text_pen = pen.get();
+    text_pen.color = ctx->state->font_scolor;
+
+    ctx->state->brush = ctx->text_brush;
+    ctx->state->pen = ctx->text_pen;
+
+    bool done = true;
+    if (ctx->record) {
+        int op = picasso::picture_op_paint;
+        if (type == DRAW_TEXT_FILL)
+            op = picasso::picture_op_fill;
+        else if (type == DRAW_TEXT_STROKE)
+            op = picasso::picture_op_stroke;
+        done = picasso::_record_shape(ctx, op, *draw_path);
+    } else {
+        switch (type) {
+            case DRAW_TEXT_FILL:
+                ctx->canvas->p->render_shadow(ctx->state, *draw_path, true, false);
+                ctx->canvas->p->render_fill(ctx->state, ctx->raster, *draw_path);
+                ctx->canvas->p->render_blur(ctx->state);
+                break;
+            case DRAW_TEXT_STROKE:
+                ctx->canvas->p->render_shadow(ctx->state, *draw_path, false, true);
+                ctx->canvas->p->render_stroke(ctx->state, ctx->raster, *draw_path);
+                ctx->canvas->p->render_blur(ctx->state);
+                break;
+            case DRAW_TEXT_BOTH:
+                ctx->canvas->p->render_shadow(ctx->state, *draw_path, true, true);
+                ctx->canvas->p->render_paint(ctx->state, ctx->raster, *draw_path);
+                ctx->canvas->p->render_blur(ctx->state);
+                break;
+        }
+        picasso::_damage_raster(ctx->canvas, ctx->state, ctx->raster, true);
+        _trace_glyphs_raster(ctx, trace);
     }
 
-    ctx->state->brush.color = bc;
-    ctx->state->pen.color = pc;
+    ctx->state->brush = brush;
+    ctx->state->pen = pen;
+    if (ctx->text_brush->data)
+        ctx->text_brush.write().clear(); // not keep the image or gradient alive.
     ctx->raster.reset();
-    global_status = STATUS_SUCCEED;
+    global_status = done ? STATUS_SUCCEED : STATUS_OUT_OF_MEMORY;
 }
 
 ps_size PICAPI ps_get_text_extent(ps_context* ctx, const void* text, unsigned int len)
@@ -503,17 +712,24 @@ ps_size PICAPI ps_get_text_extent(ps_context* ctx, const void* text, unsigned in
     }
 
     scalar width = 0;
+    scalar kern_y = 0; // vertical kerning is not a part of extent.
 
     if (create_device_font(ctx)) {
+        // measure by advance table, glyph outlines are not loaded.
+        picasso::font_adapter* font = ctx->fonts->current_font();
+        unsigned int prev = 0, index = 0;
+        scalar ax = 0, ay = 0;
 
         if (ctx->state->font->desc.charset() == CHARSET_ANSI) {
             const char* p = (const char*)text;
             while (*p && len) {
                 register char c = *p;
-                const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph(c);
-                if (glyph) 
-                    width += glyph->advance_x;
-                
+                if (font->get_advance(c, &index, &ax, &ay)) {
+                    if (ctx->font_kerning)
+                        font->add_kerning(prev, index, &width, &kern_y);
+                    width += ax;
+                    prev = index;
+                }
                 len--;
                 p++;
             }
@@ -521,10 +737,12 @@ ps_size PICAPI ps_get_text_extent(ps_context* ctx, const void* text, unsigned in
             const ps_uchar16* p = (const ps_uchar16*)text;
             while (*p && len) {
                 register ps_uchar16 c = *p;
-                const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph(c);
-                if (glyph) 
-                    width += glyph->advance_x;
-                
+                if (font->get_advance(c, &index, &ax, &ay)) {
+                    if (ctx->font_kerning)
+                        font->add_kerning(prev, index, &width, &kern_y);
+                    width += ax;
+                    prev = index;
+                }
                 len--;
                 p++;
             }
@@ -549,24 +767,60 @@ void PICAPI ps_show_glyphs(ps_context* ctx, float x, float y, ps_glyph* g, unsig
         return;
     }
 
+    picasso::trace_scope trace("text");
+    trace.glyphs(len);
+
     scalar gx = FLT_TO_SCALAR(x);
     scalar gy = FLT_TO_SCALAR(y);
 
     if (create_device_font(ctx)) {
+        bool use_mask = _glyph_mask_enabled(ctx);
         gy += ctx->fonts->current_font()->ascent();
         for (unsigned int i = 0; i < len; i++) {
             const picasso::glyph* glyph = (const picasso::glyph*)g[i].glyph;
             if (glyph) {
                 if (ctx->font_kerning)
                     ctx->fonts->current_font()->add_kerning(&gx, &gy);
-                if (ctx->fonts->current_font()->generate_raster(glyph, gx, gy)) 
-                   ctx->canvas->p->render_glyph(ctx->state, ctx->raster, ctx->fonts->current_font(), glyph->type);
+                _render_glyph(ctx, glyph, gx, gy, use_mask, trace);
 
                 gx += glyph->advance_x;
                 gy += glyph->advance_y;
             }
         }
-        ctx->canvas->p->render_glyphs_raster(ctx->state, ctx->raster, ctx->font_render_type);
+        if (!_render_glyphs_raster(ctx, trace)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
+    }
+    global_status = STATUS_SUCCEED;
+}
+
+void PICAPI ps_draw_glyph_run(ps_context* ctx, const unsigned int* ids, const ps_point* pos, unsigned int count)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!ctx || !ids || !pos || !count) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    picasso::trace_scope trace("text");
+    trace.glyphs(count);
+
+    if (create_device_font(ctx)) {
+        bool use_mask = _glyph_mask_enabled(ctx);
+        for (unsigned int i = 0; i < count; i++) {
+            const picasso::glyph* glyph = ctx->fonts->current_font()->get_glyph_by_index(ids[i]);
+            if (glyph)
+                _render_glyph(ctx, glyph, FLT_TO_SCALAR(pos[i].x), FLT_TO_SCALAR(pos[i].y), use_mask, trace);
+        }
+        if (!_render_glyphs_raster(ctx, trace)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
     }
     global_status = STATUS_SUCCEED;
 }
@@ -706,6 +960,52 @@ ps_font* PICAPI ps_set_font(ps_context* ctx, const ps_font* f)
     return old;
 }
 
+void PICAPI ps_set_glyph_cache_size(unsigned int bytes)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    picasso::glyph_cache_pool::set_budget(bytes);
+    global_status = STATUS_SUCCEED;
+}
+
+ps_bool PICAPI ps_font_preload(const ps_font* f, const ps_unicode_range* ranges, unsigned int count, ps_bool a)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return False;
+    }
+
+    if (!f || !ranges || !count) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return False;
+    }
+
+    picasso::glyph_range* r = (picasso::glyph_range*)mem_malloc(sizeof(picasso::glyph_range) * count);
+    if (!r) {
+        global_status = STATUS_OUT_OF_MEMORY;
+        return False;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        r[i].first = ranges[i].first;
+        r[i].last = ranges[i].last;
+    }
+
+    bool started = picasso::glyph_preloader::preload(f->desc, r, count, a ? true : false);
+    mem_free(r);
+
+    if (!started) {
+        global_status = STATUS_UNKNOWN_ERROR;
+        return False;
+    }
+
+    global_status = STATUS_SUCCEED;
+    return True;
+}
+
 void PICAPI ps_set_text_render_type(ps_context* ctx, ps_text_type type)
 {
     if (!picasso::is_valid_system_device()) {
@@ -11,6 +11,7 @@
 #include "data_vector.h"
 #include "device.h"
 #include "interfaces.h"
+#include "thread_lock.h"
 
 #if ENABLE(LOW_MEMORY)
 #define MAX_CACHE 256
@@ -18,25 +19,173 @@
 #define MAX_CACHE 512
 #endif
 
+#if ENABLE(LOW_MEMORY)
+#define GLYPH_CACHE_BUDGET (1024*1024)
+#define GLYPH_DATA_BUDGET (256*1024)
+#else
+#define GLYPH_CACHE_BUDGET (8*1024*1024)
+#define GLYPH_DATA_BUDGET (2*1024*1024)
+#endif
+
+// subpixel positions of glyph coverage mask in x direction.
+#define GLYPH_SUBPIXELS 4
+
+// glyphs loaded by glyph index are cached with this flag in code.
+#define GLYPH_INDEX_CODE 0x80000000
+
 namespace picasso {
 
+class glyph_cache_pool;
+
+// pre-rasterized antialias coverage of a glyph.
+typedef struct _glyph_mask {
+    int           left;
+    int           top;
+    unsigned int  width;
+    unsigned int  height;
+    byte*         covers;
+} glyph_mask;
+
+// advance or kerning of glyphs, measured without loading outline.
+typedef struct _glyph_metrics {
+    unsigned int key1; // 0 for empty slot
+    unsigned int key2;
+    unsigned int index;
+    scalar       x;
+    scalar       y;
+} glyph_metrics;
+
+// open addressing hash of glyph metrics, records are never removed.
+class metrics_table
+{
+public:
+    metrics_table()
+        : m_items(0)
+        , m_capacity(0)
+        , m_count(0)
+    {
+    }
+
+    ~metrics_table()
+    {
+        mem_free(m_items);
+    }
+
+    unsigned int byte_size(void) const { return m_capacity * sizeof(glyph_metrics); }
+
+    glyph_metrics* find(unsigned int key1, unsigned int key2) const
+    {
+        if (!m_count)
+            return 0;
+
+        unsigned int mask = m_capacity - 1;
+        unsigned int i = hash(key1, key2) & mask;
+        while (m_items[i].key1) {
+            if (m_items[i].key1 == key1 && m_items[i].key2 == key2)
+                return &m_items[i];
+            i = (i + 1) & mask;
+        }
+        return 0;
+    }
+
+    // key1 must not be 0 and the key must not exist.
+    glyph_metrics* insert(unsigned int key1, unsigned int key2)
+    {
+        if ((m_count + 1) * 2 > m_capacity && !grow())
+            return 0;
+
+        glyph_metrics* m = slot(m_items, m_capacity, key1, key2);
+        m->key1 = key1;
+        m->key2 = key2;
+        m_count++;
+        return m;
+    }
+
+private:
+    metrics_table(const metrics_table&);
+    metrics_table& operator=(const metrics_table&);
+
+    static unsigned int hash(unsigned int key1, unsigned int key2)
+    {
+        return (key1 * 2654435761u) ^ (key2 * 40503u);
+    }
+
+    static glyph_metrics* slot(glyph_metrics* items, unsigned int capacity, unsigned int key1, unsigned int key2)
+    {
+        unsigned int mask = capacity - 1;
+        unsigned int i = hash(key1, key2) & mask;
+        while (items[i].key1)
+            i = (i + 1) & mask;
+        return &items[i];
+    }
+
+    bool grow(void)
+    {
+        unsigned int capacity = m_capacity ? (m_capacity << 1) : MAX_CACHE;
+        glyph_metrics* items = (glyph_metrics*)mem_calloc(capacity, sizeof(glyph_metrics));
+        if (!items)
+            return false;
+
+        for (unsigned int n = 0; n < m_capacity; n++)
+            if (m_items[n].key1)
+                *slot(items, capacity, m_items[n].key1, m_items[n].key2) = m_items[n];
+
+        mem_free(m_items);
+        m_items = items;
+        m_capacity = capacity;
+        return true;
+    }
+
+    glyph_metrics* m_items;
+    unsigned int   m_capacity;
+    unsigned int   m_count;
+};
+
+// glyph records are never freed while the cache alive, because they are hold by ps_glyph.
+// only the glyph data can be evicted in least recently used order when over budget,
+// evicted data will be prepared again when it used.
 class glyph_cache_manager 
 {
     enum { 
         block_size = 16384-16
     };  
 
+    typedef struct _glyph_entry {
+        glyph g; // must be first
+        glyph_mask* masks[GLYPH_SUBPIXELS];
+        unsigned int pin;
+        struct _glyph_entry* prev;
+        struct _glyph_entry* next;
+    } glyph_entry;
+
 public:
     glyph_cache_manager()
         : m_allocator(block_size)
         , m_signature(0)
+        , m_glyphs(0)
+        , m_capacity(0)
+        , m_count(0)
+        , m_head(0)
+        , m_tail(0)
+        , m_data_size(0)
+        , m_data_budget(GLYPH_DATA_BUDGET)
+        , m_byte_size(0)
+        , m_refcount(0)
+        , m_detached(false)
+        , m_prev(0)
+        , m_next(0)
     {
-        memset(m_glyphs, 0, sizeof(m_glyphs));
     }
 
     ~glyph_cache_manager()
     {
-        // block_allocator will free all memory.
+        glyph_entry* e = m_head;
+        while (e) {
+            free_payload(e);
+            e = e->next;
+        }
+        mem_free(m_glyphs);
+        // block_allocator will free all glyph records.
     }
 
     void set_signature(const char* font_signature)
@@ -45,16 +194,36 @@ public:
         strcpy(m_signature, font_signature);
     }
 
+    // the cache can be shared by fonts in many threads, 
+    // lookup and store glyphs must be in lock.
+    void lock(void) { m_lock.lock(); }
+    void unlock(void) { m_lock.unlock(); }
+
+    unsigned int byte_size(void) const { return m_byte_size; }
+
+    // more glyph data will evict the least recently used.
+    bool data_full(void) const { return m_data_size >= m_data_budget; }
+
     const char* signature(void) const 
     { 
         return m_signature; 
     }
 
-    const glyph* find_glyph(unsigned int code) const
+    // the data of glyph found may be evicted, need restore before use.
+    glyph* find_glyph(unsigned int code)
     {
-        unsigned int msb = (code >> 8) & 0xFF;
-        if (m_glyphs[msb]) { // find row
-            return m_glyphs[msb][code & 0xFF];
+        if (!m_count)
+            return 0;
+
+        unsigned int mask = m_capacity - 1;
+        unsigned int i = hash(code) & mask;
+        while (m_glyphs[i]) {
+            if (m_glyphs[i]->g.code == code) {
+                if (m_glyphs[i]->prev) // in lru list
+                    touch(m_glyphs[i]);
+                return &m_glyphs[i]->g;
+            }
+            i = (i + 1) & mask;
         }
         return 0;
     }
@@ -62,38 +231,279 @@ public:
     glyph* cache_glyph(unsigned int code, unsigned int index, unsigned int data_size, glyph_type data_type,
                                             const rect& bounds, scalar height, scalar advance_x, scalar advance_y)
     {
-        unsigned int msb = (code >> 8) & 0xFF;
-        if (m_glyphs[msb] == 0) { // cache row is empty.
-            // alloc cache row.
-            m_glyphs[msb] = (glyph**)m_allocator.allocate(sizeof(glyph*) * MAX_CACHE, sizeof(glyph*));
-            memset(m_glyphs[msb], 0, sizeof(glyph*) * MAX_CACHE);
-        }
-
-        unsigned int lsb = code & 0xFF;
-        if (m_glyphs[msb][lsb]) 
+        if (find_glyph(code))
             return 0; // already exists.
 
-        glyph* g = (glyph*)m_allocator.allocate(sizeof(glyph), sizeof(int));
+        if ((m_count + 1) * 2 > m_capacity && !grow_table())
+            return 0;
+
+        glyph_entry* e = (glyph_entry*)m_allocator.allocate(sizeof(glyph_entry), sizeof(void*));
+        m_byte_size += sizeof(glyph_entry);
+
+        e->g.code       = code;
+        e->g.index      = index;
+        e->g.data       = 0;
+        e->g.data_size  = data_size;
+        e->g.type       = data_type;
+        e->g.bounds     = bounds;
+        e->g.height     = height;
+        e->g.advance_x  = advance_x;
+        e->g.advance_y  = advance_y;
+        memset(e->masks, 0, sizeof(e->masks));
+        e->pin = 0;
+        e->prev = e->next = 0;
+
+        unsigned int mask = m_capacity - 1;
+        unsigned int i = hash(code) & mask;
+        while (m_glyphs[i])
+            i = (i + 1) & mask;
+        m_glyphs[i] = e;
+        m_count++;
+
+        if (!restore_glyph(&e->g))
+            return 0;
+        return &e->g;
+    }
+
+    bool is_evicted(const glyph* g) const
+    {
+        return !g->data && g->data_size;
+    }
+
+    // alloc data buffer for a glyph which data has been evicted.
+    bool restore_glyph(glyph* g)
+    {
+        glyph_entry* e = (glyph_entry*)g;
+        if (!is_evicted(g))
+            return true;
+
+        e->g.data = (byte*)mem_malloc(e->g.data_size);
+        if (!e->g.data)
+            return false;
 
-        g->code         = code;
-        g->index        = index;
-        g->data         = m_allocator.allocate(data_size);
-        g->data_size    = data_size;
-        g->type         = data_type;
-        g->bounds       = bounds;
-        g->height        = height;
-        g->advance_x    = advance_x;
-        g->advance_y    = advance_y;
-        return m_glyphs[msb][lsb] = g;
+        m_data_size += e->g.data_size;
+        m_byte_size += e->g.data_size;
+        touch(e);
+        evict(e);
+        return true;
     }
 
+    const glyph_mask* find_mask(const glyph* g, unsigned int subpixel)
+    {
+        glyph_entry* e = (glyph_entry*)g;
+        if (e->masks[subpixel])
+            touch(e);
+        return e->masks[subpixel];
+    }
+
+    // alloc a mask with uninitialized covers, empty rect for blank glyph.
+    glyph_mask* cache_mask(const glyph* g, unsigned int subpixel, const rect& r)
+    {
+        glyph_entry* e = (glyph_entry*)g;
+        unsigned int width = r.x2 - r.x1 + 1;
+        unsigned int height = r.y2 - r.y1 + 1;
+        if (r.x2 < r.x1 || r.y2 < r.y1)
+            width = height = 0;
+
+        unsigned int size = sizeof(glyph_mask) + width * height;
+        glyph_mask* m = (glyph_mask*)mem_malloc(size);
+        if (!m)
+            return 0;
+
+        m->left = r.x1;
+        m->top = r.y1;
+        m->width = width;
+        m->height = height;
+        m->covers = (byte*)m + sizeof(glyph_mask);
+
+        e->masks[subpixel] = m;
+        m_data_size += size;
+        m_byte_size += size;
+        touch(e);
+        evict(e);
+        return m;
+    }
+
+    // advances are keyed by code, kerning by pair of glyph index.
+    const glyph_metrics* find_advance(unsigned int code) const
+    {
+        return m_advances.find(code + 1, 0);
+    }
+
+    const glyph_metrics* cache_advance(unsigned int code, unsigned int index, scalar x, scalar y)
+    {
+        return store_metrics(m_advances, code + 1, 0, index, x, y);
+    }
+
+    const glyph_metrics* find_kerning(unsigned int first, unsigned int second) const
+    {
+        return m_kernings.find(first, second);
+    }
+
+    const glyph_metrics* cache_kerning(unsigned int first, unsigned int second, scalar x, scalar y)
+    {
+        return store_metrics(m_kernings, first, second, 0, x, y);
+    }
+
+    // pinned glyph data will not be evicted.
+    void pin_glyph(const glyph* g) { ((glyph_entry*)g)->pin++; }
+    void unpin_glyph(const glyph* g) { ((glyph_entry*)g)->pin--; }
+
 private:
     glyph_cache_manager(const glyph_cache_manager&);
     glyph_cache_manager& operator=(const glyph_cache_manager&);
 
+    static unsigned int hash(unsigned int code)
+    {
+        return code * 2654435761u; // golden ratio
+    }
+
+    glyph_metrics* store_metrics(metrics_table& table, unsigned int key1, unsigned int key2,
+                                                unsigned int index, scalar x, scalar y)
+    {
+        unsigned int size = table.byte_size();
+        glyph_metrics* m = table.insert(key1, key2);
+        m_byte_size += table.byte_size() - size;
+        if (m) {
+            m->index = index;
+            m->x = x;
+            m->y = y;
+        }
+        return m;
+    }
+
+    bool grow_table(void)
+    {
+        unsigned int capacity = m_capacity ? (m_capacity << 1) : MAX_CACHE;
+        glyph_entry** table = (glyph_entry**)mem_malloc(sizeof(glyph_entry*) * capacity);
+        if (!table)
+            return false;
+
+        memset(table, 0, sizeof(glyph_entry*) * capacity);
+        unsigned int mask = capacity - 1;
+        for (unsigned int n = 0; n < m_capacity; n++) {
+            if (m_glyphs[n]) {
+                unsigned int i = hash(m_glyphs[n]->g.code) & mask;
+                while (table[i])
+                    i = (i + 1) & mask;
+                table[i] = m_glyphs[n];
+            }
+        }
+
+        mem_free(m_glyphs);
+        m_byte_size += sizeof(glyph_entry*) * (capacity - m_capacity);
+        m_glyphs = table;
+        m_capacity = capacity;
+        return true;
+    }
+
+    void link_head(glyph_entry* e)
+    {
+        e->prev = 0;
+        e->next = m_head;
+        if (m_head)
+            m_head->prev = e;
+        else
+            m_tail = e;
+        m_head = e;
+    }
+
+    void unlink(glyph_entry* e)
+    {
+        if (e->prev)
+            e->prev->next = e->next;
+        else
+            m_head = e->next;
+
+        if (e->next)
+            e->next->prev = e->prev;
+        else
+            m_tail = e->prev;
+
+        e->prev = e->next = 0;
+    }
+
+    // entry in lru list when it has data or masks.
+    void touch(glyph_entry* e)
+    {
+        if (e != m_head) {
+            if (e->prev)
+                unlink(e);
+            link_head(e);
+        }
+    }
+
+    unsigned int free_payload(glyph_entry* e)
+    {
+        unsigned int size = e->g.data ? e->g.data_size : 0;
+        mem_free(e->g.data);
+        e->g.data = 0; // keep data_size for restore.
+
+        for (unsigned int i = 0; i < GLYPH_SUBPIXELS; i++) {
+            if (e->masks[i]) {
+                size += sizeof(glyph_mask) + e->masks[i]->width * e->masks[i]->height;
+                mem_free(e->masks[i]);
+                e->masks[i] = 0;
+            }
+        }
+        return size;
+    }
+
+    void evict(glyph_entry* keep)
+    {
+        glyph_entry* e = m_tail;
+        while (e && m_data_size > m_data_budget) {
+            glyph_entry* p = e->prev;
+            if (e != keep && !e->pin) {
+                unlink(e);
+                unsigned int size = free_payload(e);
+                m_data_size -= size;
+                m_byte_size -= size;
+            }
+            e = p;
+        }
+    }
+
+    friend class glyph_cache_pool;
+
     block_allocator m_allocator;
-    glyph**         m_glyphs[MAX_CACHE];
     char*           m_signature;
+    glyph_entry**   m_glyphs;
+    unsigned int    m_capacity;
+    unsigned int    m_count;
+    glyph_entry*    m_head; // most recently used glyph data
+    glyph_entry*    m_tail;
+    unsigned int    m_data_size;
+    unsigned int    m_data_budget;
+    unsigned int    m_byte_size;
+    metrics_table   m_advances;
+    metrics_table   m_kernings;
+    thread_lock     m_lock;
+    // manage by glyph_cache_pool
+    int             m_refcount;
+    bool            m_detached;
+    glyph_cache_manager* m_prev;
+    glyph_cache_manager* m_next;
+};
+
+// process wide glyph caches, shared by all fonts which have same signature.
+class glyph_cache_pool
+{
+public:
+    static glyph_cache_manager* acquire(const char* font_signature);
+    static void release(glyph_cache_manager* cache);
+
+    static void set_budget(unsigned int bytes);
+    static unsigned int budget(void);
+
+    static unsigned int byte_size(void);
+    static void purge(void);
+
+    static void shutdown(void);
+private:
+    static void trim(void);
+    static void unlink_cache(glyph_cache_manager* cache);
+    static void link_cache_head(glyph_cache_manager* cache);
 };
 
 }
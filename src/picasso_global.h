@@ -25,7 +25,7 @@
 #define ABS(x)       (((x) < 0)?(-(x)):(x))
 
 
-// global error code
-extern "C" ps_status global_status;
+// error code of the calling thread
+extern "C" THREAD_LOCAL ps_status global_status;
 
 #endif /*_PICASSO_GLOBAL_H_*/
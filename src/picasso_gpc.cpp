@@ -7,6 +7,7 @@
 #include "common.h"
 #include "picasso.h"
 #include "picasso_gpc.h"
+#include "memory_arena.h"
 
 #include <float.h>
 
@@ -107,6 +108,7 @@ typedef struct v_shape {            /* Internal vertex list datatype     */
 typedef struct p_shape {            /* Internal contour / tristrip type  */
   int                 active;       /* Active flag / vertex count        */
   int                 hole;         /* Hole / external contour flag      */
+  int                 count;        /* Number of vertices in the list    */
   vertex_node        *v[2];         /* Left and right vertex list ptrs   */
   struct p_shape     *next;         /* Pointer to next polygon contour   */
   struct p_shape     *proxy;        /* Pointer to actual structure used  */
@@ -164,6 +166,14 @@ typedef struct bbox_shape {         /* Contour axis-aligned bounding box */
   float             ymax;          /* Maximum y coordinate              */
 } bbox;
 
+typedef struct {                    /* Storage of one clip operation     */
+  mem_arena          arena;         /* Every node is allocated from it   */
+  it_node           *free_it;       /* Released intersection nodes       */
+  st_node           *free_st;       /* Released sorted edge nodes        */
+} gpc_store;
+
+#define ARENA_ALLOC(s, type, n)  ((type*)(s)->arena.alloc((n) * sizeof(type)))
+
 
 /*
 ===========================================================================
@@ -188,29 +198,41 @@ const h_state next_h_state[3][6]=
 ===========================================================================
 */
 
-static void reset_it(it_node **it)
+static void reset_it(gpc_store *store, it_node **it)
 {
   it_node *itn;
 
   while (*it)
   {
     itn= (*it)->next;
-    mem_free(*it);
+    (*it)->next= store->free_it;
+    store->free_it= *it;
     *it= itn;
   }
 }
 
 
-static void reset_lmt(lmt_node **lmt)
+static it_node *new_it_node(gpc_store *store)
 {
-  lmt_node *lmtn;
+  it_node *itn= store->free_it;
 
-  while (*lmt)
-  {
-    lmtn= (*lmt)->next;
-    mem_free(*lmt);
-    *lmt= lmtn;
-  }
+  if (itn)
+    store->free_it= itn->next;
+  else
+    itn= ARENA_ALLOC(store, it_node, 1);
+  return itn;
+}
+
+
+static st_node *new_st_node(gpc_store *store)
+{
+  st_node *stn= store->free_st;
+
+  if (stn)
+    store->free_st= stn->prev;
+  else
+    stn= ARENA_ALLOC(store, st_node, 1);
+  return stn;
 }
 
 
@@ -261,14 +283,14 @@ static void insert_bound(edge_node **b, edge_node *e)
 }
 
 
-static edge_node **bound_list(lmt_node **lmt, float y)
+static edge_node **bound_list(gpc_store *store, lmt_node **lmt, float y)
 {
   lmt_node *existing_node;
 
   if (!*lmt)
   {
     /* Add node onto the tail end of the LMT */
-    (*lmt) = (lmt_node*)mem_malloc(sizeof(lmt_node));
+    (*lmt) = ARENA_ALLOC(store, lmt_node, 1);
     (*lmt)->y = y;
     (*lmt)->first_bound= NULL;
     (*lmt)->next= NULL;
@@ -279,7 +301,7 @@ static edge_node **bound_list(lmt_node **lmt, float y)
     {
       /* Insert a new LMT node before the current node */
       existing_node= *lmt;
-      (*lmt) = (lmt_node*)mem_malloc(sizeof(lmt_node));
+      (*lmt) = ARENA_ALLOC(store, lmt_node, 1);
       (*lmt)->y = y;
       (*lmt)->first_bound= NULL;
       (*lmt)->next= existing_node;
@@ -288,19 +310,19 @@ static edge_node **bound_list(lmt_node **lmt, float y)
     else
       if (y > (*lmt)->y)
         /* Head further up the LMT */
-        return bound_list(&((*lmt)->next), y);
+        return bound_list(store, &((*lmt)->next), y);
       else
         /* Use this existing LMT node */
         return &((*lmt)->first_bound);
 }
 
 
-static void add_to_sbtree(int *entries, sb_tree **sbtree, float y)
+static void add_to_sbtree(gpc_store *store, int *entries, sb_tree **sbtree, float y)
 {
   if (!*sbtree)
   {
     /* Add a new tree node here */
-    (*sbtree) = (sb_tree*)mem_malloc(sizeof(sb_tree));
+    (*sbtree) = ARENA_ALLOC(store, sb_tree, 1);
     (*sbtree)->y = y;
     (*sbtree)->less= NULL;
     (*sbtree)->more= NULL;
@@ -311,14 +333,14 @@ static void add_to_sbtree(int *entries, sb_tree **sbtree, float y)
     if ((*sbtree)->y > y)
     {
     /* Head into the 'less' sub-tree */
-      add_to_sbtree(entries, &((*sbtree)->less), y);
+      add_to_sbtree(store, entries, &((*sbtree)->less), y);
     }
     else
     {
       if ((*sbtree)->y < y)
       {
         /* Head into the 'more' sub-tree */
-        add_to_sbtree(entries, &((*sbtree)->more), y);
+        add_to_sbtree(store, entries, &((*sbtree)->more), y);
       }
     }
   }
@@ -336,17 +358,6 @@ static void build_sbt(int *entries, float *sbt, sb_tree *sbtree)
 }
 
 
-static void free_sbtree(sb_tree **sbtree)
-{
-  if (*sbtree)
-  {
-    free_sbtree(&((*sbtree)->less));
-    free_sbtree(&((*sbtree)->more));
-    mem_free(*sbtree);
-  }
-}
-
-
 static int count_optimal_vertices(gpc_vertex_list c)
 {
   int result= 0, i;
@@ -363,7 +374,7 @@ static int count_optimal_vertices(gpc_vertex_list c)
 }
 
 
-static edge_node *build_lmt(lmt_node **lmt, sb_tree **sbtree,
+static edge_node *build_lmt(gpc_store *store, lmt_node **lmt, sb_tree **sbtree,
                             int *sbt_entries, gpc_polygon *p, int type,
                             gpc_op op)
 {
@@ -375,7 +386,7 @@ static edge_node *build_lmt(lmt_node **lmt, sb_tree **sbtree,
     total_vertices+= count_optimal_vertices(p->contour[c]);
 
   /* Create the entire input polygon edge table in one go */
-  edge_table = (edge_node*)mem_malloc(total_vertices * sizeof(edge_node));
+  edge_table = ARENA_ALLOC(store, edge_node, total_vertices);
 
   for (c= 0; c < p->num_contours; c++)
   {
@@ -395,7 +406,7 @@ static edge_node *build_lmt(lmt_node **lmt, sb_tree **sbtree,
           edge_table[num_vertices].vertex.y= p->contour[c].vertex[i].y;
 
           /* Record vertex in the scanbeam table */
-          add_to_sbtree(sbt_entries, sbtree,
+          add_to_sbtree(store, sbt_entries, sbtree,
                         edge_table[num_vertices].vertex.y);
 
           num_vertices++;
@@ -447,7 +458,7 @@ static edge_node *build_lmt(lmt_node **lmt, sb_tree **sbtree,
             e[i].bside[CLIP]= (op == GPC_DIFF) ? RIGHT : LEFT;
             e[i].bside[SUBJ]= LEFT;
           }
-          insert_bound(bound_list(lmt, edge_table[min].vertex.y), e);
+          insert_bound(bound_list(store, lmt, edge_table[min].vertex.y), e);
         }
       }
 
@@ -497,7 +508,7 @@ static edge_node *build_lmt(lmt_node **lmt, sb_tree **sbtree,
             e[i].bside[CLIP]= (op == GPC_DIFF) ? RIGHT : LEFT;
             e[i].bside[SUBJ]= LEFT;
           }
-          insert_bound(bound_list(lmt, edge_table[min].vertex.y), e);
+          insert_bound(bound_list(store, lmt, edge_table[min].vertex.y), e);
         }
       }
     }
@@ -555,7 +566,7 @@ static void add_edge_to_aet(edge_node **aet, edge_node *edge, edge_node *prev)
 }
 
 
-static void add_intersection(it_node **it, edge_node *edge0, edge_node *edge1,
+static void add_intersection(gpc_store *store, it_node **it, edge_node *edge0, edge_node *edge1,
                              float x, float y)
 {
   it_node *existing_node;
@@ -563,7 +574,7 @@ static void add_intersection(it_node **it, edge_node *edge0, edge_node *edge1,
   if (!*it)
   {
     /* Append a new node to the tail of the list */
-    (*it) = (it_node*)mem_malloc(sizeof(it_node));
+    (*it) = new_it_node(store);
     (*it)->ie[0] = edge0;
     (*it)->ie[1] = edge1;
     (*it)->point.x = x;
@@ -576,7 +587,7 @@ static void add_intersection(it_node **it, edge_node *edge0, edge_node *edge1,
     {
       /* Insert a new node mid-list */
       existing_node= *it;
-      (*it) = (it_node*)mem_malloc(sizeof(it_node));
+      (*it) = new_it_node(store);
       (*it)->ie[0] = edge0;
       (*it)->ie[1] = edge1;
       (*it)->point.x = x;
@@ -585,12 +596,12 @@ static void add_intersection(it_node **it, edge_node *edge0, edge_node *edge1,
     }
     else
       /* Head further down the list */
-      add_intersection(&((*it)->next), edge0, edge1, x, y);
+      add_intersection(store, &((*it)->next), edge0, edge1, x, y);
   }
 }
 
 
-static void add_st_edge(st_node **st, it_node **it, edge_node *edge,
+static void add_st_edge(gpc_store *store, st_node **st, it_node **it, edge_node *edge,
                         float dy)
 {
   st_node *existing_node;
@@ -599,7 +610,7 @@ static void add_st_edge(st_node **st, it_node **it, edge_node *edge,
   if (!*st)
   {
     /* Append edge onto the tail end of the ST */
-    (*st) = (st_node*)mem_malloc(sizeof(st_node));
+    (*st) = new_st_node(store);
     (*st)->edge = edge;
     (*st)->xb = edge->xb;
     (*st)->xt = edge->xt;
@@ -616,7 +627,7 @@ static void add_st_edge(st_node **st, it_node **it, edge_node *edge,
     {
       /* No intersection - insert edge here (before the ST edge) */
       existing_node= *st;
-      (*st) = (st_node*)mem_malloc(sizeof(st_node));
+      (*st) = new_st_node(store);
       (*st)->edge = edge;
       (*st)->xb = edge->xb;
       (*st)->xt = edge->xt;
@@ -631,22 +642,22 @@ static void add_st_edge(st_node **st, it_node **it, edge_node *edge,
       y= r * dy;
 
       /* Insert the edge pointers and the intersection point in the IT */
-      add_intersection(it, (*st)->edge, edge, x, y);
+      add_intersection(store, it, (*st)->edge, edge, x, y);
 
       /* Head further into the ST */
-      add_st_edge(&((*st)->prev), it, edge, dy);
+      add_st_edge(store, &((*st)->prev), it, edge, dy);
     }
   }
 }
 
 
-static void build_intersection_table(it_node **it, edge_node *aet, float dy)
+static void build_intersection_table(gpc_store *store, it_node **it, edge_node *aet, float dy)
 {
   st_node   *st, *stp;
   edge_node *edge;
 
   /* Build intersection table for the current scanbeam */
-  reset_it(it);
+  reset_it(store, it);
   st= NULL;
 
   /* Process each AET edge */
@@ -654,14 +665,15 @@ static void build_intersection_table(it_node **it, edge_node *aet, float dy)
   {
     if ((edge->bstate[ABOVE] == BUNDLE_HEAD) ||
          edge->bundle[ABOVE][CLIP] || edge->bundle[ABOVE][SUBJ])
-      add_st_edge(&st, it, edge, dy);
+      add_st_edge(store, &st, it, edge, dy);
   }
 
-  /* Free the sorted edge table */
+  /* Release the sorted edge table */
   while (st)
   {
     stp= st->prev;
-    mem_free(st);
+    st->prev= store->free_st;
+    store->free_st= st;
     st= stp;
   }
 }
@@ -669,15 +681,12 @@ static void build_intersection_table(it_node **it, edge_node *aet, float dy)
 static int count_contours(polygon_node *polygon)
 {
   int          nc, nv;
-  vertex_node *v, *nextv;
 
   for (nc= 0; polygon; polygon= polygon->next)
     if (polygon->active)
     {
-      /* Count the vertices in the current contour */
-      nv= 0;
-      for (v= polygon->proxy->v[LEFT]; v; v= v->next)
-        nv++;
+      /* The vertices are counted as they are added */
+      nv= polygon->proxy->count;
 
       /* Record valid vertex counts in the active field */
       if (nv > 2)
@@ -687,12 +696,7 @@ static int count_contours(polygon_node *polygon)
       }
       else
       {
-        /* Invalid contour: just free the heap */
-        for (v= polygon->proxy->v[LEFT]; v; v= nextv)
-        {
-          nextv= v->next;
-          mem_free(v);
-        }
+        /* Invalid contour: its vertices go with the arena */
         polygon->active= 0;
       }
     }
@@ -700,12 +704,12 @@ static int count_contours(polygon_node *polygon)
 }
 
 
-static void add_left(polygon_node *p, float x, float y)
+static void add_left(gpc_store *store, polygon_node *p, float x, float y)
 {
   vertex_node *nv;
 
   /* Create a new vertex node and set its fields */
-  nv = (vertex_node*)mem_malloc(sizeof(vertex_node));
+  nv = ARENA_ALLOC(store, vertex_node, 1);
   nv->x= x;
   nv->y= y;
 
@@ -714,6 +718,7 @@ static void add_left(polygon_node *p, float x, float y)
 
   /* Update proxy->[LEFT] to point to nv */
   p->proxy->v[LEFT]= nv;
+  p->proxy->count++;
 }
 
 
@@ -729,6 +734,7 @@ static void merge_left(polygon_node *p, polygon_node *q, polygon_node *list)
     /* Assign p's vertex list to the left end of q's list */
     p->proxy->v[RIGHT]->next= q->proxy->v[LEFT];
     q->proxy->v[LEFT]= p->proxy->v[LEFT];
+    q->proxy->count+= p->proxy->count;
 
     /* Redirect any p->proxy references to q->proxy */
     
@@ -744,12 +750,12 @@ static void merge_left(polygon_node *p, polygon_node *q, polygon_node *list)
 }
 
 
-static void add_right(polygon_node *p, float x, float y)
+static void add_right(gpc_store *store, polygon_node *p, float x, float y)
 {
   vertex_node *nv;
 
   /* Create a new vertex node and set its fields */
-  nv = (vertex_node*)mem_malloc(sizeof(vertex_node));
+  nv = ARENA_ALLOC(store, vertex_node, 1);
   nv->x= x;
   nv->y= y;
   nv->next= NULL;
@@ -759,6 +765,7 @@ static void add_right(polygon_node *p, float x, float y)
 
   /* Update proxy->v[RIGHT] to point to nv */
   p->proxy->v[RIGHT]= nv;
+  p->proxy->count++;
 }
 
 
@@ -774,6 +781,7 @@ static void merge_right(polygon_node *p, polygon_node *q, polygon_node *list)
     /* Assign p's vertex list to the right end of q's list */
     q->proxy->v[RIGHT]->next= p->proxy->v[LEFT];
     q->proxy->v[RIGHT]= p->proxy->v[RIGHT];
+    q->proxy->count+= p->proxy->count;
 
     /* Redirect any p->proxy references to q->proxy */
     for (target= p->proxy; list; list= list->next)
@@ -788,7 +796,7 @@ static void merge_right(polygon_node *p, polygon_node *q, polygon_node *list)
 }
 
 
-static void add_local_min(polygon_node **p, edge_node *edge,
+static void add_local_min(gpc_store *store, polygon_node **p, edge_node *edge,
                           float x, float y)
 {
   polygon_node *existing_min;
@@ -796,10 +804,10 @@ static void add_local_min(polygon_node **p, edge_node *edge,
 
   existing_min= *p;
 
-  (*p) = (polygon_node*)mem_malloc(sizeof(polygon_node));
+  (*p) = ARENA_ALLOC(store, polygon_node, 1);
 
   /* Create a new vertex node and set its fields */
-  nv = (vertex_node*)mem_malloc(sizeof(vertex_node));
+  nv = ARENA_ALLOC(store, vertex_node, 1);
   nv->x= x;
   nv->y= y;
   nv->next= NULL;
@@ -807,6 +815,7 @@ static void add_local_min(polygon_node **p, edge_node *edge,
   /* Initialise proxy to point to p itself */
   (*p)->proxy= (*p);
   (*p)->active= True;
+  (*p)->count= 1;
   (*p)->next= existing_min;
 
   /* Make v[LEFT] and v[RIGHT] point to new vertex nv */
@@ -817,12 +826,12 @@ static void add_local_min(polygon_node **p, edge_node *edge,
   edge->outp[ABOVE]= *p;
 }
 
-static bbox *create_contour_bboxes(gpc_polygon *p)
+static bbox *create_contour_bboxes(gpc_store *store, gpc_polygon *p)
 {
   bbox *box;
   int   c, v;
 
-  box = (bbox*)mem_malloc(p->num_contours * sizeof(bbox));
+  box = ARENA_ALLOC(store, bbox, p->num_contours);
 
   /* Construct contour bounding boxes */
   for (c= 0; c < p->num_contours; c++)
@@ -850,15 +859,15 @@ static bbox *create_contour_bboxes(gpc_polygon *p)
 }
 
 
-static void minimax_test(gpc_polygon *subj, gpc_polygon *clip, gpc_op op)
+static void minimax_test(gpc_store *store, gpc_polygon *subj, gpc_polygon *clip, gpc_op op)
 {
   bbox *s_bbox, *c_bbox;
   int   s, c, *o_table, overlap;
 
-  s_bbox= create_contour_bboxes(subj);
-  c_bbox= create_contour_bboxes(clip);
+  s_bbox= create_contour_bboxes(store, subj);
+  c_bbox= create_contour_bboxes(store, clip);
 
-  o_table = (int*)mem_malloc(subj->num_contours * clip->num_contours * sizeof(int));
+  o_table = ARENA_ALLOC(store, int, subj->num_contours * clip->num_contours);
 
   /* Check all subject contour bounding boxes against clip boxes */
   for (s= 0; s < subj->num_contours; s++)
@@ -895,10 +904,6 @@ static void minimax_test(gpc_polygon *subj, gpc_polygon *clip, gpc_op op)
         subj->contour[s].num_vertices = -subj->contour[s].num_vertices;
     }  
   }
-
-  mem_free(s_bbox);
-  mem_free(c_bbox);
-  mem_free(o_table);
 }
 
 
@@ -927,15 +932,16 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
   sb_tree       *sbtree= NULL;
   it_node       *it= NULL, *intersect;
   edge_node     *edge, *prev_edge, *next_edge, *succ_edge, *e0, *e1;
-  edge_node     *aet= NULL, *c_heap= NULL, *s_heap= NULL;
+  edge_node     *aet= NULL;
   lmt_node      *lmt= NULL, *local_min;
-  polygon_node  *out_poly= NULL, *p, *q, *poly, *npoly, *cf= NULL;
+  polygon_node  *out_poly= NULL, *p, *q, *poly, *cf= NULL;
   vertex_node   *vtx, *nv;
   h_state        horiz[2];
   int            in[2], exists[2], parity[2]= {LEFT, LEFT};
   int            c, v, contributing=0, search, scanbeam= 0, sbt_entries= 0;
   int            vclass, bl=0, br=0, tl=0, tr=0;
   float        *sbt= NULL, xb, px, yb, yt=0, dy=0, ix, iy;
+  gpc_store      store;
 
   /* Test for trivial NULL result cases */
   if (((subj->num_contours == 0) && (clip->num_contours == 0))
@@ -948,16 +954,19 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
     return;
   }
 
+  store.free_it= NULL;
+  store.free_st= NULL;
+
   /* Identify potentialy contributing contours */
   if (((op == GPC_INT) || (op == GPC_DIFF))
    && (subj->num_contours > 0) && (clip->num_contours > 0))
-    minimax_test(subj, clip, op);
+    minimax_test(&store, subj, clip, op);
 
   /* Build LMT */
   if (subj->num_contours > 0)
-    s_heap= build_lmt(&lmt, &sbtree, &sbt_entries, subj, SUBJ, op);
+    build_lmt(&store, &lmt, &sbtree, &sbt_entries, subj, SUBJ, op);
   if (clip->num_contours > 0)
-    c_heap= build_lmt(&lmt, &sbtree, &sbt_entries, clip, CLIP, op);
+    build_lmt(&store, &lmt, &sbtree, &sbt_entries, clip, CLIP, op);
 
   /* Return a NULL result if no contours contribute */
   if (lmt == NULL)
@@ -965,17 +974,13 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
     result->num_contours= 0;
     result->hole= NULL;
     result->contour= NULL;
-    reset_lmt(&lmt);
-    mem_free(s_heap);
-    mem_free(c_heap);
     return;
   }
 
   /* Build scanbeam table from scanbeam tree */
-  sbt = (float*)mem_malloc(sbt_entries * sizeof(float));
+  sbt = ARENA_ALLOC(&store, float, sbt_entries);
   build_sbt(&scanbeam, sbt, sbtree);
   scanbeam= 0;
-  free_sbtree(&sbtree);
 
   /* Allow pointer re-use without causing memory leak */
   if (subj == result)
@@ -1139,28 +1144,28 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           {
           case EMN:
           case IMN:
-            add_local_min(&out_poly, edge, xb, yb);
+            add_local_min(&store, &out_poly, edge, xb, yb);
             px= xb;
             cf= edge->outp[ABOVE];
             break;
           case ERI:
             if (xb != px)
             {
-              add_right(cf, xb, yb);
+              add_right(&store, cf, xb, yb);
               px= xb;
             }
             edge->outp[ABOVE]= cf;
             cf= NULL;
             break;
           case ELI:
-            add_left(edge->outp[BELOW], xb, yb);
+            add_left(&store, edge->outp[BELOW], xb, yb);
             px= xb;
             cf= edge->outp[BELOW];
             break;
           case EMX:
             if (xb != px)
             {
-              add_left(cf, xb, yb);
+              add_left(&store, cf, xb, yb);
               px= xb;
             }
             merge_right(cf, edge->outp[BELOW], out_poly);
@@ -1169,14 +1174,14 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case ILI:
             if (xb != px)
             {
-              add_left(cf, xb, yb);
+              add_left(&store, cf, xb, yb);
               px= xb;
             }
             edge->outp[ABOVE]= cf;
             cf= NULL;
             break;
           case IRI:
-            add_right(edge->outp[BELOW], xb, yb);
+            add_right(&store, edge->outp[BELOW], xb, yb);
             px= xb;
             cf= edge->outp[BELOW];
             edge->outp[BELOW]= NULL;
@@ -1184,7 +1189,7 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case IMX:
             if (xb != px)
             {
-              add_right(cf, xb, yb);
+              add_right(&store, cf, xb, yb);
               px= xb;
             }
             merge_left(cf, edge->outp[BELOW], out_poly);
@@ -1194,34 +1199,34 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case IMM:
             if (xb != px)
         {
-              add_right(cf, xb, yb);
+              add_right(&store, cf, xb, yb);
               px= xb;
         }
             merge_left(cf, edge->outp[BELOW], out_poly);
             edge->outp[BELOW]= NULL;
-            add_local_min(&out_poly, edge, xb, yb);
+            add_local_min(&store, &out_poly, edge, xb, yb);
             cf= edge->outp[ABOVE];
             break;
           case EMM:
             if (xb != px)
         {
-              add_left(cf, xb, yb);
+              add_left(&store, cf, xb, yb);
               px= xb;
         }
             merge_right(cf, edge->outp[BELOW], out_poly);
             edge->outp[BELOW]= NULL;
-            add_local_min(&out_poly, edge, xb, yb);
+            add_local_min(&store, &out_poly, edge, xb, yb);
             cf= edge->outp[ABOVE];
             break;
           case LED:
             if (edge->bot.y == yb)
-              add_left(edge->outp[BELOW], xb, yb);
+              add_left(&store, edge->outp[BELOW], xb, yb);
             edge->outp[ABOVE]= edge->outp[BELOW];
             px= xb;
             break;
           case RED:
             if (edge->bot.y == yb)
-              add_right(edge->outp[BELOW], xb, yb);
+              add_right(&store, edge->outp[BELOW], xb, yb);
             edge->outp[ABOVE]= edge->outp[BELOW];
             px= xb;
             break;
@@ -1272,7 +1277,7 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
     {
       /* === SCANBEAM INTERIOR PROCESSING ============================== */
 
-      build_intersection_table(&it, aet, dy);
+      build_intersection_table(&store, &it, aet, dy);
 
       /* Process each node in the intersection table */
       for (intersect= it; intersect; intersect= intersect->next)
@@ -1339,13 +1344,13 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           switch (vclass)
           {
           case EMN:
-            add_local_min(&out_poly, e0, ix, iy);
+            add_local_min(&store, &out_poly, e0, ix, iy);
             e1->outp[ABOVE]= e0->outp[ABOVE];
             break;
           case ERI:
             if (p)
             {
-              add_right(p, ix, iy);
+              add_right(&store, p, ix, iy);
               e1->outp[ABOVE]= p;
               e0->outp[ABOVE]= NULL;
             }
@@ -1353,7 +1358,7 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case ELI:
             if (q)
             {
-              add_left(q, ix, iy);
+              add_left(&store, q, ix, iy);
               e0->outp[ABOVE]= q;
               e1->outp[ABOVE]= NULL;
             }
@@ -1361,20 +1366,20 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case EMX:
             if (p && q)
             {
-              add_left(p, ix, iy);
+              add_left(&store, p, ix, iy);
               merge_right(p, q, out_poly);
               e0->outp[ABOVE]= NULL;
               e1->outp[ABOVE]= NULL;
             }
             break;
           case IMN:
-            add_local_min(&out_poly, e0, ix, iy);
+            add_local_min(&store, &out_poly, e0, ix, iy);
             e1->outp[ABOVE]= e0->outp[ABOVE];
             break;
           case ILI:
             if (p)
             {
-              add_left(p, ix, iy);
+              add_left(&store, p, ix, iy);
               e1->outp[ABOVE]= p;
               e0->outp[ABOVE]= NULL;
             }
@@ -1382,7 +1387,7 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case IRI:
             if (q)
             {
-              add_right(q, ix, iy);
+              add_right(&store, q, ix, iy);
               e0->outp[ABOVE]= q;
               e1->outp[ABOVE]= NULL;
             }
@@ -1390,7 +1395,7 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case IMX:
             if (p && q)
             {
-              add_right(p, ix, iy);
+              add_right(&store, p, ix, iy);
               merge_left(p, q, out_poly);
               e0->outp[ABOVE]= NULL;
               e1->outp[ABOVE]= NULL;
@@ -1399,18 +1404,18 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           case IMM:
             if (p && q)
             {
-              add_right(p, ix, iy);
+              add_right(&store, p, ix, iy);
               merge_left(p, q, out_poly);
-              add_local_min(&out_poly, e0, ix, iy);
+              add_local_min(&store, &out_poly, e0, ix, iy);
               e1->outp[ABOVE]= e0->outp[ABOVE];
             }
             break;
           case EMM:
             if (p && q)
             {
-              add_left(p, ix, iy);
+              add_left(&store, p, ix, iy);
               merge_right(p, q, out_poly);
-              add_local_min(&out_poly, e0, ix, iy);
+              add_local_min(&store, &out_poly, e0, ix, iy);
               e1->outp[ABOVE]= e0->outp[ABOVE];
             }
             break;
@@ -1514,9 +1519,8 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
     result->contour = (gpc_vertex_list*)mem_malloc(result->num_contours * sizeof(gpc_vertex_list));
 
     c= 0;
-    for (poly= out_poly; poly; poly= npoly)
+    for (poly= out_poly; poly; poly= poly->next)
     {
-      npoly= poly->next;
       if (poly->active)
       {
         result->hole[c]= poly->proxy->hole;
@@ -1529,29 +1533,14 @@ void gpc_polygon_clip(gpc_op op, gpc_polygon *subj, gpc_polygon *clip,
           nv= vtx->next;
           result->contour[c].vertex[v].x= vtx->x;
           result->contour[c].vertex[v].y= vtx->y;
-          mem_free(vtx);
           v--;
         }
         c++;
       }
-      mem_free(poly);
-    }
-  }
-  else
-  {
-    for (poly= out_poly; poly; poly= npoly)
-    {
-      npoly= poly->next;
-      mem_free(poly);
     }
   }
 
-  /* Tidy up */
-  reset_it(&it);
-  reset_lmt(&lmt);
-  mem_free(c_heap);
-  mem_free(s_heap);
-  mem_free(sbt);
+  /* Every other node is released with the arena */
 }
 
 }
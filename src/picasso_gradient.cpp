@@ -62,4 +62,10 @@ void gradient_adapter::transform(const trans_affine& mtx)
         m_impl->transform(mtx.impl());
 }
 
+void gradient_adapter::build(void)
+{
+    if (m_impl)
+        m_impl->build();
+}
+
 }
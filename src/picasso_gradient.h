@@ -35,6 +35,9 @@ public:
     void clear_stops(void);
 
     void transform(const trans_affine& mtx);
+
+    // build color table before drawing on different threads.
+    void build(void);
 public:
     abstract_gradient_adapter* impl(void) const { return m_impl; }
 private:
@@ -5,6 +5,7 @@
  */
 
 #include "common.h"
+#include "thread_lock.h"
 #include "device.h"
 
 #include "picasso.h"
@@ -159,7 +160,7 @@ ps_gradient* PICAPI ps_gradient_ref(ps_gradient* g)
         return 0;
     }
 
-    g->refcount++;
+    atomic_increment(&g->refcount);
     global_status = STATUS_SUCCEED;
     return g;
 }
@@ -176,8 +177,7 @@ void PICAPI ps_gradient_unref(ps_gradient* g)
         return;
     }
 
-    g->refcount--;
-    if (g->refcount <= 0) {
+    if (atomic_decrement(&g->refcount) <= 0) {
         (&g->gradient)->picasso::gradient_adapter::~gradient_adapter();
         mem_free(g);
     }
@@ -5,6 +5,7 @@
  */
 
 #include "common.h"
+#include "thread_lock.h"
 #include "device.h"
 
 #include "picasso.h"
@@ -278,7 +279,7 @@ ps_image* PICAPI ps_image_ref(ps_image* img)
         return 0;
     }
 
-    img->refcount++;
+    atomic_increment(&img->refcount);
     global_status = STATUS_SUCCEED;
     return img;
 }
@@ -295,8 +296,7 @@ void PICAPI ps_image_unref(ps_image* img)
         return;
     }
 
-    img->refcount--;
-    if (img->refcount <= 0) {
+    if (atomic_decrement(&img->refcount) <= 0) {
         if (img->flage == buffer_alloc_surface)
             BufferFree(img->buffer.buffer());
         else if (img->flage == buffer_alloc_malloc)
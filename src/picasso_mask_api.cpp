@@ -5,6 +5,7 @@
  */
 
 #include "common.h"
+#include "thread_lock.h"
 #include "device.h"
 
 #include "picasso.h"
@@ -52,7 +53,7 @@ ps_mask* PICAPI ps_mask_ref(ps_mask* mask)
         return 0;
     }
 
-    mask->refcount++;
+    atomic_increment(&mask->refcount);
     global_status = STATUS_SUCCEED;
     return mask;
 }
@@ -69,8 +70,7 @@ void PICAPI ps_mask_unref(ps_mask* mask)
         return;
     }
 
-    mask->refcount--;
-    if (mask->refcount <= 0) {
+    if (atomic_decrement(&mask->refcount) <= 0) {
         (&mask->mask)->picasso::mask_layer::~mask_layer();
         mem_free(mask);
     }
@@ -180,6 +180,11 @@ bool trans_affine::is_identity(void) const
     return m_impl->is_identity();
 }
 
+unsigned int trans_affine::type(void) const
+{
+    return m_impl->type();
+}
+
 scalar trans_affine::determinant(void) const
 {
     return m_impl->determinant();
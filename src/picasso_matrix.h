@@ -49,6 +49,7 @@ public:
     const trans_affine& multiply(const trans_affine& o);
 
     bool is_identity(void) const;
+    unsigned int type(void) const;
     scalar determinant(void) const;
     scalar rotation(void) const;
     void translation(scalar* dx, scalar* dy) const;
@@ -12,6 +12,7 @@
 #include "data_vector.h"
 #include "graphic_base.h"
 #include "graphic_path.h"
+#include "thread_lock.h"
 #include "picasso_matrix.h"
 #include "picasso_mask.h"
 #include "picasso_font.h"
@@ -23,6 +24,73 @@
 
 namespace picasso {
 
+// reference counted state block, copy on write.
+// the counter is atomic, recorded states are copied by many threads.
+template <typename T>
+class cow_data
+{
+    struct block {
+        volatile int refcount;
+        T data;
+    };
+public:
+    cow_data()
+        : m_block(new block)
+    {
+        m_block->refcount = 1;
+    }
+
+    cow_data(const cow_data& o)
+        : m_block(o.m_block)
+    {
+        atomic_increment(&m_block->refcount);
+    }
+
+    cow_data& operator = (const cow_data& o)
+    {
+        if (m_block != o.m_block) {
+            release();
+            m_block = o.m_block;
+            atomic_increment(&m_block->refcount);
+        }
+        return *this;
+    }
+
+    ~cow_data()
+    {
+        release();
+    }
+
+    const T* operator->() const { return &m_block->data; }
+    const T& get(void) const { return m_block->data; }
+
+    // detach from the states shared with before modify.
+    T& write(void)
+    {
+        if (m_block->refcount > 1) {
+            block* b = new block(*m_block);
+            if (b) {
+                release();
+                m_block = b;
+                m_block->refcount = 1;
+            }
+        }
+        return m_block->data;
+    }
+
+    // the block is changed whenever data is modified after shared.
+    bool is_same(const cow_data& o) const { return m_block == o.m_block; }
+
+private:
+    void release(void)
+    {
+        if (atomic_decrement(&m_block->refcount) <= 0)
+            delete m_block;
+    }
+
+    block* m_block;
+};
+
 // pen object
 enum {
     pen_style_solid  = 0,
@@ -358,17 +426,6 @@ struct clip_area {
         return *this;
     }
 
-    bool is_not_same(const clip_area& o)
-    {
-        return (type != o.type) ||
-               (path != o.path) ||
-               (rule != o.rule) ||
-               (rect.x1 != o.rect.x1) ||
-               (rect.y1 != o.rect.y1) ||
-               (rect.x2 != o.rect.x2) ||
-               (rect.y2 != o.rect.y2);
-    }
-
     unsigned int type;
     graphic_path path;    
     filling_rule rule;
@@ -453,10 +510,139 @@ struct context_state {
     rgba font_fcolor;
     comp_op composite;
     trans_affine world_matrix;
-    graphic_pen pen;
-    graphic_brush brush;
-    clip_area clip;
-    shadow_state shadow;
+    cow_data<graphic_pen> pen;
+    cow_data<graphic_brush> brush;
+    cow_data<clip_area> clip;
+    cow_data<shadow_state> shadow;
+};
+
+// saved states storage, memory keeps until context destroy.
+#if ENABLE(LOW_MEMORY)
+#define STATE_CHUNK_SIZE 4
+#else
+#define STATE_CHUNK_SIZE 16
+#endif
+
+class state_stack
+{
+    struct chunk {
+        chunk* prev;
+        unsigned int used;
+    };
+
+    enum {
+        header_size = (sizeof(chunk) + 15) & ~15,
+    };
+public:
+    state_stack()
+        : m_top(0)
+        , m_spare(0)
+    {
+    }
+
+    ~state_stack()
+    {
+        while (m_top) {
+            chunk* p = m_top;
+            m_top = m_top->prev;
+            mem_free(p);
+        }
+
+        if (m_spare)
+            mem_free(m_spare);
+    }
+
+    // return uninitialized storage for a context_state.
+    void* push(void)
+    {
+        if (!m_top || m_top->used == STATE_CHUNK_SIZE) {
+            chunk* c = m_spare;
+            if (c) {
+                m_spare = 0;
+            } else {
+                c = (chunk*)mem_malloc(header_size + sizeof(context_state) * STATE_CHUNK_SIZE);
+                if (!c)
+                    return 0;
+            }
+            c->prev = m_top;
+            c->used = 0;
+            m_top = c;
+        }
+        return slot(m_top, m_top->used++);
+    }
+
+    // release the last storage returned by push, caller destroy the state.
+    void pop(void)
+    {
+        if (!m_top)
+            return;
+
+        if (!--m_top->used) {
+            chunk* c = m_top;
+            m_top = m_top->prev;
+            if (m_spare)
+                mem_free(m_spare);
+            m_spare = c;
+        }
+    }
+
+private:
+    state_stack(const state_stack&);
+    state_stack& operator=(const state_stack&);
+
+    static void* slot(chunk* c, unsigned int i)
+    {
+        return (byte*)c + header_size + sizeof(context_state) * i;
+    }
+
+    chunk* m_top;
+    chunk* m_spare;
+};
+
+// recorded drawing command
+enum {
+    picture_op_stroke = 0,
+    picture_op_fill   = 1,
+    picture_op_paint  = 2,
+    picture_op_clear  = 3,
+    picture_op_glyphs = 4,
+};
+
+// glyph with position of recorded text
+typedef struct _picture_glyph {
+    unsigned int code;
+    scalar x;
+    scalar y;
+} picture_glyph;
+
+struct picture_op {
+    picture_op(int t, const context_state& s)
+        : type(t)
+        , state(s)
+        , glyphs(0)
+        , num_glyphs(0)
+        , text_antialias(True)
+        , text_type(TEXT_TYPE_STROKE)
+    {
+    }
+
+    ~picture_op()
+    {
+        if (glyphs)
+            mem_free(glyphs);
+    }
+
+    int type;
+    context_state state; // clip is in device space of the picture.
+    graphic_path path;
+    picture_glyph* glyphs;
+    unsigned int num_glyphs;
+    trans_affine text_matrix;
+    ps_bool text_antialias;
+    ps_text_type text_type;
+private:
+    picture_op(const picture_op&);
+    picture_op& operator=(const picture_op&);
 };
 
 }
@@ -469,6 +655,7 @@ struct _ps_context {
     int refcount;
     ps_canvas* canvas;
     picasso::context_state* state;
+    picasso::state_stack states;
     ps_bool font_antialias;   
     ps_bool font_kerning;   
     ps_text_type font_render_type;
@@ -477,6 +664,9 @@ struct _ps_context {
     picasso::trans_affine text_matrix;
     picasso::graphic_path path;
     picasso::raster_adapter raster;
+    ps_picture* record;
+    picasso::cow_data<picasso::graphic_pen> text_pen; // states with text colors.
+    picasso::cow_data<picasso::graphic_brush> text_brush;
 };
 
 enum {
@@ -487,6 +677,13 @@ enum {
     buffer_alloc_canvas       = 4,
 };
 
+// damage rectangles of canvas, merged when more than this.
+#if ENABLE(LOW_MEMORY)
+#define MAX_DAMAGE_RECTS 4
+#else
+#define MAX_DAMAGE_RECTS 8
+#endif
+
 struct _ps_canvas {
     int refcount;
     ps_color_format fmt;
@@ -495,6 +692,9 @@ struct _ps_canvas {
     void      *host;
     ps_mask* mask;
     picasso::rendering_buffer buffer;
+    unsigned int num_damage;
+    picasso::rect damage[MAX_DAMAGE_RECTS + 1]; // one more for merging.
+    picasso::thread_lock damage_lock; // sub canvases drawn by other threads add damage too.
 };
 
 struct _ps_image {
@@ -538,6 +738,13 @@ struct _ps_font {
     picasso::font_desc desc;
 };
 
+struct _ps_picture {
+    int refcount;
+    picasso::pod_bvector<picasso::picture_op*> ops;
+    picasso::cow_data<picasso::clip_area> clip; // device clip while recording.
+    picasso::pod_bvector<picasso::picture_glyph> run; // glyphs of text being recorded.
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,16 +16,29 @@
 #include "picasso_painter.h"
 #include "picasso_objects.h"
 #include "picasso_font.h"
+#include "picasso_trace.h"
 
 namespace picasso {
 
+// vertices and device bounds of the drawing for trace
+static inline void trace_raster(trace_scope& trace, raster_adapter& raster, const graphic_path& p)
+{
+    rect r;
+    trace.vertices(p.total_vertices());
+    if (raster.raster_bounds(&r))
+        trace.bounds(r);
+}
+
 painter::painter(pix_fmt fmt)
+    : m_shadow_raster(0)
 {
     m_impl = get_system_device()->create_painter(fmt);
 }
 
 painter::~painter()
 {
+    if (m_shadow_raster)
+        delete m_shadow_raster;
     get_system_device()->destroy_painter(m_impl);
 }
 
@@ -40,18 +53,18 @@ void painter::init_raster_data(context_state* state, unsigned int methods,
     raster.set_raster_method(methods);
 
     if (methods & raster_stroke) {
-        if (state->pen.style == pen_style_dash) 
-            raster.set_stroke_dashes(state->pen.dstart, state->pen.dashes, state->pen.ndashes); //dash line
-
-        raster.set_stroke_attr_val(STA_WIDTH, state->pen.width);
-        raster.set_stroke_attr_val(STA_MITER_LIMIT, state->pen.miter_limit);
-        raster.set_stroke_attr(STA_LINE_CAP, state->pen.cap);
-        raster.set_stroke_attr(STA_LINE_JOIN, state->pen.join);
-        raster.set_stroke_attr(STA_INNER_JOIN, state->pen.inner);
+        if (state->pen->style == pen_style_dash) 
+            raster.set_stroke_dashes(state->pen->dstart, state->pen->dashes, state->pen->ndashes); //dash line
+
+        raster.set_stroke_attr_val(STA_WIDTH, state->pen->width);
+        raster.set_stroke_attr_val(STA_MITER_LIMIT, state->pen->miter_limit);
+        raster.set_stroke_attr(STA_LINE_CAP, state->pen->cap);
+        raster.set_stroke_attr(STA_LINE_JOIN, state->pen->join);
+        raster.set_stroke_attr(STA_INNER_JOIN, state->pen->inner);
     }
 
     if (methods & raster_fill) {
-        raster.set_fill_attr(FIA_FILL_RULE, state->brush.rule);
+        raster.set_fill_attr(FIA_FILL_RULE, state->brush->rule);
     }
 
     raster.set_transform(mtx);
@@ -64,16 +77,16 @@ void painter::init_source_data(context_state* state, unsigned int methods, const
     m_impl->set_composite(state->composite);
 
     if (methods & raster_stroke) {
-        m_impl->set_stroke_color(state->pen.color); //FIXME: need implement stroke pattern and gradient support.
+        m_impl->set_stroke_color(state->pen->color); //FIXME: need implement stroke pattern and gradient support.
     }
 
     if (methods & raster_fill) {
-        switch (state->brush.style) {
+        switch (state->brush->style) {
             case brush_style_canvas:
                 {
                     scalar x1 = 1, y1 = 1, x2 = 0 ,y2 = 0;
                     bounding_rect(const_cast<graphic_path&>(p), 0, &x1, &y1, &x2, &y2);
-                    ps_canvas* canvas = static_cast<ps_canvas*>(state->brush.data);
+                    ps_canvas* canvas = static_cast<ps_canvas*>(state->brush->data);
                     rect_s rect(x1, y1, x2, y2);
                     m_impl->set_fill_canvas(canvas->buffer.impl(), (int)state->filter, rect);
                 }
@@ -82,7 +95,7 @@ void painter::init_source_data(context_state* state, unsigned int methods, const
                 {
                     scalar x1 = 1, y1 = 1, x2 = 0 ,y2 = 0;
                     bounding_rect(const_cast<graphic_path&>(p), 0, &x1, &y1, &x2, &y2);
-                    ps_pattern* pattern = static_cast<ps_pattern*>(state->brush.data);
+                    ps_pattern* pattern = static_cast<ps_pattern*>(state->brush->data);
                     rect_s rect(x1, y1, x2, y2);
                     m_impl->set_fill_pattern(pattern->img->buffer.impl(), (int)state->filter, rect,
                                                 pattern->xtype, pattern->ytype, pattern->matrix.impl());
@@ -92,19 +105,19 @@ void painter::init_source_data(context_state* state, unsigned int methods, const
                 {
                     scalar x1 = 1, y1 = 1, x2 = 0 ,y2 = 0;
                     bounding_rect(const_cast<graphic_path&>(p), 0, &x1, &y1, &x2, &y2);
-                    ps_image* img = static_cast<ps_image*>(state->brush.data);
+                    ps_image* img = static_cast<ps_image*>(state->brush->data);
                     rect_s rect(x1, y1, x2, y2);
                     m_impl->set_fill_image(img->buffer.impl(), (int)state->filter, rect);
                 }
                 break;
             case brush_style_gradient:
                 {
-                    ps_gradient* gradient = static_cast<ps_gradient*>(state->brush.data);
+                    ps_gradient* gradient = static_cast<ps_gradient*>(state->brush->data);
                     m_impl->set_fill_gradient(gradient->gradient.impl());
                 }
                 break;
             case brush_style_solid:
-                m_impl->set_fill_color(state->brush.color); //solid color brush.
+                m_impl->set_fill_color(state->brush->color); //solid color brush.
                 break;
             default:
                 //make compiler happy only.
@@ -115,6 +128,8 @@ void painter::init_source_data(context_state* state, unsigned int methods, const
 
 void painter::render_stroke(context_state* state, raster_adapter& raster, const graphic_path& p)
 {
+    trace_scope trace("stroke");
+
     if (raster.is_empty()) 
         init_raster_data(state, raster_stroke, raster, p, state->world_matrix);
 
@@ -122,10 +137,15 @@ void painter::render_stroke(context_state* state, raster_adapter& raster, const
 
     raster.commit(); //calc raster data.
     m_impl->apply_stroke(raster.impl());
+
+    if (trace.enabled())
+        trace_raster(trace, raster, p);
 }
 
 void painter::render_fill(context_state* state, raster_adapter& raster, const graphic_path& p)
 {
+    trace_scope trace("fill");
+
     if (raster.is_empty()) 
         init_raster_data(state, raster_fill, raster, p, state->world_matrix);
 
@@ -133,10 +153,15 @@ void painter::render_fill(context_state* state, raster_adapter& raster, const gr
 
     raster.commit(); //calc raster data.
     m_impl->apply_fill(raster.impl());
+
+    if (trace.enabled())
+        trace_raster(trace, raster, p);
 }
 
 void painter::render_paint(context_state* state, raster_adapter& raster, const graphic_path& p)
 {
+    trace_scope trace("paint");
+
     if (raster.is_empty()) 
         init_raster_data(state, raster_fill | raster_stroke, raster, p, state->world_matrix);
 
@@ -145,16 +170,22 @@ void painter::render_paint(context_state* state, raster_adapter& raster, const g
     raster.commit(); //calc raster data.
     m_impl->apply_fill(raster.impl());
     m_impl->apply_stroke(raster.impl());
+
+    if (trace.enabled())
+        trace_raster(trace, raster, p);
 }
 
 void painter::render_clear(context_state* state)
 {
-    m_impl->apply_clear(state->brush.color);
+    m_impl->apply_clear(state->brush->color);
 }
 
 void painter::render_blur(context_state* state)
 {
-    m_impl->apply_blur(state->blur);
+    if (state->blur > FLT_TO_SCALAR(0.0f)) {
+        trace_scope trace("blur");
+        m_impl->apply_blur(state->blur);
+    }
 }
 
 void painter::render_gamma(context_state* state, raster_adapter& raster)
@@ -171,22 +202,33 @@ void painter::render_gamma(context_state* state, raster_adapter& raster)
 void painter::render_clip(context_state* state, bool clip)
 {
     if (clip) {
-        if (state->clip.type != clip_none) { // need clip 
+        if (state->clip->type != clip_none) { // need clip 
+            trace_scope trace("clip");
             m_impl->clear_clip(); // clear old clip.
 
-            if (state->clip.type == clip_content) 
-                m_impl->apply_clip_path(state->clip.path, state->clip.rule, state->world_matrix.impl());
-            else if (state->clip.type == clip_device) 
-                m_impl->apply_clip_device(state->clip.rect, 0, 0);
+            if (state->clip->type == clip_content) {
+                m_impl->apply_clip_path(state->clip->path, state->clip->rule, state->world_matrix.impl());
+                trace.vertices(state->clip->path.total_vertices());
+            } else if (state->clip->type == clip_device) {
+                m_impl->apply_clip_device(state->clip->rect, 0, 0);
+                const rect_s& r = state->clip->rect;
+                trace.bounds(rect(iround(r.x1), iround(r.y1), iround(r.x2), iround(r.y2)));
+            }
         }
     } else {
         m_impl->clear_clip();
     }
 }
 
+void painter::render_bounds(const rect& rc)
+{
+    m_impl->apply_bounds(rc);
+}
+
 void painter::render_shadow(context_state* state, const graphic_path& p, bool fill, bool stroke)
 {
-    if (state->shadow.use_shadow) {
+    if (state->shadow->use_shadow) {
+        trace_scope trace("shadow");
 
         unsigned int method = 0;
         if (fill) 
@@ -199,43 +241,65 @@ void painter::render_shadow(context_state* state, const graphic_path& p, bool fi
         bounding_rect(tp, 0, &x1, &y1, &x2, &y2);
 
         //FIXME: it is hard code here right?
-        x1 -= (state->shadow.blur*40+5);
-        y1 -= (state->shadow.blur*40+5);
-        x2 += (state->shadow.blur*40+5);
-        y2 += (state->shadow.blur*40+5);
+        x1 -= (state->shadow->blur*40+5);
+        y1 -= (state->shadow->blur*40+5);
+        x2 += (state->shadow->blur*40+5);
+        y2 += (state->shadow->blur*40+5);
 
         rect_s rect(x1, y1, x2, y2);
 
+        if (trace.enabled()) {
+            trace.vertices(p.total_vertices());
+            trace.bounds(picasso::rect(iround(x1), iround(y1), iround(x2), iround(y2)));
+        }
+
         trans_affine mtx = state->world_matrix;
         mtx.translate(-x1, -y1); // translate to (0,0) of shadow layer.
 
-        if (m_impl->begin_shadow(rect)){ //switch to shadow layer. 
+        if (!m_shadow_raster) // keep the shadow cells between draws.
+            m_shadow_raster = new raster_adapter;
+
+        if (m_shadow_raster && m_impl->begin_shadow(rect)){ //switch to shadow layer. 
 
-            raster_adapter shadow_raster;
+            raster_adapter& shadow_raster = *m_shadow_raster;
 
             init_raster_data(state, method, shadow_raster, p, mtx);
 
             m_impl->set_alpha(state->alpha);
             m_impl->set_composite(state->composite);
 
-            if (state->clip.type != clip_none) { // need clip 
+            if (state->clip->type != clip_none) { // need clip 
                 m_impl->clear_clip(); // clear old clip.
 
-                if (state->clip.type == clip_content) 
-                    m_impl->apply_clip_path(state->clip.path, state->clip.rule, mtx.impl());
-                else if (state->clip.type == clip_device) 
-                    m_impl->apply_clip_device(state->clip.rect, -x1, -y1);
+                if (state->clip->type == clip_content) 
+                    m_impl->apply_clip_path(state->clip->path, state->clip->rule, mtx.impl());
+                else if (state->clip->type == clip_device) 
+                    m_impl->apply_clip_device(state->clip->rect, -x1, -y1);
             }
 
             shadow_raster.commit();
             m_impl->apply_shadow(shadow_raster.impl(), rect, 
-                    state->shadow.color, state->shadow.x_offset, state->shadow.y_offset, state->shadow.blur);
+                    state->shadow->color, state->shadow->x_offset, state->shadow->y_offset, state->shadow->blur);
 
             shadow_raster.reset();
         }
     }
 }
 
+void painter::memory_usage(memory_stats* s)
+{
+    m_impl->memory_usage(s);
+    if (m_shadow_raster)
+        m_shadow_raster->memory_usage(s);
+}
+
+void painter::trim(void)
+{
+    m_impl->trim();
+    if (m_shadow_raster)
+        m_shadow_raster->trim();
+}
+
 void painter::render_mask(const mask_layer& m, bool mask)
 {
     if (mask) {
@@ -251,7 +315,7 @@ void painter::render_copy(rendering_buffer& src, const rect* r, const painter* d
         rect rc(r->x1, r->y1, r->x2, r->y2); 
         dst->m_impl->copy_rect_from(src.impl(), rc, off_x, off_y);
     } else {
-        rect rc(0, 0, src.width(), src.height()); 
+        rect rc(0, 0, src.width() - 1, src.height() - 1); 
         dst->m_impl->copy_rect_from(src.impl(), rc, off_x, off_y);
     }
 }
@@ -279,6 +343,15 @@ void painter::render_glyph(context_state* state, raster_adapter& raster, const f
     }
 }
 
+void painter::render_glyph_mask(context_state* state, const byte* covers, int x, int y, unsigned int w, unsigned int h)
+{
+    m_impl->set_alpha(state->alpha);
+    m_impl->set_composite(state->composite);
+
+    m_impl->set_font_fill_color(state->font_fcolor);
+    m_impl->apply_text_mask(covers, x, y, w, h);
+}
+
 void painter::render_glyphs_raster(context_state* state, raster_adapter& raster, int style)
 {
     if (!raster.is_empty()) {
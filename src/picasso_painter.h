@@ -38,6 +38,7 @@ public:
     void render_blur(context_state* state);
     void render_gamma(context_state* state, raster_adapter& raster);
     void render_clip(context_state* state, bool clip);
+    void render_bounds(const rect& rc);
     void render_shadow(context_state* state, const graphic_path& p, bool fill, bool stroke);
 
     void render_mask(const mask_layer& m, bool mask);
@@ -45,6 +46,10 @@ public:
 
     void render_glyph(context_state* state, raster_adapter& raster, const font_adapter* font, int type);
     void render_glyphs_raster(context_state* state, raster_adapter& raster, int style);
+    void render_glyph_mask(context_state* state, const byte* covers, int x, int y, unsigned int w, unsigned int h);
+
+    void memory_usage(memory_stats* s);
+    void trim(void);
 private:
     void init_raster_data(context_state*, unsigned int, raster_adapter&, const vertex_source&, const trans_affine&);
     void init_source_data(context_state*, unsigned int, const graphic_path&);
@@ -52,6 +57,7 @@ private:
     painter(const painter& o);
     painter& operator=(const painter& o);
     abstract_painter * m_impl;
+    raster_adapter * m_shadow_raster;
 };
 
 }
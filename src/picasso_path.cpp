@@ -40,6 +40,18 @@ void _path_operation(conv_clipper::clip_op op, const graphic_path& a, const grap
     }
 }
 
+void _path_union(vertex_source* const* paths, unsigned int num, graphic_path& r)
+{
+    conv_clipper cliper(paths, num, conv_clipper::clip_engine_sweep);
+    cliper.rewind(0);
+    r.remove_all();
+    scalar x = 0, y = 0;
+    unsigned int cmd = 0;
+    while (!is_stop(cmd = cliper.vertex(&x, &y))) {
+        r.add_vertex(x, y, cmd);
+    }
+}
+
 }
 
 #ifdef __cplusplus
@@ -600,6 +612,45 @@ void PICAPI ps_path_clipping(ps_path* r, ps_path_operation op, const ps_path* a,
     global_status = STATUS_SUCCEED;
 }
 
+void PICAPI ps_path_union_many(ps_path* r, ps_path* const* paths, unsigned int num)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!r || (!paths && num)) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    picasso::pod_vector<picasso::vertex_source*> sources(num);
+    ps_path* last = 0;
+    for (unsigned int i = 0; i < num; i++) {
+        ps_path* p = paths[i];
+        if (p && p->path.total_vertices() && picasso::_is_closed_path(p->path)) { //skip invalid path
+            sources.push_back(&(p->path));
+            last = p;
+        }
+    }
+
+    if (!sources.size()) {
+        r->path.remove_all();
+        global_status = STATUS_SUCCEED;
+        return;
+    }
+
+    if (sources.size() == 1) {
+        r->path = last->path;
+        global_status = STATUS_SUCCEED;
+        return;
+    }
+
+    picasso::_path_union(sources.data(), sources.size(), r->path);
+
+    global_status = STATUS_SUCCEED;
+}
+
 #ifdef __cplusplus
 }
 #endif
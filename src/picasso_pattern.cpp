@@ -5,6 +5,7 @@
  */
 
 #include "common.h"
+#include "thread_lock.h"
 #include "picasso.h"
 #include "picasso_global.h"
 #include "picasso_matrix.h"
@@ -57,7 +58,7 @@ ps_pattern* PICAPI ps_pattern_ref(ps_pattern* pattern)
         return 0;
     }
 
-    pattern->refcount++;
+    atomic_increment(&pattern->refcount);
     global_status = STATUS_SUCCEED;
     return pattern;
 }
@@ -74,8 +75,7 @@ void PICAPI ps_pattern_unref(ps_pattern* pattern)
         return;
     }
 
-    pattern->refcount--;
-    if (pattern->refcount <= 0) {
+    if (atomic_decrement(&pattern->refcount) <= 0) {
         ps_image_unref(pattern->img);
         mem_free(pattern);
     }
@@ -0,0 +1,757 @@
+/* Picasso - a vector graphics library
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+#include "common.h"
+#include "device.h"
+#include "graphic_path.h"
+#include "graphic_helper.h"
+#include "convert.h"
+#include "thread_lock.h"
+#include "render_stats.h"
+
+#include "picasso.h"
+#include "picasso_global.h"
+#include "picasso_objects.h"
+#include "picasso_painter.h"
+#include "picasso_private.h"
+
+namespace picasso {
+
+static inline void _rect_to_path(const rect_s& r, graphic_path& path)
+{
+    path.move_to(r.x1, r.y1);
+    path.line_to(r.x2, r.y1);
+    path.line_to(r.x2, r.y2);
+    path.line_to(r.x1, r.y2);
+    path.end_poly();
+}
+
+// clip of the state in device space, same as painter applied.
+static void _device_clip(const context_state* state, clip_area& dc)
+{
+    dc.path.free_all();
+    dc.type = state->clip->type;
+    dc.rule = state->clip->rule;
+    dc.rect = state->clip->rect;
+    if (dc.type == clip_content) {
+        dc.path = state->clip->path;
+        dc.path.transform_all_paths(state->world_matrix);
+    }
+}
+
+// device clip of picture transformed to target and intersected with clip of target.
+static void _combine_clip(const clip_area& src, const trans_affine& mtx, const clip_area& dst, clip_area& r)
+{
+    r.path.free_all();
+    r.rule = fill_non_zero;
+    r.rect = rect_s(0, 0, 0, 0);
+
+    if (src.type == clip_none) {
+        r.type = dst.type;
+        r.rule = dst.rule;
+        r.rect = dst.rect;
+        r.path = dst.path;
+        return;
+    }
+
+    graphic_path sp;
+    if (src.type == clip_device) {
+        if (!(mtx.type() & ~(matrix_translate | matrix_scale))) {
+            // rectangle is kept without rotation and shear.
+            rect_s sr = src.rect;
+            mtx.transform(&sr.x1, &sr.y1);
+            mtx.transform(&sr.x2, &sr.y2);
+            sr.normalize();
+            if (dst.type == clip_none) {
+                r.type = clip_device;
+                r.rect = sr;
+                return;
+            } else if (dst.type == clip_device) {
+                rect_s dr = dst.rect;
+                if (!sr.clip(dr))
+                    sr = rect_s(0, 0, 0, 0);
+                r.type = clip_device;
+                r.rect = sr;
+                return;
+            }
+        }
+        _rect_to_path(src.rect, sp);
+    } else {
+        sp = src.path;
+        r.rule = src.rule;
+    }
+    sp.transform_all_paths(mtx);
+
+    r.type = clip_content;
+    if (dst.type == clip_none) {
+        r.path = sp;
+    } else {
+        graphic_path dp;
+        if (dst.type == clip_device)
+            _rect_to_path(dst.rect, dp);
+        else
+            dp = dst.path;
+        _path_operation(conv_clipper::clip_intersect, sp, dp, r.path);
+        r.rule = fill_non_zero;
+    }
+}
+
+static picture_op* _copy_op(const picture_op* op, const context_state& state)
+{
+    picture_op* c = new picture_op(op->type, state);
+    if (!c)
+        return 0;
+
+    c->path = op->path;
+    c->text_matrix = op->text_matrix;
+    c->text_antialias = op->text_antialias;
+    c->text_type = op->text_type;
+    if (op->num_glyphs) {
+        c->glyphs = (picture_glyph*)mem_malloc(sizeof(picture_glyph) * op->num_glyphs);
+        if (!c->glyphs) {
+            delete c;
+            return 0;
+        }
+        mem_copy(c->glyphs, op->glyphs, sizeof(picture_glyph) * op->num_glyphs);
+        c->num_glyphs = op->num_glyphs;
+    }
+    return c;
+}
+
+void _record_clip(ps_context* ctx, bool clip)
+{
+    if (clip && ctx->state->clip->type == clip_none)
+        return; // painter keeps the clip.
+
+    // new block of clip, the commands recorded later can be told from before.
+    cow_data<clip_area> dc;
+    if (clip)
+        _device_clip(ctx->state, dc.write());
+    ctx->record->clip = dc;
+}
+
+bool _record_shape(ps_context* ctx, int type, const graphic_path& p)
+{
+    picture_op* op = new picture_op(type, *ctx->state);
+    if (!op)
+        return false;
+
+    op->state.clip = ctx->record->clip;
+    op->path = p;
+    ctx->record->ops.add(op);
+    return true;
+}
+
+void _record_glyph(ps_context* ctx, unsigned int code, scalar x, scalar y)
+{
+    picture_glyph g = {code, x, y};
+    ctx->record->run.add(g);
+}
+
+// commands of picture transformed and clipped into recording picture of context.
+static bool _record_ops(ps_context* ctx, const ps_picture* pic, const trans_affine& mtx)
+{
+    cow_data<clip_area> src_clip;
+    cow_data<clip_area> dev_clip;
+
+    unsigned int num = pic->ops.size();
+    for (unsigned int i = 0; i < num; i++) {
+        const picture_op* op = pic->ops[i];
+
+        if (!src_clip.is_same(op->state.clip)) {
+            src_clip = op->state.clip;
+            cow_data<clip_area> c;
+            _combine_clip(src_clip.get(), mtx, ctx->record->clip.get(), c.write());
+            dev_clip = c;
+        }
+
+        context_state st(op->state);
+        st.world_matrix *= mtx;
+        st.alpha *= ctx->state->alpha;
+        st.clip = dev_clip;
+
+        picture_op* c = _copy_op(op, st);
+        if (!c)
+            return false;
+        ctx->record->ops.add(c);
+    }
+    return true;
+}
+
+// draw commands of picture, ids is the index of commands to draw or null for all.
+// path iterator is not thread safe, shared is set when other threads draw the same picture.
+static void _draw_ops(ps_context* ctx, const ps_picture* pic, const unsigned int* ids, unsigned int num,
+                        const trans_affine& mtx, const clip_area& target, scalar alpha, bool shared)
+{
+    // clip of the commands is combined once for every clip they recorded with.
+    cow_data<clip_area> src_clip;
+    cow_data<clip_area> dev_clip;
+    cow_data<clip_area> user_clip;
+    trans_affine user_mtx;
+    bool clip_changed = true;
+    bool clip_applied = false;
+
+    scalar gamma = ctx->state->gamma;
+    bool antialias = ctx->state->antialias;
+    graphic_path local;
+
+    for (unsigned int i = 0; i < num; i++) {
+        const picture_op* op = pic->ops[ids ? ids[i] : i];
+
+        if (!src_clip.is_same(op->state.clip)) {
+            src_clip = op->state.clip;
+            cow_data<clip_area> c;
+            _combine_clip(src_clip.get(), mtx, target, c.write());
+            dev_clip = c;
+            clip_changed = true;
+        }
+
+        context_state st(op->state);
+        st.world_matrix *= mtx;
+        st.alpha *= alpha;
+
+        if (dev_clip->type == clip_content) {
+            // painter clip path is in user space of state.
+            if (clip_changed || (user_mtx != st.world_matrix)) {
+                trans_affine inv = st.world_matrix;
+                if (inv.determinant() == FLT_TO_SCALAR(0.0f))
+                    continue;
+                inv.invert();
+                cow_data<clip_area> c;
+                c.write() = dev_clip.get();
+                c.write().path.transform_all_paths(inv);
+                user_clip = c;
+                user_mtx = st.world_matrix;
+                clip_changed = true;
+            }
+            st.clip = user_clip;
+        } else {
+            st.clip = dev_clip;
+        }
+
+        if (clip_changed) {
+            if (st.clip->type != clip_none) {
+                ctx->canvas->p->render_clip(&st, true);
+                clip_applied = true;
+            } else if (clip_applied) {
+                ctx->canvas->p->render_clip(&st, false);
+                clip_applied = false;
+            }
+            clip_changed = false;
+        }
+
+        if ((st.gamma != gamma) || (st.antialias != antialias)) {
+            ctx->canvas->p->render_gamma(&st, ctx->raster);
+            gamma = st.gamma;
+            antialias = st.antialias;
+        }
+
+        if (shared && (op->type != picture_op_clear) && (op->type != picture_op_glyphs))
+            local = op->path;
+        const graphic_path& path = shared ? local : op->path;
+
+        switch (op->type) {
+            case picture_op_stroke:
+                ctx->canvas->p->render_shadow(&st, path, false, true);
+                ctx->canvas->p->render_stroke(&st, ctx->raster, path);
+                ctx->canvas->p->render_blur(&st);
+                break;
+            case picture_op_fill:
+                ctx->canvas->p->render_shadow(&st, path, true, false);
+                ctx->canvas->p->render_fill(&st, ctx->raster, path);
+                ctx->canvas->p->render_blur(&st);
+                break;
+            case picture_op_paint:
+                ctx->canvas->p->render_shadow(&st, path, true, true);
+                ctx->canvas->p->render_paint(&st, ctx->raster, path);
+                ctx->canvas->p->render_blur(&st);
+                break;
+            case picture_op_clear:
+                ctx->canvas->p->render_clear(&st);
+                break;
+            case picture_op_glyphs:
+                _draw_picture_glyphs(ctx, &st, op);
+                break;
+        }
+
+        if (op->type == picture_op_clear)
+            _damage_clear(ctx->canvas, &st);
+        else if (op->type != picture_op_glyphs)
+            _damage_raster(ctx->canvas, &st, ctx->raster, true);
+        ctx->raster.reset();
+    }
+
+    // restore clip and gamma of context.
+    if (clip_applied || (ctx->state->clip->type != clip_none)) {
+        ctx->canvas->p->render_clip(ctx->state, false);
+        ctx->canvas->p->render_clip(ctx->state, true);
+    }
+
+    if ((ctx->state->gamma != gamma) || (ctx->state->antialias != antialias))
+        ctx->canvas->p->render_gamma(ctx->state, ctx->raster);
+}
+
+// tiles of parallel drawing.
+#if ENABLE(LOW_MEMORY)
+#define DEFAULT_TILE_SIZE 64
+#else
+#define DEFAULT_TILE_SIZE 256
+#endif
+
+#define MAX_DRAW_THREADS 64
+
+// device bounds of a command, false if it covers the whole canvas.
+static bool _op_bounds(const picture_op* op, const trans_affine& mtx, rect_s& r)
+{
+    if ((op->type == picture_op_clear) || (op->state.blur > FLT_TO_SCALAR(0.0f)))
+        return false;
+
+    trans_affine m = op->state.world_matrix;
+    m *= mtx;
+
+    scalar sx = FLT_TO_SCALAR(1.0f), sy = FLT_TO_SCALAR(1.0f);
+    m.scaling(&sx, &sy);
+    scalar scale = MAX(Fabs(sx), Fabs(sy));
+
+    scalar x1 = 1, y1 = 1, x2 = 0, y2 = 0;
+    scalar margin = FLT_TO_SCALAR(2.0f); // antialias and rounding.
+
+    if (op->type == picture_op_glyphs) {
+        for (unsigned int i = 0; i < op->num_glyphs; i++) {
+            scalar x = op->glyphs[i].x;
+            scalar y = op->glyphs[i].y;
+            m.transform(&x, &y);
+            if (!i) {
+                x1 = x2 = x;
+                y1 = y2 = y;
+            } else {
+                x1 = MIN(x1, x); y1 = MIN(y1, y);
+                x2 = MAX(x2, x); y2 = MAX(y2, y);
+            }
+        }
+        // glyph is in the em box around the origin.
+        scalar tx = FLT_TO_SCALAR(1.0f), ty = FLT_TO_SCALAR(1.0f);
+        op->text_matrix.scaling(&tx, &ty);
+        margin += op->state.font->desc.height() * scale * MAX(Fabs(tx), Fabs(ty)) * 2;
+    } else {
+        conv_transform tp(op->path, m);
+        bounding_rect(tp, 0, &x1, &y1, &x2, &y2);
+        if (op->type != picture_op_fill)
+            margin += op->state.pen->width * scale * MAX(op->state.pen->miter_limit, FLT_TO_SCALAR(1.0f));
+    }
+
+    if (x1 > x2 || y1 > y2) {
+        r = rect_s(1, 1, 0, 0); // nothing drawn.
+        return true;
+    }
+
+    if (op->state.shadow->use_shadow) {
+        // shadow spill, same as shadow layer of painter.
+        margin += op->state.shadow->blur * 40 + 5
+                + Fabs(op->state.shadow->x_offset) + Fabs(op->state.shadow->y_offset);
+    }
+
+    r = rect_s(x1 - margin, y1 - margin, x2 + margin, y2 + margin);
+    return true;
+}
+
+struct tile_task {
+    const ps_picture* pic;
+    ps_canvas* canvas;
+    const trans_affine* mtx;
+    const clip_area* clip;
+    scalar alpha;
+    unsigned int tile_size;
+    unsigned int cols;
+    unsigned int num_tiles;
+    const unsigned int* starts; // commands of tile i are ids[starts[i] .. starts[i+1]).
+    const unsigned int* ids;
+    volatile int next;
+    const render_stats* caller_stats; // counters of calling thread.
+    bool stats; // statistics enabled by calling thread.
+    render_stats worker_stats; // counters of worker threads, added to calling thread after join.
+    thread_lock lock;
+};
+
+static void _draw_tiles(void* data)
+{
+    tile_task* task = static_cast<tile_task*>(data);
+    ps_canvas* canvas = 0;
+    ps_context* ctx = 0;
+
+    // worker threads count the tiles for the calling thread.
+    bool worker = (&global_stats != task->caller_stats);
+    if (worker)
+        global_stats_enabled = task->stats;
+
+    while (true) {
+        // tiles are taken in order by every thread until all done.
+        unsigned int i = (unsigned int)(atomic_increment(&task->next) - 1);
+        if (i >= task->num_tiles)
+            break;
+
+        unsigned int num = task->starts[i + 1] - task->starts[i];
+        if (!num)
+            continue;
+
+        if (!ctx) {
+            // canvas of thread borrows all pixels, target canvas is not referenced across threads.
+            // commands are drawn in the device space of target, bounds of tile keep the pixels of others.
+            canvas = ps_canvas_create_with_data(task->canvas->buffer.buffer(), task->canvas->fmt,
+                        task->canvas->buffer.width(), task->canvas->buffer.height(), task->canvas->buffer.stride());
+            if (!canvas)
+                break;
+
+            ctx = ps_context_create(canvas, 0);
+            if (!ctx) {
+                ps_canvas_unref(canvas);
+                canvas = 0;
+                break;
+            }
+        }
+
+        int x = (i % task->cols) * task->tile_size;
+        int y = (i / task->cols) * task->tile_size;
+        canvas->p->render_bounds(rect(x, y, x + task->tile_size - 1, y + task->tile_size - 1));
+
+        _draw_ops(ctx, task->pic, task->ids + task->starts[i], num, *task->mtx, *task->clip, task->alpha, true);
+    }
+
+    if (ctx)
+        ps_context_unref(ctx);
+    if (canvas)
+        ps_canvas_unref(canvas);
+
+    if (worker && task->stats) {
+        scoped_lock guard(task->lock);
+        stats_add(task->worker_stats, global_stats);
+    }
+}
+
+static bool _draw_ops_parallel(ps_context* ctx, const ps_picture* pic, const trans_affine& mtx,
+                        const clip_area& target, unsigned int tile_size, unsigned int threads)
+{
+    unsigned int num = pic->ops.size();
+    unsigned int width = ctx->canvas->buffer.width();
+    unsigned int height = ctx->canvas->buffer.height();
+    unsigned int cols = (width + tile_size - 1) / tile_size;
+    unsigned int rows = (height + tile_size - 1) / tile_size;
+    unsigned int num_tiles = cols * rows;
+
+    if (!num || (num_tiles < 2) || ctx->canvas->mask)
+        return false;
+
+    rect_s* bounds = (rect_s*)mem_malloc(sizeof(rect_s) * num);
+    unsigned int* starts = (unsigned int*)mem_calloc(num_tiles + 1, sizeof(unsigned int));
+    if (!bounds || !starts) {
+        mem_free(bounds);
+        mem_free(starts);
+        return false;
+    }
+
+    // count commands of every tile.
+    unsigned int total = 0;
+    bool serial = false;
+    for (unsigned int i = 0; i < num; i++) {
+        const picture_op* op = pic->ops[i];
+
+        if (op->state.blur > FLT_TO_SCALAR(0.0f)
+            || ((op->state.brush->style == brush_style_canvas) && (op->state.brush->data == ctx->canvas))) {
+            serial = true; // blur the whole canvas or read from it.
+            break;
+        }
+
+        if (op->state.brush->style == brush_style_gradient)
+            static_cast<ps_gradient*>(op->state.brush->data)->gradient.build();
+
+        if (!_op_bounds(op, mtx, bounds[i]))
+            bounds[i] = rect_s(0, 0, INT_TO_SCALAR(width), INT_TO_SCALAR(height));
+
+        rect_s& r = bounds[i];
+        if (r.x1 > r.x2 || r.x2 < 0 || r.y2 < 0 || r.x1 >= INT_TO_SCALAR(width) || r.y1 >= INT_TO_SCALAR(height)) {
+            r = rect_s(1, 1, 0, 0);
+            continue;
+        }
+
+        // tiles draw on their own canvas, damage of target is the bounds.
+        _canvas_damage(ctx->canvas, rect(SCALAR_TO_INT(Floor(r.x1)), SCALAR_TO_INT(Floor(r.y1)),
+                                         SCALAR_TO_INT(Ceil(r.x2)), SCALAR_TO_INT(Ceil(r.y2))));
+
+        unsigned int tx1 = (unsigned int)SCALAR_TO_INT(MAX(r.x1, FLT_TO_SCALAR(0.0f))) / tile_size;
+        unsigned int ty1 = (unsigned int)SCALAR_TO_INT(MAX(r.y1, FLT_TO_SCALAR(0.0f))) / tile_size;
+        unsigned int tx2 = (unsigned int)SCALAR_TO_INT(MIN(r.x2, INT_TO_SCALAR(width - 1))) / tile_size;
+        unsigned int ty2 = (unsigned int)SCALAR_TO_INT(MIN(r.y2, INT_TO_SCALAR(height - 1))) / tile_size;
+        r = rect_s(INT_TO_SCALAR(tx1), INT_TO_SCALAR(ty1), INT_TO_SCALAR(tx2), INT_TO_SCALAR(ty2));
+
+        for (unsigned int ty = ty1; ty <= ty2; ty++)
+            for (unsigned int tx = tx1; tx <= tx2; tx++)
+                starts[ty * cols + tx + 1]++;
+        total += (tx2 - tx1 + 1) * (ty2 - ty1 + 1);
+    }
+
+    unsigned int* ids = 0;
+    if (!serial && total)
+        ids = (unsigned int*)mem_malloc(sizeof(unsigned int) * total);
+
+    if (!ids) {
+        mem_free(bounds);
+        mem_free(starts);
+        return !serial && !total; // nothing inside canvas.
+    }
+
+    for (unsigned int i = 0; i < num_tiles; i++)
+        starts[i + 1] += starts[i];
+
+    // fill command ids in order, so tiles draw with the order recorded.
+    unsigned int* pos = (unsigned int*)mem_malloc(sizeof(unsigned int) * num_tiles);
+    if (!pos) {
+        mem_free(ids);
+        mem_free(bounds);
+        mem_free(starts);
+        return false;
+    }
+    mem_copy(pos, starts, sizeof(unsigned int) * num_tiles);
+
+    for (unsigned int i = 0; i < num; i++) {
+        const rect_s& r = bounds[i];
+        if (r.x1 > r.x2)
+            continue;
+        for (unsigned int ty = SCALAR_TO_INT(r.y1); ty <= (unsigned int)SCALAR_TO_INT(r.y2); ty++)
+            for (unsigned int tx = SCALAR_TO_INT(r.x1); tx <= (unsigned int)SCALAR_TO_INT(r.x2); tx++)
+                ids[pos[ty * cols + tx]++] = i;
+    }
+    mem_free(pos);
+    mem_free(bounds);
+
+    tile_task task;
+    task.pic = pic;
+    task.canvas = ctx->canvas;
+    task.mtx = &mtx;
+    task.clip = &target;
+    task.alpha = ctx->state->alpha;
+    task.tile_size = tile_size;
+    task.cols = cols;
+    task.num_tiles = num_tiles;
+    task.starts = starts;
+    task.ids = ids;
+    task.next = 0;
+    task.caller_stats = &global_stats;
+    task.stats = global_stats_enabled;
+    memset(&task.worker_stats, 0, sizeof(render_stats));
+
+    threads = MIN(MIN(threads, num_tiles), MAX_DRAW_THREADS);
+    worker_thread* workers = new worker_thread[threads - 1];
+    if (workers) {
+        for (unsigned int i = 0; i < threads - 1; i++)
+            workers[i].start(_draw_tiles, &task);
+    }
+
+    _draw_tiles(&task); // calling thread draws tiles too.
+
+    delete [] workers; // join all.
+
+    if (task.stats)
+        stats_add(global_stats, task.worker_stats);
+    mem_free(ids);
+    mem_free(starts);
+    return true;
+}
+
+bool _record_glyphs(ps_context* ctx)
+{
+    ps_picture* pic = ctx->record;
+    unsigned int num = pic->run.size();
+    if (!num)
+        return true;
+
+    picture_op* op = new picture_op(picture_op_glyphs, *ctx->state);
+    if (!op) {
+        pic->run.remove_all();
+        return false;
+    }
+
+    op->glyphs = (picture_glyph*)mem_malloc(sizeof(picture_glyph) * num);
+    if (!op->glyphs) {
+        delete op;
+        pic->run.remove_all();
+        return false;
+    }
+
+    for (unsigned int i = 0; i < num; i++)
+        op->glyphs[i] = pic->run[i];
+
+    op->num_glyphs = num;
+    op->state.clip = pic->clip;
+    op->text_matrix = ctx->text_matrix;
+    op->text_antialias = ctx->font_antialias;
+    op->text_type = ctx->font_render_type;
+    pic->ops.add(op);
+    pic->run.remove_all();
+    return true;
+}
+
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ps_picture* PICAPI ps_begin_record(ps_context* ctx)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return 0;
+    }
+
+    if (!ctx || ctx->record) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return 0;
+    }
+
+    ps_picture* p = (ps_picture*)mem_malloc(sizeof(ps_picture));
+    if (p) {
+        p->refcount = 2; // one for the context while recording.
+        new ((void*)&(p->ops)) picasso::pod_bvector<picasso::picture_op*>;
+        new ((void*)&(p->clip)) picasso::cow_data<picasso::clip_area>;
+        new ((void*)&(p->run)) picasso::pod_bvector<picasso::picture_glyph>;
+        picasso::_device_clip(ctx->state, p->clip.write());
+        ctx->record = p;
+        global_status = STATUS_SUCCEED;
+        return p;
+    } else {
+        global_status = STATUS_OUT_OF_MEMORY;
+        return 0;
+    }
+}
+
+void PICAPI ps_end_record(ps_context* ctx)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!ctx || !ctx->record) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    ps_picture* p = ctx->record;
+    ctx->record = 0;
+    ps_picture_unref(p);
+    global_status = STATUS_SUCCEED;
+}
+
+ps_picture* PICAPI ps_picture_ref(ps_picture* picture)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return 0;
+    }
+
+    if (!picture) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return 0;
+    }
+
+    atomic_increment(&picture->refcount);
+    global_status = STATUS_SUCCEED;
+    return picture;
+}
+
+void PICAPI ps_picture_unref(ps_picture* picture)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!picture) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    if (atomic_decrement(&picture->refcount) <= 0) {
+        for (unsigned int i = 0; i < picture->ops.size(); i++)
+            delete picture->ops[i];
+        (&picture->ops)->picasso::pod_bvector<picasso::picture_op*>::~pod_bvector();
+        (&picture->clip)->picasso::cow_data<picasso::clip_area>::~cow_data();
+        (&picture->run)->picasso::pod_bvector<picasso::picture_glyph>::~pod_bvector();
+        mem_free(picture);
+    }
+    global_status = STATUS_SUCCEED;
+}
+
+void PICAPI ps_draw_picture(ps_context* ctx, const ps_picture* picture, const ps_matrix* matrix)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!ctx || !picture || (picture == ctx->record)) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    picasso::trans_affine mtx;
+    if (matrix)
+        mtx = matrix->matrix;
+    mtx *= ctx->state->world_matrix;
+
+    if (ctx->record) {
+        if (!picasso::_record_ops(ctx, picture, mtx)) {
+            global_status = STATUS_OUT_OF_MEMORY;
+            return;
+        }
+    } else {
+        picasso::clip_area target;
+        picasso::_device_clip(ctx->state, target);
+        picasso::_draw_ops(ctx, picture, 0, picture->ops.size(), mtx, target, ctx->state->alpha, false);
+    }
+    global_status = STATUS_SUCCEED;
+}
+
+void PICAPI ps_draw_picture_parallel(ps_context* ctx, const ps_picture* picture, const ps_matrix* matrix,
+                                                        unsigned int tile_size, unsigned int threads)
+{
+    if (!picasso::is_valid_system_device()) {
+        global_status = STATUS_DEVICE_ERROR;
+        return;
+    }
+
+    if (!ctx || !picture || (picture == ctx->record)) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return;
+    }
+
+    if (!tile_size)
+        tile_size = DEFAULT_TILE_SIZE;
+
+    if (!threads)
+        threads = picasso::cpu_count();
+
+    if (ctx->record || (threads < 2)) {
+        ps_draw_picture(ctx, picture, matrix);
+        return;
+    }
+
+    picasso::trans_affine mtx;
+    if (matrix)
+        mtx = matrix->matrix;
+    mtx *= ctx->state->world_matrix;
+
+    picasso::clip_area target;
+    picasso::_device_clip(ctx->state, target);
+    if (!picasso::_draw_ops_parallel(ctx, picture, mtx, target, tile_size, threads))
+        picasso::_draw_ops(ctx, picture, 0, picture->ops.size(), mtx, target, ctx->state->alpha, false);
+
+    global_status = STATUS_SUCCEED;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,6 +13,9 @@
 namespace picasso {
 
 class graphic_path;
+class raster_adapter;
+struct context_state;
+struct picture_op;
 
 // Font
 bool _init_default_font(void);
@@ -21,9 +24,22 @@ ps_font* _default_font(void);
 
 // Path
 void _path_operation(conv_clipper::clip_op op, const graphic_path& a, const graphic_path& b, graphic_path& r);
+void _path_union(vertex_source* const* paths, unsigned int num, graphic_path& r);
+
+// Picture
+void _record_clip(ps_context* ctx, bool clip);
+bool _record_shape(ps_context* ctx, int type, const graphic_path& p);
+void _record_glyph(ps_context* ctx, unsigned int code, scalar x, scalar y);
+bool _record_glyphs(ps_context* ctx);
+void _draw_picture_glyphs(ps_context* ctx, context_state* state, const picture_op* op);
 
 // Format
 int _byte_pre_color(ps_color_format fmt);
+
+// Damage
+void _canvas_damage(ps_canvas* canvas, const rect& r);
+void _damage_raster(ps_canvas* canvas, const context_state* state, raster_adapter& raster, bool effects);
+void _damage_clear(ps_canvas* canvas, const context_state* state);
 }
 
 // Font Load
@@ -31,4 +47,7 @@ bool platform_font_init(void);
 
 void platform_font_shutdown(void);
 
+// bytes of loaded font files
+unsigned int platform_font_bytes(void);
+
 #endif/*_PICASSO_PRIVATE_H_*/
@@ -86,6 +86,26 @@ void raster_adapter::commit(void)
     m_impl->commit();
 }
 
+bool raster_adapter::raster_bounds(rect* r)
+{
+    return m_impl->raster_bounds(r);
+}
+
+void raster_adapter::raster_coverage(byte* covers, const rect& r)
+{
+    m_impl->raster_coverage(covers, r);
+}
+
+void raster_adapter::memory_usage(memory_stats* s)
+{
+    m_impl->memory_usage(s);
+}
+
+void raster_adapter::trim(void)
+{
+    m_impl->trim();
+}
+
 //static methods
 bool raster_adapter::fill_contents_point(const vertex_source& vs, scalar x, scalar y, filling_rule rule)
 {
@@ -46,6 +46,12 @@ public:
     void commit(void);
 
     bool is_empty(void);
+
+    bool raster_bounds(rect* r);
+    void raster_coverage(byte* covers, const rect& r);
+
+    void memory_usage(memory_stats* s);
+    void trim(void);
 public:
     static bool fill_contents_point(const vertex_source& vs, scalar x, scalar y, filling_rule rule);
 public:
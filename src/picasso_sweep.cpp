@@ -0,0 +1,1026 @@
+/* Picasso - a vector graphics library
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+#include "common.h"
+#include "math_type.h"
+#include "data_vector.h"
+#include "memory_arena.h"
+
+#include "picasso_sweep.h"
+
+namespace picasso {
+
+// grid steps over the bounding box, cross products of two differences fit in 62 bits.
+#define SWEEP_GRID_BITS 30
+// passes over a rounded arrangement before it is taken as it is.
+#define SWEEP_MAX_PASSES 8
+
+typedef struct {
+    int64_t x;
+    int64_t y;
+} sweep_point;
+
+// a directed edge of the result, the inside is on its left.
+typedef struct {
+    sweep_point p;
+    sweep_point q;
+} sweep_segment;
+
+// a divided segment kept for the next pass, from left to right.
+typedef struct {
+    sweep_point p;
+    sweep_point q;
+    int delta[2];
+} sweep_piece;
+
+static inline bool _point_equal(const sweep_point& a, const sweep_point& b)
+{
+    return (a.x == b.x) && (a.y == b.y);
+}
+
+// sweep order, by x then by y. vertical edges need no special case.
+static inline bool _point_less(const sweep_point& a, const sweep_point& b)
+{
+    return (a.x < b.x) || ((a.x == b.x) && (a.y < b.y));
+}
+
+// > 0 if c is on the left of a -> b, < 0 if on the right, 0 if collinear. exact on the grid.
+static inline int64_t _orient(const sweep_point& a, const sweep_point& b, const sweep_point& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// maps the operands to the integer grid and back.
+class sweep_grid
+{
+public:
+    sweep_grid()
+        : m_empty(true), m_valid(true)
+        , m_x1(0), m_y1(0), m_x2(0), m_y2(0), m_scale(1)
+    {
+    }
+
+    void add(const gpc_polygon* p)
+    {
+        for (int i = 0; i < p->num_contours; i++) {
+            const gpc_vertex_list& vlist = p->contour[i];
+            for (int j = 0; j < vlist.num_vertices; j++) {
+                double x = vlist.vertex[j].x;
+                double y = vlist.vertex[j].y;
+                if (!(fabs(x) < 1e300) || !(fabs(y) < 1e300)) { // nan or inf
+                    m_valid = false;
+                    continue;
+                }
+                if (m_empty) {
+                    m_x1 = m_x2 = x;
+                    m_y1 = m_y2 = y;
+                    m_empty = false;
+                } else {
+                    if (x < m_x1) m_x1 = x;
+                    if (y < m_y1) m_y1 = y;
+                    if (x > m_x2) m_x2 = x;
+                    if (y > m_y2) m_y2 = y;
+                }
+            }
+        }
+    }
+
+    // choose a power of two scale, so the snapping and the way back are exact.
+    bool init(void)
+    {
+        if (m_empty || !m_valid)
+            return false;
+
+        double extent = Max(m_x2 - m_x1, m_y2 - m_y1);
+        if (extent <= 0.0)
+            return false;
+
+        const double range = (double)(1 << SWEEP_GRID_BITS);
+        m_scale = 1.0;
+        while (extent * m_scale > range)
+            m_scale *= 0.5;
+        while (extent * m_scale * 2.0 <= range)
+            m_scale *= 2.0;
+        return true;
+    }
+
+    sweep_point snap(const vertex_s& v) const
+    {
+        sweep_point p;
+        p.x = (int64_t)floor((v.x - m_x1) * m_scale + 0.5);
+        p.y = (int64_t)floor((v.y - m_y1) * m_scale + 0.5);
+        return p;
+    }
+
+    vertex_s unsnap(const sweep_point& p) const
+    {
+        vertex_s v;
+        v.x = FLT_TO_SCALAR(m_x1 + (double)p.x / m_scale);
+        v.y = FLT_TO_SCALAR(m_y1 + (double)p.y / m_scale);
+        return v;
+    }
+
+private:
+    bool m_empty;
+    bool m_valid;
+    double m_x1;
+    double m_y1;
+    double m_x2;
+    double m_y2;
+    double m_scale;
+};
+
+typedef enum {
+    sweep_union,
+    sweep_intersect,
+    sweep_xor,
+    sweep_diff,
+    sweep_nonzero, // operand 0 only, oriented edges of resolved polygons.
+} sweep_rule;
+
+struct sweep_node;
+
+// an endpoint of a segment, the left one keeps the segment data.
+struct sweep_event {
+    sweep_point pt;
+    sweep_event* other; // the other endpoint
+    sweep_node* node;   // place in the sweep line, left events only
+    int delta[2];       // winding change of each operand crossing upward
+    int wind[2];        // winding numbers above the segment
+    unsigned int id;    // creation order, breaks the ties
+    bool left;
+};
+
+// the sweep line is a treap of the segments crossing it, from bottom to top.
+struct sweep_node {
+    sweep_event* event;
+    sweep_node* parent;
+    sweep_node* child[2];
+    unsigned int priority;
+};
+
+class sweep_line
+{
+public:
+    sweep_line(sweep_rule rule)
+        : m_rule(rule)
+        , m_next(0)
+        , m_root(0)
+        , m_free(0)
+        , m_seed(2463534242u)
+        , m_ids(0)
+        , m_rounded(false)
+        , m_error(false)
+    {
+        m_point.x = m_point.y = 0;
+        m_max[0] = m_max[1] = -1;
+    }
+
+    void reset(void)
+    {
+        clear();
+        m_error = false;
+        m_max[0] = m_max[1] = -1;
+    }
+
+    bool add_edge(const sweep_point& p, const sweep_point& q, int operand)
+    {
+        if (_point_equal(p, q))
+            return true;
+
+        bool forward = _point_less(p, q);
+        int delta[2] = { 0, 0 };
+        delta[operand] = forward ? 1 : -1;
+        if (!add_segment(forward ? p : q, forward ? q : p, delta))
+            return false;
+
+        if (Max(p.x, q.x) > m_max[operand])
+            m_max[operand] = Max(p.x, q.x);
+        return true;
+    }
+
+    // sweep all events, append the boundary of the result to edges.
+    bool run(pod_bvector<sweep_segment>& edges)
+    {
+        // a crossing rounded to the grid may bend a segment over a vertex close
+        // to it, then the order of the sweep line is not exact. the divided
+        // segments are swept again until no crossing needs rounding, which is
+        // mostly the second pass. a pass without rounding is exact.
+        int pass = 0;
+        while (true) {
+            sweep();
+            if (m_error)
+                return false;
+            if (!m_rounded || (++pass == SWEEP_MAX_PASSES))
+                break;
+            if (!renode())
+                return false;
+        }
+
+        for (unsigned int i = 0; i < m_lefts.size(); i++) {
+            const sweep_event* e = m_lefts[i];
+            int below[2] = { e->wind[0] - e->delta[0], e->wind[1] - e->delta[1] };
+            bool in_below = filled(below);
+            bool in_above = filled(e->wind);
+            if (in_below != in_above) {
+                sweep_segment s;
+                if (in_above) {
+                    s.p = e->pt;
+                    s.q = e->other->pt;
+                } else {
+                    s.p = e->other->pt;
+                    s.q = e->pt;
+                }
+                edges.add(s);
+            }
+        }
+        return true;
+    }
+
+private:
+    void clear(void)
+    {
+        m_events.clear();
+        m_next = 0;
+        m_queue.clear();
+        m_lefts.clear();
+        m_arena.reset();
+        m_root = 0;
+        m_free = 0;
+        m_ids = 0;
+        m_rounded = false;
+    }
+
+    bool add_segment(const sweep_point& left, const sweep_point& right, const int* delta)
+    {
+        sweep_event* l = new_event(left, true);
+        sweep_event* r = new_event(right, false);
+        if (!l || !r)
+            return false;
+
+        l->other = r;
+        r->other = l;
+        l->delta[0] = delta[0];
+        l->delta[1] = delta[1];
+
+        m_events.add(l);
+        m_events.add(r);
+        return true;
+    }
+
+    // start again from the pieces of the last pass, merged ones are dropped.
+    bool renode(void)
+    {
+        pod_bvector<sweep_piece> pieces;
+        for (unsigned int i = 0; i < m_lefts.size(); i++) {
+            const sweep_event* e = m_lefts[i];
+            if (e->delta[0] || e->delta[1]) {
+                sweep_piece s;
+                s.p = e->pt;
+                s.q = e->other->pt;
+                s.delta[0] = e->delta[0];
+                s.delta[1] = e->delta[1];
+                pieces.add(s);
+            }
+        }
+
+        clear();
+        for (unsigned int i = 0; i < pieces.size(); i++) {
+            if (!add_segment(pieces[i].p, pieces[i].q, pieces[i].delta))
+                return false;
+        }
+        return true;
+    }
+
+    void sweep(void)
+    {
+        // nothing can be inside the result beyond the end of these operands.
+        int64_t limit = Max(m_max[0], m_max[1]);
+        if (m_rule == sweep_intersect)
+            limit = Min(m_max[0], m_max[1]);
+        else if (m_rule == sweep_diff)
+            limit = m_max[0];
+
+        quick_sort(m_events, event_less);
+        m_next = 0;
+
+        while (((m_next < m_events.size()) || m_queue.size()) && !m_error) {
+            sweep_event* e = next_event();
+            if (e->pt.x > limit)
+                break;
+
+            m_point = e->pt;
+            if (e->left) {
+                m_lefts.add(e);
+                sweep_node* n = insert(e);
+                if (!n)
+                    break;
+
+                sweep_event* prev = neighbor(n, 0);
+                sweep_event* next = neighbor(n, 1);
+                if (next)
+                    intersect(e, next);
+                if (prev && (intersect(prev, e) == 2))
+                    update_fields(prev);
+                else
+                    update_fields(e);
+            } else {
+                sweep_node* n = e->other->node;
+                if (!n)
+                    continue;
+
+                sweep_event* prev = neighbor(n, 0);
+                sweep_event* next = neighbor(n, 1);
+                remove(n);
+                e->other->node = 0;
+                if (prev && next && (intersect(prev, next) == 2))
+                    update_fields(prev);
+                else if (next && _point_equal(next->pt, m_point))
+                    update_fields(next);
+            }
+        }
+    }
+    bool filled(const int* w) const
+    {
+        bool a = (w[0] & 1) != 0;
+        bool b = (w[1] & 1) != 0;
+        switch (m_rule) {
+            case sweep_union:
+                return a || b;
+            case sweep_intersect:
+                return a && b;
+            case sweep_xor:
+                return a != b;
+            case sweep_diff:
+                return a && !b;
+            default:
+                return w[0] != 0;
+        }
+    }
+
+    sweep_event* new_event(const sweep_point& pt, bool left)
+    {
+        sweep_event* e = (sweep_event*)m_arena.alloc(sizeof(sweep_event));
+        if (!e) {
+            m_error = true;
+            return 0;
+        }
+        memset(e, 0, sizeof(sweep_event));
+        e->pt = pt;
+        e->id = m_ids++;
+        e->left = left;
+        return e;
+    }
+
+    // the segment of e is below the point p.
+    static bool is_below(const sweep_event* e, const sweep_point& p)
+    {
+        return e->left ? (_orient(e->pt, e->other->pt, p) > 0)
+                       : (_orient(e->other->pt, e->pt, p) > 0);
+    }
+
+    // > 0 if a is processed after b.
+    static int compare_events(const sweep_event* a, const sweep_event* b)
+    {
+        if (a == b)
+            return 0;
+        if (a->pt.x != b->pt.x)
+            return (a->pt.x > b->pt.x) ? 1 : -1;
+        if (a->pt.y != b->pt.y)
+            return (a->pt.y > b->pt.y) ? 1 : -1;
+        // segments ending at the point leave before others start at it.
+        if (a->left != b->left)
+            return a->left ? 1 : -1;
+        // the lower segment first.
+        if (_orient(a->pt, a->other->pt, b->other->pt))
+            return is_below(a, b->other->pt) ? -1 : 1;
+        return (a->id > b->id) ? 1 : -1;
+    }
+
+    // < 0 if the segment of a is below the segment of b on the sweep line.
+    static int compare_segments(const sweep_event* a, const sweep_event* b)
+    {
+        if (a == b)
+            return 0;
+
+        if (_orient(a->pt, a->other->pt, b->pt) || _orient(a->pt, a->other->pt, b->other->pt)) {
+            // the later one starts above or below the other, or on it and
+            // then its right point decides. vertical segments are no exception.
+            if (compare_events(a, b) > 0) {
+                int64_t o = _orient(b->pt, b->other->pt, a->pt);
+                if (!o)
+                    o = _orient(b->pt, b->other->pt, a->other->pt);
+                return (o > 0) ? 1 : -1;
+            } else {
+                int64_t o = _orient(a->pt, a->other->pt, b->pt);
+                if (!o)
+                    o = _orient(a->pt, a->other->pt, b->other->pt);
+                return (o > 0) ? -1 : 1;
+            }
+        }
+
+        // collinear
+        if (_point_equal(a->pt, b->pt) && _point_equal(a->other->pt, b->other->pt))
+            return (a->id < b->id) ? -1 : 1;
+        return (compare_events(a, b) > 0) ? 1 : -1;
+    }
+
+    static bool event_less(sweep_event* const& a, sweep_event* const& b)
+    {
+        return compare_events(a, b) < 0;
+    }
+
+    // the events of the input are sorted once, only the events of the
+    // divided segments go through the heap.
+    sweep_event* next_event(void)
+    {
+        if (!m_queue.size() || ((m_next < m_events.size())
+                && (compare_events(m_events[m_next], m_queue[0]) < 0)))
+            return m_events[m_next++];
+        return pop();
+    }
+
+    // event queue, a binary heap.
+    void push(sweep_event* e)
+    {
+        m_queue.add(e);
+        unsigned int i = m_queue.size() - 1;
+        while (i) {
+            unsigned int p = (i - 1) >> 1;
+            if (compare_events(m_queue[p], e) <= 0)
+                break;
+            m_queue[i] = m_queue[p];
+            i = p;
+        }
+        m_queue[i] = e;
+    }
+
+    sweep_event* pop(void)
+    {
+        sweep_event* top = m_queue[0];
+        sweep_event* e = m_queue.last();
+        m_queue.remove_last();
+
+        unsigned int n = m_queue.size();
+        if (n) {
+            unsigned int i = 0;
+            while (true) {
+                unsigned int c = i * 2 + 1;
+                if (c >= n)
+                    break;
+                if ((c + 1 < n) && (compare_events(m_queue[c + 1], m_queue[c]) < 0))
+                    c++;
+                if (compare_events(e, m_queue[c]) <= 0)
+                    break;
+                m_queue[i] = m_queue[c];
+                i = c;
+            }
+            m_queue[i] = e;
+        }
+        return top;
+    }
+
+    unsigned int random(void)
+    {
+        m_seed ^= m_seed << 13;
+        m_seed ^= m_seed >> 17;
+        m_seed ^= m_seed << 5;
+        return m_seed;
+    }
+
+    sweep_node* insert(sweep_event* e)
+    {
+        sweep_node* n = m_free;
+        if (n)
+            m_free = n->parent;
+        else
+            n = (sweep_node*)m_arena.alloc(sizeof(sweep_node));
+
+        if (!n) {
+            m_error = true;
+            return 0;
+        }
+
+        n->event = e;
+        n->parent = 0;
+        n->child[0] = n->child[1] = 0;
+        n->priority = random();
+        e->node = n;
+
+        if (!m_root) {
+            m_root = n;
+            return n;
+        }
+
+        sweep_node* p = m_root;
+        while (true) {
+            int side = (compare_segments(e, p->event) < 0) ? 0 : 1;
+            if (!p->child[side]) {
+                p->child[side] = n;
+                n->parent = p;
+                break;
+            }
+            p = p->child[side];
+        }
+
+        while (n->parent && (n->parent->priority < n->priority))
+            rotate(n);
+        return n;
+    }
+
+    // lift n above its parent.
+    void rotate(sweep_node* n)
+    {
+        sweep_node* p = n->parent;
+        sweep_node* g = p->parent;
+        int side = (p->child[1] == n) ? 1 : 0;
+
+        p->child[side] = n->child[!side];
+        if (p->child[side])
+            p->child[side]->parent = p;
+
+        n->child[!side] = p;
+        p->parent = n;
+        n->parent = g;
+
+        if (!g)
+            m_root = n;
+        else
+            g->child[(g->child[1] == p) ? 1 : 0] = n;
+    }
+
+    // removed by the node, a rounded crossing can never lose a segment.
+    void remove(sweep_node* n)
+    {
+        while (n->child[0] || n->child[1]) {
+            sweep_node* c = 0;
+            if (!n->child[0])
+                c = n->child[1];
+            else if (!n->child[1])
+                c = n->child[0];
+            else
+                c = (n->child[0]->priority > n->child[1]->priority) ? n->child[0] : n->child[1];
+            rotate(c);
+        }
+
+        if (!n->parent)
+            m_root = 0;
+        else
+            n->parent->child[(n->parent->child[1] == n) ? 1 : 0] = 0;
+
+        n->parent = m_free;
+        m_free = n;
+    }
+
+    // the segment below (dir 0) or above (dir 1) the node.
+    static sweep_event* neighbor(sweep_node* n, int dir)
+    {
+        if (n->child[dir]) {
+            n = n->child[dir];
+            while (n->child[!dir])
+                n = n->child[!dir];
+            return n->event;
+        }
+
+        while (n->parent && (n->parent->child[dir] == n))
+            n = n->parent;
+        return n->parent ? n->parent->event : 0;
+    }
+
+    static void compute_fields(sweep_event* e, const sweep_event* prev)
+    {
+        e->wind[0] = (prev ? prev->wind[0] : 0) + e->delta[0];
+        e->wind[1] = (prev ? prev->wind[1] : 0) + e->delta[1];
+    }
+
+    // windings of e, and of the segments above it starting at the current point.
+    // a segment divided at the point leaves the sweep line after some of them
+    // are inserted, and pieces starting at the point may come below them.
+    void update_fields(sweep_event* e)
+    {
+        do {
+            compute_fields(e, neighbor(e->node, 0));
+            e = neighbor(e->node, 1);
+        } while (e && _point_equal(e->pt, m_point));
+    }
+
+    // p is strictly inside the segment of the left event e.
+    static bool is_inside(const sweep_event* e, const sweep_point& p)
+    {
+        return _point_less(e->pt, p) && _point_less(p, e->other->pt);
+    }
+
+    // split the segment of the left event le at p, which is strictly inside it.
+    void divide(sweep_event* le, const sweep_point& p)
+    {
+        sweep_event* r = new_event(p, false);
+        sweep_event* l = new_event(p, true);
+        if (!r || !l)
+            return;
+
+        r->other = le;
+        l->other = le->other;
+        l->delta[0] = le->delta[0];
+        l->delta[1] = le->delta[1];
+        le->other->other = l;
+        le->other = r;
+
+        push(l);
+        push(r);
+    }
+
+    // 0 if the segments do not meet, 1 if divided at a crossing,
+    // 2 if e2 is merged into e1, 3 if the overlap is divided for later.
+    // e1 is below e2 on the sweep line.
+    int intersect(sweep_event* e1, sweep_event* e2)
+    {
+        // a segment ending at the current point meets nothing further.
+        if (_point_equal(e1->other->pt, m_point) || _point_equal(e2->other->pt, m_point))
+            return 0;
+
+        const sweep_point& a0 = e1->pt;
+        const sweep_point& a1 = e1->other->pt;
+        const sweep_point& b0 = e2->pt;
+        const sweep_point& b1 = e2->other->pt;
+
+        int64_t o1 = _orient(a0, a1, b0);
+        int64_t o2 = _orient(a0, a1, b1);
+        if (!o1 && !o2)
+            return overlap(e1, e2);
+
+        int64_t o3 = _orient(b0, b1, a0);
+        int64_t o4 = _orient(b0, b1, a1);
+        if (((o1 > 0) && (o2 > 0)) || ((o1 < 0) && (o2 < 0))
+            || ((o3 > 0) && (o4 > 0)) || ((o3 < 0) && (o4 < 0)))
+            return 0;
+
+        sweep_point p;
+        bool exact = true;
+        if (!o1) {
+            p = b0;
+        } else if (!o2) {
+            p = b1;
+        } else if (!o3) {
+            p = a0;
+        } else if (!o4) {
+            p = a1;
+        } else {
+            // the only rounding, the crossing snaps to the nearest grid point.
+            double t = (double)o3 / ((double)o3 - (double)o4);
+            p.x = a0.x + (int64_t)floor((double)(a1.x - a0.x) * t + 0.5);
+            p.y = a0.y + (int64_t)floor((double)(a1.y - a0.y) * t + 0.5);
+            exact = false;
+        }
+
+        // keep the point within both segments.
+        clamp(e1, p);
+        clamp(e2, p);
+        if (_point_less(p, e1->pt) || _point_less(e1->other->pt, p))
+            return 0;
+
+        // a crossing rounded behind the sweep line is left to the next pass.
+        if (_point_less(p, m_point)) {
+            m_rounded = true;
+            return 0;
+        }
+
+        int ret = 0;
+        if (is_inside(e1, p)) {
+            divide(e1, p);
+            ret = 1;
+        }
+        if (is_inside(e2, p)) {
+            divide(e2, p);
+            ret = 1;
+        }
+        if (ret && !exact)
+            m_rounded = true;
+        return ret;
+    }
+
+    static void clamp(const sweep_event* e, sweep_point& p)
+    {
+        if (_point_less(p, e->pt))
+            p = e->pt;
+        else if (_point_less(e->other->pt, p))
+            p = e->other->pt;
+    }
+
+    int overlap(sweep_event* e1, sweep_event* e2)
+    {
+        sweep_event* first = _point_less(e2->pt, e1->pt) ? e2 : e1;
+        sweep_event* second = (first == e1) ? e2 : e1;
+        if (!_point_less(second->pt, first->other->pt))
+            return 0; // touch at a point only
+
+        if (_point_equal(e1->pt, e2->pt)) {
+            if (!_point_equal(e1->other->pt, e2->other->pt)) {
+                bool e1_longer = _point_less(e2->other->pt, e1->other->pt);
+                sweep_event* longer = e1_longer ? e1 : e2;
+                sweep_event* shorter = e1_longer ? e2 : e1;
+                divide(longer, shorter->other->pt);
+            }
+            // the same segment now, e1 carries both and e2 leaves the sweep line,
+            // so a later crossing can not divide one of them only.
+            e1->delta[0] += e2->delta[0];
+            e1->delta[1] += e2->delta[1];
+            e2->delta[0] = e2->delta[1] = 0;
+            remove(e2->node);
+            e2->node = 0;
+            return 2;
+        }
+
+        if (_point_less(second->pt, m_point)) {
+            m_rounded = true;
+            return 0;
+        }
+
+        sweep_point fr = first->other->pt;
+        sweep_point sr = second->other->pt;
+        if (_point_equal(fr, sr)) {
+            divide(first, second->pt);
+        } else if (_point_less(fr, sr)) {
+            divide(first, second->pt);
+            divide(second, fr);
+        } else { // first contains second
+            sweep_event* rest = first->other;
+            divide(first, second->pt);
+            divide(rest->other, sr);
+        }
+        return 3;
+    }
+
+private:
+    sweep_rule m_rule;
+    pod_bvector<sweep_event*> m_events;
+    unsigned int m_next;
+    pod_bvector<sweep_event*> m_queue;
+    pod_bvector<sweep_event*> m_lefts;
+    mem_arena m_arena;
+    sweep_node* m_root;
+    sweep_node* m_free;
+    sweep_point m_point;
+    int64_t m_max[2];
+    unsigned int m_seed;
+    unsigned int m_ids;
+    bool m_rounded;
+    bool m_error;
+};
+
+static bool _add_polygon(sweep_line& sweep, const sweep_grid& grid, const gpc_polygon* p, int operand)
+{
+    for (int i = 0; i < p->num_contours; i++) {
+        const gpc_vertex_list& vlist = p->contour[i];
+        if (vlist.num_vertices < 2)
+            continue;
+
+        sweep_point first = grid.snap(vlist.vertex[0]);
+        sweep_point last = first;
+        for (int j = 1; j < vlist.num_vertices; j++) {
+            sweep_point pt = grid.snap(vlist.vertex[j]);
+            if (!sweep.add_edge(last, pt, operand))
+                return false;
+            last = pt;
+        }
+        if (!sweep.add_edge(last, first, operand))
+            return false;
+    }
+    return true;
+}
+
+static bool _segment_less(const sweep_segment& a, const sweep_segment& b)
+{
+    return _point_less(a.p, b.p);
+}
+
+// 0 if u turns left from d (or back), 1 if right (or straight).
+static inline int _turn_side(const sweep_point& d, const sweep_point& u)
+{
+    int64_t c = d.x * u.y - d.y * u.x;
+    if (c)
+        return (c > 0) ? 0 : 1;
+    return (d.x * u.x + d.y * u.y < 0) ? 0 : 1;
+}
+
+// u turns more to the left than w, coming in by d.
+static bool _more_left(const sweep_point& d, const sweep_point& u, const sweep_point& w)
+{
+    int su = _turn_side(d, u);
+    int sw = _turn_side(d, w);
+    if (su != sw)
+        return su < sw;
+    return (w.x * u.y - w.y * u.x) > 0;
+}
+
+static inline sweep_point _direction(const sweep_segment& s)
+{
+    sweep_point d;
+    d.x = s.q.x - s.p.x;
+    d.y = s.q.y - s.p.y;
+    return d;
+}
+
+static void _add_contour_point(pod_bvector<sweep_point>& pts, const sweep_point& p)
+{
+    unsigned int n = pts.size();
+    if (n && _point_equal(pts[n - 1], p))
+        return;
+    if ((n > 1) && !_orient(pts[n - 2], pts[n - 1], p))
+        pts[n - 1] = p;
+    else
+        pts.add(p);
+}
+
+// link the edges into contours, at a vertex shared by several contours
+// the sharpest left turn keeps them apart.
+static void _build_polygon(pod_bvector<sweep_segment>& edges, const sweep_grid& grid, gpc_polygon* result)
+{
+    unsigned int n = edges.size();
+    if (!n)
+        return;
+
+    quick_sort(edges, _segment_less);
+
+    pod_array<unsigned char> used(n);
+    memset(used.data(), 0, n);
+
+    pod_bvector<sweep_point> pts;
+    pod_bvector<gpc_vertex_list> contours;
+    pod_bvector<int> holes;
+
+    for (unsigned int i = 0; i < n; i++) {
+        if (used[i])
+            continue;
+
+        pts.clear();
+        sweep_point start = edges[i].p;
+        unsigned int cur = i;
+        while (true) {
+            used[cur] = 1;
+            _add_contour_point(pts, edges[cur].p);
+
+            const sweep_point v = edges[cur].q;
+            if (_point_equal(v, start))
+                break;
+
+            unsigned int lo = 0, hi = n;
+            while (lo < hi) {
+                unsigned int mid = (lo + hi) >> 1;
+                if (_point_less(edges[mid].p, v))
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            sweep_point d = _direction(edges[cur]);
+            unsigned int next = n;
+            for (unsigned int j = lo; (j < n) && _point_equal(edges[j].p, v); j++) {
+                if (!used[j] && ((next == n) || _more_left(d, _direction(edges[j]), _direction(edges[next]))))
+                    next = j;
+            }
+
+            if (next == n) { // left open by rounding, close it here.
+                _add_contour_point(pts, v);
+                break;
+            }
+            cur = next;
+        }
+
+        // clean the seam.
+        unsigned int first = 0;
+        unsigned int count = pts.size();
+        while ((count >= 3) && (_point_equal(pts[first + count - 1], pts[first])
+                    || !_orient(pts[first + count - 2], pts[first + count - 1], pts[first])))
+            count--;
+        while ((count >= 3) && !_orient(pts[first + count - 1], pts[first], pts[first + 1])) {
+            first++;
+            count--;
+        }
+
+        if (count < 3)
+            continue;
+
+        gpc_vertex_list c;
+        c.num_vertices = count;
+        c.vertex = (vertex_s*)mem_malloc(sizeof(vertex_s) * count);
+        if (!c.vertex)
+            continue;
+
+        double area = 0;
+        const sweep_point& o = pts[first];
+        for (unsigned int k = 0; k < count; k++) {
+            const sweep_point& a = pts[first + k];
+            const sweep_point& b = pts[first + (k + 1) % count];
+            area += (double)(a.x - o.x) * (double)(b.y - o.y) - (double)(b.x - o.x) * (double)(a.y - o.y);
+            c.vertex[k] = grid.unsnap(a);
+        }
+
+        contours.add(c);
+        holes.add((area < 0) ? 1 : 0);
+    }
+
+    unsigned int num = contours.size();
+    if (!num)
+        return;
+
+    result->contour = (gpc_vertex_list*)mem_malloc(sizeof(gpc_vertex_list) * num);
+    result->hole = (int*)mem_malloc(sizeof(int) * num);
+    if (!result->contour || !result->hole) {
+        for (unsigned int i = 0; i < num; i++)
+            mem_free(contours[i].vertex);
+        mem_free(result->contour);
+        mem_free(result->hole);
+        result->contour = 0;
+        result->hole = 0;
+        return;
+    }
+
+    for (unsigned int i = 0; i < num; i++) {
+        result->contour[i] = contours[i];
+        result->hole[i] = holes[i];
+    }
+    result->num_contours = num;
+}
+
+void sweep_polygon_clip(gpc_op op, const gpc_polygon* subject, const gpc_polygon* clip, gpc_polygon* result)
+{
+    result->num_contours = 0;
+    result->hole = 0;
+    result->contour = 0;
+
+    sweep_grid grid;
+    grid.add(subject);
+    grid.add(clip);
+    if (!grid.init())
+        return;
+
+    sweep_rule rule = sweep_union;
+    switch (op) {
+        case GPC_DIFF:
+            rule = sweep_diff;
+            break;
+        case GPC_INT:
+            rule = sweep_intersect;
+            break;
+        case GPC_XOR:
+            rule = sweep_xor;
+            break;
+        case GPC_UNION:
+            rule = sweep_union;
+            break;
+    }
+
+    pod_bvector<sweep_segment> edges;
+    {
+        sweep_line sweep(rule);
+        if (!_add_polygon(sweep, grid, subject, 0) || !_add_polygon(sweep, grid, clip, 1))
+            return;
+        if (!sweep.run(edges))
+            return;
+    }
+    _build_polygon(edges, grid, result);
+}
+
+void sweep_polygon_union(const gpc_polygon* polygons, unsigned int num, gpc_polygon* result)
+{
+    result->num_contours = 0;
+    result->hole = 0;
+    result->contour = 0;
+
+    sweep_grid grid;
+    for (unsigned int i = 0; i < num; i++)
+        grid.add(&polygons[i]);
+    if (!grid.init())
+        return;
+
+    // the even-odd fill of each polygon, as edges with the inside on the left.
+    pod_bvector<sweep_segment> oriented;
+    {
+        sweep_line sweep(sweep_union);
+        for (unsigned int i = 0; i < num; i++) {
+            sweep.reset();
+            if (!_add_polygon(sweep, grid, &polygons[i], 0))
+                return;
+            if (!sweep.run(oriented))
+                return;
+        }
+    }
+
+    pod_bvector<sweep_segment> edges;
+    {
+        sweep_line sweep(sweep_nonzero);
+        for (unsigned int i = 0; i < oriented.size(); i++) {
+            if (!sweep.add_edge(oriented[i].p, oriented[i].q, 0))
+                return;
+        }
+        oriented.clear();
+        if (!sweep.run(edges))
+            return;
+    }
+    _build_polygon(edges, grid, result);
+}
+
+}
@@ -0,0 +1,30 @@
+/* Picasso - a vector graphics library
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+#ifndef _PICASSO_SWEEP_H_
+#define _PICASSO_SWEEP_H_
+
+#include "common.h"
+#include "picasso_gpc.h"
+
+namespace picasso {
+
+// Boolean operations of polygons by a sweep line (Martinez-Rueda), in
+// O((n + k) log n) for n edges and k intersections. Vertices are snapped to
+// an integer grid of 2^30 steps over the bounding box of the operands, so the
+// orientation tests are exact and only the crossing points are rounded. When
+// a rounded crossing moves a piece across another, the pieces are swept again.
+// Each operand is filled by the even-odd rule, the result has its outer
+// contours and holes in opposite orientation. Same polygon types as gpc,
+// the result is freed by gpc_free_polygon.
+void sweep_polygon_clip(gpc_op op, const gpc_polygon* subject, const gpc_polygon* clip, gpc_polygon* result);
+
+// Union of many polygons. Every polygon is swept alone to resolve its even-odd
+// fill into oriented edges, then all the edges are swept once by the nonzero rule.
+void sweep_polygon_union(const gpc_polygon* polygons, unsigned int num, gpc_polygon* result);
+
+}
+#endif /*_PICASSO_SWEEP_H_*/
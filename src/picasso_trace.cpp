@@ -0,0 +1,116 @@
+/* Picasso - a vector graphics library
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+#include <stdio.h>
+#include "common.h"
+#include "thread_lock.h"
+#include "render_stats.h"
+
+#include "picasso.h"
+#include "picasso_global.h"
+#include "picasso_trace.h"
+
+volatile int global_trace_enabled = 0;
+
+namespace picasso {
+
+static thread_lock g_trace_lock;
+static FILE* g_trace_file = 0;
+static bool g_trace_first = true;
+static uint64_t g_trace_start = 0;
+static volatile int g_trace_threads = 0;
+static THREAD_LOCAL int g_trace_tid = 0;
+
+void _trace_event(char phase, const char* name, const char* args)
+{
+    if (!g_trace_tid)
+        g_trace_tid = atomic_increment(&g_trace_threads);
+
+    uint64_t now = stats_clock();
+
+    scoped_lock lock(g_trace_lock);
+    if (!g_trace_file) // stopped by other thread.
+        return;
+
+    fprintf(g_trace_file, "%s{\"name\":\"%s\",\"cat\":\"picasso\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+            g_trace_first ? "" : ",\n", name, phase, (double)(now - g_trace_start) / 1000.0, g_trace_tid);
+    if (args)
+        fprintf(g_trace_file, ",\"args\":{%s}", args);
+    fputs("}", g_trace_file);
+    g_trace_first = false;
+}
+
+void trace_scope::end(void)
+{
+    char args[128];
+    int len = 0;
+
+    if (m_vertices)
+        len += snprintf(args + len, sizeof(args) - len, "\"vertices\":%u,", m_vertices);
+
+    if (m_glyphs)
+        len += snprintf(args + len, sizeof(args) - len, "\"glyphs\":%u,", m_glyphs);
+
+    if (m_has_bounds)
+        len += snprintf(args + len, sizeof(args) - len, "\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,",
+                m_bounds.x1, m_bounds.y1, m_bounds.x2 - m_bounds.x1 + 1, m_bounds.y2 - m_bounds.y1 + 1);
+
+    if (len > 0) {
+        args[len - 1] = '\0'; // remove the last comma.
+        _trace_event('E', m_name, args);
+    } else {
+        _trace_event('E', m_name, 0);
+    }
+}
+
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ps_bool PICAPI ps_trace_start(const char* file_name)
+{
+    if (!file_name) {
+        global_status = STATUS_INVALID_ARGUMENT;
+        return False;
+    }
+
+    scoped_lock lock(picasso::g_trace_lock);
+    if (picasso::g_trace_file) {
+        global_status = STATUS_NOT_SUPPORT;
+        return False;
+    }
+
+    picasso::g_trace_file = fopen(file_name, "w");
+    if (!picasso::g_trace_file) {
+        global_status = STATUS_UNKNOWN_ERROR;
+        return False;
+    }
+
+    fputs("{\"traceEvents\":[\n", picasso::g_trace_file);
+    picasso::g_trace_first = true;
+    picasso::g_trace_start = picasso::stats_clock();
+    atomic_store(&global_trace_enabled, 1);
+    global_status = STATUS_SUCCEED;
+    return True;
+}
+
+void PICAPI ps_trace_stop(void)
+{
+    scoped_lock lock(picasso::g_trace_lock);
+    if (picasso::g_trace_file) {
+        atomic_store(&global_trace_enabled, 0);
+        fputs("\n],\"displayTimeUnit\":\"ms\"}\n", picasso::g_trace_file);
+        fclose(picasso::g_trace_file);
+        picasso::g_trace_file = 0;
+    }
+    global_status = STATUS_SUCCEED;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+/* Picasso - a vector graphics library
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+#ifndef _PICASSO_TRACE_H_
+#define _PICASSO_TRACE_H_
+
+#include "common.h"
+#include "graphic_base.h"
+#include "thread_lock.h"
+
+// trace events are written when it is not zero, started and stopped by any thread.
+extern volatile int global_trace_enabled;
+
+namespace picasso {
+
+inline bool _trace_enabled(void)
+{
+    return atomic_load(&global_trace_enabled) != 0;
+}
+
+// write a trace event, phase is 'B' for begin and 'E' for end.
+void _trace_event(char phase, const char* name, const char* args);
+
+// a begin and end event pair around a scope
+class trace_scope
+{
+public:
+    trace_scope(const char* name)
+        : m_name(_trace_enabled() ? name : 0)
+        , m_vertices(0)
+        , m_glyphs(0)
+        , m_has_bounds(false)
+    {
+        if (m_name)
+            _trace_event('B', m_name, 0);
+    }
+
+    ~trace_scope()
+    {
+        if (m_name)
+            end();
+    }
+
+    bool enabled(void) const { return m_name != 0; }
+
+    void vertices(unsigned int n) { m_vertices = n; }
+    void glyphs(unsigned int n) { m_glyphs = n; }
+    void bounds(const rect& r) { m_bounds = r; m_has_bounds = true; }
+
+    // extend the bounds, for drawings made of several parts like glyphs.
+    void add_bounds(const rect& r)
+    {
+        if (!m_has_bounds) {
+            bounds(r);
+            return;
+        }
+        if (r.x1 < m_bounds.x1) m_bounds.x1 = r.x1;
+        if (r.y1 < m_bounds.y1) m_bounds.y1 = r.y1;
+        if (r.x2 > m_bounds.x2) m_bounds.x2 = r.x2;
+        if (r.y2 > m_bounds.y2) m_bounds.y2 = r.y2;
+    }
+
+private:
+    trace_scope(const trace_scope&);
+    trace_scope& operator=(const trace_scope&);
+
+    void end(void);
+
+    const char* m_name;
+    unsigned int m_vertices;
+    unsigned int m_glyphs;
+    bool m_has_bounds;
+    rect m_bounds;
+};
+
+}
+#endif /*_PICASSO_TRACE_H_*/
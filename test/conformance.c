@@ -0,0 +1,395 @@
+/* conformance - headless golden image test base on picasso
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Renders a test scenario into memory canvas of every pixel format and
+ * compares each checked frame with the reference image rendered by a
+ * known good build, so optimized kernels can be verified without GUI.
+ *
+ * usage: conform_<scene> [-g] [-d dir] [-f format] [-t tolerance] [-n frames] [-e every]
+ *
+ *   -g  write reference images instead of comparing with them.
+ *   -d  directory of reference images, default "golden".
+ *   -t  max difference allowed of each channel, default 0 (bit exact).
+ *   -n  frames rendered, timer action is done between frames.
+ *   -e  every how many frames is checked.
+ *
+ * Reference images are gzip compressed PAM files, named
+ * "<scene>_<format>_<frame>.pam.gz", pixels are converted to 8 bits RGBA.
+ * A frame same as the reference of the previous checked frame, or of the
+ * first format, is not written, its reference is found the same way.
+ * The rendered frame is kept as "<scene>_<format>_<frame>.out.pam.gz"
+ * when it does not match.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "picasso.h"
+#include "drawFunc.h"
+
+#define WIDTH   640
+#define HEIGHT  480
+
+static const struct {
+    ps_color_format fmt;
+    const char* name;
+    int bpp;
+} formats[] = {
+    { COLOR_FORMAT_RGBA, "rgba", 4 },
+    { COLOR_FORMAT_ARGB, "argb", 4 },
+    { COLOR_FORMAT_ABGR, "abgr", 4 },
+    { COLOR_FORMAT_BGRA, "bgra", 4 },
+    { COLOR_FORMAT_RGB, "rgb", 3 },
+    { COLOR_FORMAT_BGR, "bgr", 3 },
+    { COLOR_FORMAT_RGB565, "rgb565", 2 },
+    { COLOR_FORMAT_RGB555, "rgb555", 2 },
+};
+
+#define NUM_FORMATS (sizeof(formats) / sizeof(formats[0]))
+
+static unsigned short read_u16(const unsigned char* p)
+{
+    return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static unsigned read_u32(const unsigned char* p)
+{
+    return (unsigned)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24));
+}
+
+/* load a 24 bits bitmap file as RGB, the same as the gtk test loads png. */
+static unsigned char* load_bitmap(const char* name, int* width, int* height, int* stride)
+{
+    FILE* f;
+    unsigned char head[54];
+    unsigned char* data;
+    int w, h, bottom_up, src_stride, x, y;
+
+    if ((f = fopen(name, "rb")) == NULL)
+        return NULL;
+
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) || head[0] != 'B' || head[1] != 'M'
+        || read_u16(head + 28) != 24 || read_u32(head + 30) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    w = (int)read_u32(head + 18);
+    h = (int)read_u32(head + 22);
+    bottom_up = h > 0;
+    if (h < 0)
+        h = -h;
+
+    src_stride = (w * 3 + 3) & ~3;
+    data = (unsigned char*)calloc(1, src_stride * h);
+    fseek(f, (long)read_u32(head + 10), SEEK_SET);
+    for (y = 0; y < h; y++) {
+        unsigned char* row = data + (bottom_up ? (h - 1 - y) : y) * src_stride;
+        if (fread(row, 1, src_stride, f) != (size_t)src_stride)
+            break;
+        for (x = 0; x < w; x++) {
+            unsigned char t = row[x*3];
+            row[x*3] = row[x*3+2];
+            row[x*3+2] = t;
+        }
+    }
+    fclose(f);
+
+    *width = w;
+    *height = h;
+    *stride = src_stride;
+    return data;
+}
+
+/* convert pixels of format to 8 bits RGBA. */
+static void to_rgba(ps_color_format fmt, const unsigned char* s, unsigned char* d, int count)
+{
+    int i;
+    for (i = 0; i < count; i++, d += 4) {
+        unsigned v;
+        switch (fmt) {
+            case COLOR_FORMAT_RGBA:
+                d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3];
+                s += 4;
+                break;
+            case COLOR_FORMAT_ARGB:
+                d[0] = s[1]; d[1] = s[2]; d[2] = s[3]; d[3] = s[0];
+                s += 4;
+                break;
+            case COLOR_FORMAT_ABGR:
+                d[0] = s[3]; d[1] = s[2]; d[2] = s[1]; d[3] = s[0];
+                s += 4;
+                break;
+            case COLOR_FORMAT_BGRA:
+                d[0] = s[2]; d[1] = s[1]; d[2] = s[0]; d[3] = s[3];
+                s += 4;
+                break;
+            case COLOR_FORMAT_RGB:
+                d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 255;
+                s += 3;
+                break;
+            case COLOR_FORMAT_BGR:
+                d[0] = s[2]; d[1] = s[1]; d[2] = s[0]; d[3] = 255;
+                s += 3;
+                break;
+            case COLOR_FORMAT_RGB565:
+                v = read_u16(s);
+                d[0] = (unsigned char)((v >> 8) & 0xF8);
+                d[1] = (unsigned char)((v >> 3) & 0xFC);
+                d[2] = (unsigned char)((v << 3) & 0xF8);
+                d[3] = 255;
+                s += 2;
+                break;
+            case COLOR_FORMAT_RGB555:
+                v = read_u16(s);
+                d[0] = (unsigned char)((v >> 7) & 0xF8);
+                d[1] = (unsigned char)((v >> 2) & 0xF8);
+                d[2] = (unsigned char)((v << 3) & 0xF8);
+                d[3] = 255;
+                s += 2;
+                break;
+            default:
+                d[0] = d[1] = d[2] = d[3] = 0;
+                break;
+        }
+    }
+}
+
+static int write_image(const char* name, const unsigned char* rgba, int w, int h)
+{
+    char head[128];
+    int len;
+    gzFile f = gzopen(name, "wb6");
+    if (!f)
+        return 0;
+
+    len = sprintf(head, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", w, h);
+    if (gzwrite(f, head, len) != len || gzwrite(f, rgba, w * h * 4) != w * h * 4) {
+        gzclose(f);
+        return 0;
+    }
+    return gzclose(f) == Z_OK;
+}
+
+static int read_image(const char* name, unsigned char* rgba, int w, int h)
+{
+    char head[128];
+    int rw = 0, rh = 0, len;
+    gzFile f = gzopen(name, "rb");
+    if (!f)
+        return 0;
+
+    len = sprintf(head, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", w, h);
+    if (gzread(f, head, len) != len || sscanf(head, "P7\nWIDTH %d\nHEIGHT %d", &rw, &rh) != 2
+        || rw != w || rh != h || gzread(f, rgba, w * h * 4) != w * h * 4) {
+        gzclose(f);
+        return 0;
+    }
+    gzclose(f);
+    return 1;
+}
+
+static const char* scene_name(const char* path)
+{
+    static char name[64];
+    const char* p = strrchr(path, '/');
+    char* e;
+
+    if (!p)
+        p = strrchr(path, '\\');
+    p = p ? p + 1 : path;
+    if (!strncmp(p, "conform_", 8))
+        p += 8;
+
+    strncpy(name, p, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    if ((e = strchr(name, '.')) != NULL)
+        *e = '\0';
+    return name;
+}
+
+static int generate = 0;
+static const char* golden = "golden";
+static int tolerance = 0;
+static int frames = 168; /* every composite operator is drawn. */
+static int every = 6;
+
+/* reference of a frame, the nearest frame written before or the first format. */
+static int find_image(const char* scene, unsigned i, int n, unsigned char* rgba)
+{
+    char name[512];
+    int k;
+
+    for (k = n; k >= 0; k -= every) {
+        sprintf(name, "%s/%s_%s_%d.pam.gz", golden, scene, formats[i].name, k);
+        if (read_image(name, rgba, WIDTH, HEIGHT))
+            return 1;
+    }
+    return i ? find_image(scene, 0, n, rgba) : 0;
+}
+
+/* returns number of frames which do not match. */
+static int run_format(const char* scene, unsigned i)
+{
+    int stride = WIDTH * formats[i].bpp;
+    ps_byte* buffer = (ps_byte*)malloc(stride * HEIGHT);
+    unsigned char* out = (unsigned char*)malloc(WIDTH * HEIGHT * 4);
+    unsigned char* ref = (unsigned char*)malloc(WIDTH * HEIGHT * 4);
+    unsigned char *image, *pattern;
+    int iw, ih, is, pw, ph, pst;
+    int n, p, failed = 0, checked = 0, written = 0;
+    char name[512];
+    ps_canvas* canvas;
+    ps_context* context;
+
+    image = load_bitmap("selt2.bmp", &iw, &ih, &is);
+    pattern = load_bitmap("pat.bmp", &pw, &ph, &pst);
+    if (!image || !pattern) {
+        fprintf(stderr, "can not load selt2.bmp or pat.bmp.\n");
+        exit(2);
+    }
+
+    memset(buffer, 0xFF, stride * HEIGHT);
+    canvas = ps_canvas_create_with_data(buffer, formats[i].fmt, WIDTH, HEIGHT, stride);
+    context = ps_context_create(canvas, 0);
+
+    init_context(context, canvas, buffer);
+    srand(1); /* scenes seed with time in init. */
+    set_image_data(image, COLOR_FORMAT_RGB, iw, ih, is);
+    set_pattern_data(pattern, COLOR_FORMAT_RGB, pw, ph, pst);
+
+    for (n = 0; n < frames; n++) {
+        memset(buffer, 0xFF, stride * HEIGHT);
+        draw_test(0, context);
+
+        if (n % every == 0) {
+            to_rgba(formats[i].fmt, buffer, out, WIDTH * HEIGHT);
+            sprintf(name, "%s/%s_%s_%d.pam.gz", golden, scene, formats[i].name, n);
+            checked++;
+
+            if (generate) {
+                if (!find_image(scene, i, n, ref) || memcmp(out, ref, WIDTH * HEIGHT * 4)) {
+                    if (!write_image(name, out, WIDTH, HEIGHT)) {
+                        fprintf(stderr, "can not write %s.\n", name);
+                        exit(2);
+                    }
+                    written++;
+                }
+            } else if (!find_image(scene, i, n, ref)) {
+                fprintf(stderr, "%s %s frame %d: can not read %s.\n", scene, formats[i].name, n, name);
+                failed++;
+            } else {
+                int bad = 0, max_diff = 0;
+                for (p = 0; p < WIDTH * HEIGHT * 4; p += 4) {
+                    int c, pixel_diff = 0;
+                    for (c = 0; c < 4; c++) {
+                        int d = abs(out[p + c] - ref[p + c]);
+                        if (d > pixel_diff)
+                            pixel_diff = d;
+                    }
+                    if (pixel_diff > tolerance)
+                        bad++;
+                    if (pixel_diff > max_diff)
+                        max_diff = pixel_diff;
+                }
+
+                if (bad) {
+                    fprintf(stderr, "%s %s frame %d: %d pixels differ, max difference %d.\n",
+                            scene, formats[i].name, n, bad, max_diff);
+                    sprintf(name, "%s/%s_%s_%d.out.pam.gz", golden, scene, formats[i].name, n);
+                    write_image(name, out, WIDTH, HEIGHT);
+                    failed++;
+                }
+            }
+        }
+
+        timer_action(context);
+    }
+
+    dini_context(context);
+    ps_context_unref(context);
+    ps_canvas_unref(canvas);
+
+    if (generate)
+        printf("%s %s: written %d of %d frames\n", scene, formats[i].name, written, checked);
+    else if (failed)
+        printf("%s %s: FAILED %d of %d frames\n", scene, formats[i].name, failed, checked);
+    else
+        printf("%s %s: passed %d frames\n", scene, formats[i].name, checked);
+
+    free(image);
+    free(pattern);
+    free(buffer);
+    free(out);
+    free(ref);
+    return failed;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* only = NULL;
+    const char* scene = scene_name(argv[0]);
+    int j, failed = 0;
+    unsigned i;
+
+    for (j = 1; j < argc; j++) {
+        if (!strcmp(argv[j], "-g"))
+            generate = 1;
+        else if (j + 1 < argc && !strcmp(argv[j], "-d"))
+            golden = argv[++j];
+        else if (j + 1 < argc && !strcmp(argv[j], "-f"))
+            only = argv[++j];
+        else if (j + 1 < argc && !strcmp(argv[j], "-t"))
+            tolerance = atoi(argv[++j]);
+        else if (j + 1 < argc && !strcmp(argv[j], "-n"))
+            frames = atoi(argv[++j]);
+        else if (j + 1 < argc && !strcmp(argv[j], "-e"))
+            every = atoi(argv[++j]);
+        else
+            frames = 0;
+    }
+
+    if (frames < 1 || every < 1 || tolerance < 0) {
+        fprintf(stderr, "usage: %s [-g] [-d dir] [-f format] [-t tolerance] [-n frames] [-e every]\n", argv[0]);
+        return 2;
+    }
+
+    if (!only) {
+        /* the scenes keep states in statics, every format is run by a new process. */
+        for (i = 0; i < NUM_FORMATS; i++) {
+            char cmd[1024];
+            sprintf(cmd, "\"%s\" %s-d \"%s\" -f %s -t %d -n %d -e %d", argv[0], generate ? "-g " : "",
+                    golden, formats[i].name, tolerance, frames, every);
+            if (system(cmd) != 0)
+                failed++;
+        }
+        return failed ? 1 : 0;
+    }
+
+    for (i = 0; i < NUM_FORMATS; i++) {
+        if (!strcmp(only, formats[i].name))
+            break;
+    }
+
+    if (i == NUM_FORMATS) {
+        fprintf(stderr, "unknown format %s.\n", only);
+        return 2;
+    }
+
+    if (!ps_initialize()) {
+        fprintf(stderr, "picasso initialize failed.\n");
+        return 2;
+    }
+
+    failed = run_format(scene, i);
+
+    ps_shutdown();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,688 @@
+/* kernel_bench - microbenchmarks of the rendering kernels
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Measures the inner kernels of the software renderer in isolation:
+ * composite operators, solid span blending with different cover patterns,
+ * image filter spans, gradient spans, stack blur, cell sorting and line
+ * stroking. Every kernel runs on a small working set which stays in cache,
+ * the best of all repetitions is reported in cycles (time stamp counter
+ * where available, nanoseconds otherwise) per pixel, cell or vertex.
+ *
+ * usage: kernel_bench [-r repeats] [-k kernel]
+ *
+ * Results are written to stdout in JSON.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(WIN32) || defined(WINCE)
+#include <windows.h>
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <time.h>
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#include "common.h"
+#include "convert.h"
+#include "graphic_path.h"
+
+#include "picasso.h"
+#include "picasso_gradient.h"
+
+#include "gfx_blur.h"
+#include "gfx_gradient_adapter.h"
+#include "gfx_image_filters.h"
+#include "gfx_painter_helper.h"
+#include "gfx_pixfmt_wrapper.h"
+#include "gfx_rasterizer_scanline.h"
+#include "gfx_rendering_buffer.h"
+#include "gfx_span_generator.h"
+#include "gfx_span_image_filters.h"
+#include "gfx_trans_affine.h"
+
+using namespace gfx;
+
+#define SPAN_WIDTH  256
+#define SPAN_ROWS   64
+
+static int repeats = 20;
+static const char* only = 0;
+static bool first_result = true;
+
+#if defined(WIN32) || defined(WINCE) || defined(__i386__) || defined(__x86_64__)
+static const char* counter_unit = "cycles";
+
+static inline uint64_t counter(void)
+{
+    return __rdtsc();
+}
+#else
+static const char* counter_unit = "ns";
+
+static inline uint64_t counter(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+#endif
+
+static bool selected(const char* kernel)
+{
+    return !only || strstr(kernel, only);
+}
+
+static void report(const char* kernel, const char* format, const char* variant,
+                   const char* per, uint64_t best, unsigned int units)
+{
+    printf("%s\n  {\"kernel\": \"%s\", \"format\": \"%s\", \"case\": \"%s\", \"%s_per_%s\": %.3f}",
+            first_result ? "" : ",", kernel, format, variant, counter_unit, per, (double)best / units);
+    first_result = false;
+    fflush(stdout);
+}
+
+// best of repeats, Bench::setup is not timed.
+template <typename Bench>
+static uint64_t measure(Bench& b)
+{
+    uint64_t best = (uint64_t)-1;
+    for (int i = 0; i < repeats; i++) {
+        b.setup();
+        uint64_t t1 = counter();
+        b.run();
+        uint64_t t2 = counter();
+        if (t2 - t1 < best)
+            best = t2 - t1;
+    }
+    return best;
+}
+
+static unsigned int rand_seed = 1;
+
+static unsigned int next_rand(void)
+{
+    rand_seed = rand_seed * 1103515245 + 12345;
+    return (rand_seed >> 16) & 0x7FFF;
+}
+
+// a pixel buffer of format Pixfmt, with a copy to restore after each run.
+template <typename Pixfmt>
+class bench_surface
+{
+public:
+    typedef typename painter_raster<Pixfmt>::format format;
+    typedef typename format::color_type color_type;
+
+    bench_surface(unsigned int w, unsigned int h)
+        : m_size(w * h * format::pix_width)
+        , m_data((byte*)malloc(m_size))
+        , m_orig((byte*)malloc(m_size))
+        , m_buffer(m_data, w, h, w * format::pix_width)
+        , m_fmt(m_buffer)
+    {
+        // premultiplied pixels, as the composite operators expect.
+        color_type row[SPAN_WIDTH];
+        for (unsigned int y = 0; y < h; y++) {
+            for (unsigned int x = 0; x < w; x++) {
+                unsigned int a = next_rand() & 0xFF;
+                row[x] = rgba8(next_rand() % (a + 1), next_rand() % (a + 1), next_rand() % (a + 1), a);
+            }
+            m_fmt.copy_color_hspan(0, y, w, row);
+        }
+        memcpy(m_orig, m_data, m_size);
+    }
+
+    ~bench_surface()
+    {
+        free(m_data);
+        free(m_orig);
+    }
+
+    void restore(void) { memcpy(m_data, m_orig, m_size); }
+
+    format& fmt(void) { return m_fmt; }
+
+private:
+    unsigned int m_size;
+    byte* m_data;
+    byte* m_orig;
+    gfx_rendering_buffer m_buffer;
+    format m_fmt;
+};
+
+static void make_colors(rgba8* colors, unsigned int len)
+{
+    for (unsigned int i = 0; i < len; i++)
+        colors[i] = rgba8(next_rand() & 0xFF, next_rand() & 0xFF, next_rand() & 0xFF, next_rand() & 0xFF);
+}
+
+// composite operators
+template <typename Pixfmt>
+struct composite_bench
+{
+    bench_surface<Pixfmt> surface;
+    rgba8 colors[SPAN_WIDTH];
+    cover_type covers[SPAN_WIDTH];
+
+    composite_bench(unsigned int op)
+        : surface(SPAN_WIDTH, SPAN_ROWS)
+    {
+        make_colors(colors, SPAN_WIDTH);
+        memset(covers, cover_full, SPAN_WIDTH);
+        surface.fmt().blend_op(op);
+    }
+
+    void setup(void) { surface.restore(); }
+
+    void run(void)
+    {
+        for (int y = 0; y < SPAN_ROWS; y++)
+            surface.fmt().blend_color_hspan(0, y, SPAN_WIDTH, colors, covers, cover_full);
+    }
+};
+
+static const char* composite_names[] = {
+    "clear", "src", "src_over", "src_in", "src_out", "src_atop",
+    "dst", "dst_over", "dst_in", "dst_out", "dst_atop", "xor",
+    "darken", "lighten", "overlay", "screen", "multiply", "plus",
+    "minus", "exclusion", "difference", "soft_light", "hard_light",
+    "color_burn", "color_dodge", "contrast", "invert", "invert_rgb",
+};
+
+template <typename Pixfmt>
+static void bench_composite(const char* format)
+{
+    if (!selected("composite"))
+        return;
+
+    for (unsigned int op = 0; op < end_of_comp_op; op++) {
+        composite_bench<Pixfmt> b(op);
+        report("composite", format, composite_names[op], "pixel", measure(b), SPAN_WIDTH * SPAN_ROWS);
+    }
+}
+
+// solid span blending
+enum {
+    cover_pattern_full,
+    cover_pattern_zero,
+    cover_pattern_half,
+    cover_pattern_ramp,
+    cover_pattern_random,
+    cover_pattern_edges,
+    cover_patterns,
+};
+
+static const char* cover_pattern_names[] = {
+    "full", "zero", "half", "ramp", "random", "edges",
+};
+
+static void make_covers(cover_type* covers, unsigned int len, int pattern)
+{
+    for (unsigned int i = 0; i < len; i++) {
+        switch (pattern) {
+            case cover_pattern_full:
+                covers[i] = cover_full;
+                break;
+            case cover_pattern_zero:
+                covers[i] = 0;
+                break;
+            case cover_pattern_half:
+                covers[i] = cover_full / 2;
+                break;
+            case cover_pattern_ramp:
+                covers[i] = (cover_type)(i & 0xFF);
+                break;
+            case cover_pattern_random:
+                covers[i] = (cover_type)next_rand();
+                break;
+            case cover_pattern_edges: // antialiased edges around solid runs.
+                covers[i] = ((i & 31) < 2 || (i & 31) > 29) ? (cover_type)(next_rand() & 0xFF) : cover_full;
+                break;
+        }
+    }
+}
+
+template <typename Pixfmt>
+struct solid_span_bench
+{
+    bench_surface<Pixfmt> surface;
+    rgba8 color;
+    cover_type covers[SPAN_WIDTH];
+
+    solid_span_bench(int pattern, bool opaque)
+        : surface(SPAN_WIDTH, SPAN_ROWS)
+        , color(rgba8(200, 100, 50, opaque ? 255 : 128))
+    {
+        make_covers(covers, SPAN_WIDTH, pattern);
+    }
+
+    void setup(void) { surface.restore(); }
+
+    void run(void)
+    {
+        for (int y = 0; y < SPAN_ROWS; y++)
+            surface.fmt().blend_solid_hspan(0, y, SPAN_WIDTH, color, covers);
+    }
+};
+
+template <typename Pixfmt>
+static void bench_solid_span(const char* format)
+{
+    if (!selected("blend_solid_hspan"))
+        return;
+
+    char name[64];
+    for (int p = 0; p < cover_patterns; p++) {
+        for (int opaque = 1; opaque >= 0; opaque--) {
+            solid_span_bench<Pixfmt> b(p, opaque != 0);
+            sprintf(name, "%s_%s", cover_pattern_names[p], opaque ? "opaque" : "alpha");
+            report("blend_solid_hspan", format, name, "pixel", measure(b), SPAN_WIDTH * SPAN_ROWS);
+        }
+    }
+}
+
+// image filter spans
+static void image_matrix(gfx_trans_affine& mtx)
+{
+    mtx *= gfx_trans_affine_rotation(FLT_TO_SCALAR(0.3f));
+    mtx *= gfx_trans_affine_scaling(FLT_TO_SCALAR(1.3f), FLT_TO_SCALAR(1.3f));
+    mtx *= gfx_trans_affine_translation(FLT_TO_SCALAR(20.0f), FLT_TO_SCALAR(10.0f));
+    mtx.invert();
+}
+
+template <typename SpanGenerator>
+struct image_span_bench
+{
+    SpanGenerator& sg;
+    rgba8 span[SPAN_WIDTH];
+
+    image_span_bench(SpanGenerator& gen)
+        : sg(gen)
+    {
+    }
+
+    void setup(void) { }
+
+    void run(void)
+    {
+        sg.prepare();
+        for (int y = 0; y < SPAN_ROWS; y++)
+            sg.generate(span, 0, y, SPAN_WIDTH);
+    }
+};
+
+template <typename Pixfmt, typename SpanGenerator>
+static void bench_image_filter(const char* format, const char* variant, image_filter_adapter* filter)
+{
+    typedef typename painter_raster<Pixfmt>::source_type source_type;
+
+    bench_surface<Pixfmt> image(SPAN_WIDTH, SPAN_ROWS * 2);
+    source_type source(image.fmt());
+    gfx_trans_affine mtx;
+    image_matrix(mtx);
+    gfx_span_interpolator_linear interpolator(mtx);
+
+    SpanGenerator sg(source, interpolator, *filter);
+    image_span_bench<SpanGenerator> b(sg);
+    report("image_filter", format, variant, "pixel", measure(b), SPAN_WIDTH * SPAN_ROWS);
+}
+
+template <typename Pixfmt, typename SpanGenerator>
+static void bench_image_filter_nn(const char* format, const char* variant)
+{
+    typedef typename painter_raster<Pixfmt>::source_type source_type;
+
+    bench_surface<Pixfmt> image(SPAN_WIDTH, SPAN_ROWS * 2);
+    source_type source(image.fmt());
+    gfx_trans_affine mtx;
+    image_matrix(mtx);
+    gfx_span_interpolator_linear interpolator(mtx);
+
+    SpanGenerator sg(source, interpolator);
+    image_span_bench<SpanGenerator> b(sg);
+    report("image_filter", format, variant, "pixel", measure(b), SPAN_WIDTH * SPAN_ROWS);
+}
+
+template <typename Pixfmt>
+static void bench_image_filters(const char* format)
+{
+    if (!selected("image_filter"))
+        return;
+
+    typedef painter_raster<Pixfmt> types;
+
+    image_filter_adapter* bilinear = create_image_filter(FILTER_BILINEAR);
+    image_filter_adapter* gaussian = create_image_filter(FILTER_GAUSSIAN);
+
+    bench_image_filter_nn<Pixfmt, typename types::span_image_filter_type_nn>(format, "image_nearest");
+    bench_image_filter<Pixfmt, typename types::span_image_filter_type>(format, "image_bilinear", bilinear);
+    bench_image_filter<Pixfmt, typename types::span_image_filter_type>(format, "image_gaussian", gaussian);
+    bench_image_filter_nn<Pixfmt, typename types::span_canvas_filter_type_nn>(format, "canvas_nearest");
+    bench_image_filter<Pixfmt, typename types::span_canvas_filter_type>(format, "canvas_bilinear", bilinear);
+    bench_image_filter<Pixfmt, typename types::span_canvas_filter_type>(format, "canvas_gaussian", gaussian);
+
+    delete bilinear;
+    delete gaussian;
+}
+
+// gradient spans
+struct gradient_bench
+{
+    gfx_gradient_adapter gradient;
+    gfx_trans_affine mtx;
+    rgba8 span[SPAN_WIDTH];
+
+    gradient_bench(int type, int spread)
+    {
+        switch (type) {
+            case 0:
+                gradient.init_linear(spread, 10, 10, 200, 50);
+                break;
+            case 1:
+                gradient.init_radial(spread, 100, 30, 10, 128, 32, 120);
+                break;
+            case 2:
+                gradient.init_conic(spread, 128, 32, FLT_TO_SCALAR(0.5f));
+                break;
+        }
+        gradient.add_color_stop(FLT_TO_SCALAR(0.0f), rgba(1, 0, 0, 1));
+        gradient.add_color_stop(FLT_TO_SCALAR(0.5f), rgba(0, 1, 0, 0.5f));
+        gradient.add_color_stop(FLT_TO_SCALAR(1.0f), rgba(0, 0, 1, 1));
+        gradient.build();
+
+        mtx = gradient.matrix();
+        mtx.invert();
+    }
+
+    void setup(void) { }
+
+    void run(void)
+    {
+        gfx_span_interpolator_linear inter(mtx);
+        gfx_span_gradient<rgba8> sg(inter, *gradient.wrapper(), gradient.colors(),
+                                    gradient.start(), gradient.length());
+        sg.prepare();
+        for (int y = 0; y < SPAN_ROWS; y++)
+            sg.generate(span, 0, y, SPAN_WIDTH);
+    }
+};
+
+static void bench_gradients(void)
+{
+    if (!selected("gradient"))
+        return;
+
+    static const char* types[] = { "linear", "radial", "conic" };
+    static const char* spreads[] = { "pad", "repeat", "reflect" };
+    static const int spread_values[] = { SPREAD_PAD, SPREAD_REPEAT, SPREAD_REFLECT };
+    char name[64];
+
+    for (int t = 0; t < 3; t++) {
+        for (int s = 0; s < 3; s++) {
+            gradient_bench b(t, spread_values[s]);
+            sprintf(name, "%s_%s", types[t], spreads[s]);
+            report("gradient", "rgba8", name, "pixel", measure(b), SPAN_WIDTH * SPAN_ROWS);
+        }
+    }
+}
+
+// stack blur
+template <typename Pixfmt>
+struct blur_bench
+{
+    bench_surface<Pixfmt> surface;
+    stack_blur<rgba8> blur;
+    unsigned int radius;
+
+    blur_bench(unsigned int r)
+        : surface(SPAN_WIDTH, SPAN_WIDTH)
+        , radius(r)
+    {
+    }
+
+    void setup(void) { surface.restore(); }
+
+    void run(void)
+    {
+        blur.blur(surface.fmt(), radius);
+    }
+};
+
+template <typename Pixfmt>
+static void bench_blur(const char* format)
+{
+    if (!selected("stack_blur"))
+        return;
+
+    static const unsigned int radii[] = { 1, 2, 4, 8, 16, 32, 64 };
+    char name[64];
+
+    for (unsigned int i = 0; i < sizeof(radii) / sizeof(radii[0]); i++) {
+        blur_bench<Pixfmt> b(radii[i]);
+        sprintf(name, "radius_%u", radii[i]);
+        report("stack_blur", format, name, "pixel", measure(b), SPAN_WIDTH * SPAN_WIDTH);
+    }
+}
+
+// cell sorting
+#define SORT_CELLS 65536
+
+static bool cell_less(const cell* a, const cell* b)
+{
+    return a->x < b->x;
+}
+
+static void insertion_sort_cells(cell** start, unsigned int num)
+{
+    for (unsigned int i = 1; i < num; i++) {
+        cell* c = start[i];
+        unsigned int j = i;
+        for (; j > 0 && c->x < start[j - 1]->x; j--)
+            start[j] = start[j - 1];
+        start[j] = c;
+    }
+}
+
+struct sort_bench
+{
+    cell* cells;
+    cell** orig;
+    cell** ptrs;
+    unsigned int row;
+    int method;
+
+    sort_bench(unsigned int row_cells, int pattern, int m)
+        : cells(new cell[SORT_CELLS])
+        , orig(new cell*[SORT_CELLS])
+        , ptrs(new cell*[SORT_CELLS])
+        , row(row_cells)
+        , method(m)
+    {
+        for (unsigned int i = 0; i < SORT_CELLS; i++) {
+            unsigned int k = i % row;
+            switch (pattern) {
+                case 0: // random
+                    cells[i].x = next_rand() % 4096;
+                    break;
+                case 1: // sorted
+                    cells[i].x = k;
+                    break;
+                case 2: // reversed
+                    cells[i].x = row - k;
+                    break;
+                case 3: // nearly sorted, as produced by scanning edges.
+                    cells[i].x = k + (next_rand() % 4);
+                    break;
+            }
+            orig[i] = &cells[i];
+        }
+    }
+
+    ~sort_bench()
+    {
+        delete [] cells;
+        delete [] orig;
+        delete [] ptrs;
+    }
+
+    void setup(void) { memcpy(ptrs, orig, sizeof(cell*) * SORT_CELLS); }
+
+    void run(void)
+    {
+        for (unsigned int i = 0; i + row <= SORT_CELLS; i += row) {
+            switch (method) {
+                case 0:
+                    qsort_cells(ptrs + i, row);
+                    break;
+                case 1:
+                    std::sort(ptrs + i, ptrs + i + row, cell_less);
+                    break;
+                case 2:
+                    insertion_sort_cells(ptrs + i, row);
+                    break;
+            }
+        }
+    }
+};
+
+static void bench_sort_cells(void)
+{
+    if (!selected("sort_cells"))
+        return;
+
+    static const char* methods[] = { "qsort_cells", "std_sort", "insertion" };
+    static const char* patterns[] = { "random", "sorted", "reversed", "nearly_sorted" };
+    static const unsigned int rows[] = { 8, 32, 256, 4096 };
+    char name[64];
+
+    for (unsigned int r = 0; r < sizeof(rows) / sizeof(rows[0]); r++) {
+        for (int p = 0; p < 4; p++) {
+            for (int m = 0; m < 3; m++) {
+                if (m == 2 && rows[r] > 256 && p != 1 && p != 3)
+                    continue; // quadratic.
+                sort_bench b(rows[r], p, m);
+                sprintf(name, "%s_%s_%u", methods[m], patterns[p], rows[r]);
+                report("sort_cells", "cell", name, "cell", measure(b), (SORT_CELLS / rows[r]) * rows[r]);
+            }
+        }
+    }
+}
+
+// line stroking
+static void make_polyline(graphic_path& path)
+{
+    path.move_to(FLT_TO_SCALAR(10.0f), FLT_TO_SCALAR(10.0f));
+    for (int i = 1; i < 2000; i++)
+        path.line_to(INT_TO_SCALAR(10 + (i % 200) * 2), INT_TO_SCALAR(10 + (i & 1) * 30 + i / 200 * 40));
+}
+
+struct stroke_bench
+{
+    graphic_path path;
+    line_join join;
+    bool raster;
+    unsigned int vertices;
+    unsigned int cells;
+
+    stroke_bench(line_join j, bool r)
+        : join(j)
+        , raster(r)
+        , vertices(0)
+        , cells(0)
+    {
+        make_polyline(path);
+    }
+
+    void setup(void) { }
+
+    void run(void)
+    {
+        conv_stroke stroke(path);
+        stroke.set_width(FLT_TO_SCALAR(6.0f));
+        stroke.set_line_join(join);
+
+        if (raster) {
+            gfx_rasterizer_scanline_aa<> ras;
+            ras.add_path(stroke);
+            ras.sort();
+            cells = ras.total_cells();
+        } else {
+            scalar x, y;
+            unsigned int n = 0;
+            stroke.rewind(0);
+            while (!is_stop(stroke.vertex(&x, &y)))
+                n++;
+            vertices = n;
+        }
+    }
+};
+
+static void bench_stroke(void)
+{
+    static const char* joins[] = { "miter", "miter_revert", "round", "bevel", "miter_round" };
+
+    for (int j = miter_join; j <= miter_join_round; j++) {
+        if (selected("conv_stroke")) {
+            stroke_bench b((line_join)j, false);
+            report("conv_stroke", "path", joins[j], "vertex", measure(b), b.path.total_vertices());
+        }
+
+        if (selected("stroke_raster")) {
+            stroke_bench b((line_join)j, true);
+            uint64_t best = measure(b);
+            report("stroke_raster", "path", joins[j], "cell", best, b.cells ? b.cells : 1);
+        }
+    }
+}
+
+template <typename Pixfmt>
+static void bench_pixfmt(const char* format)
+{
+    bench_composite<Pixfmt>(format);
+    bench_solid_span<Pixfmt>(format);
+    bench_image_filters<Pixfmt>(format);
+    bench_blur<Pixfmt>(format);
+}
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc - 1; i += 2) {
+        if (!strcmp(argv[i], "-r"))
+            repeats = atoi(argv[i+1]);
+        else if (!strcmp(argv[i], "-k"))
+            only = argv[i+1];
+    }
+
+    if (repeats < 1) {
+        fprintf(stderr, "usage: %s [-r repeats] [-k kernel]\n", argv[0]);
+        return 1;
+    }
+
+    printf("[");
+
+    bench_pixfmt<pixfmt_rgba32>("rgba");
+    bench_pixfmt<pixfmt_argb32>("argb");
+    bench_pixfmt<pixfmt_abgr32>("abgr");
+    bench_pixfmt<pixfmt_bgra32>("bgra");
+    bench_pixfmt<pixfmt_rgb24>("rgb");
+    bench_pixfmt<pixfmt_bgr24>("bgr");
+    bench_pixfmt<pixfmt_rgb565>("rgb565");
+    bench_pixfmt<pixfmt_rgb555>("rgb555");
+
+    bench_gradients();
+    bench_sort_cells();
+    bench_stroke();
+
+    printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,110 @@
+/* memory_trim - memory statistics and trimming test base on picasso
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Draws a large frame with shadow and text, which grows the storages of
+ * the context, then trims the context and the caches. The memory held by
+ * the context must drop to a small part of the peak, and the frame drawn
+ * again after trimming must be the same.
+ *
+ * usage: memory_trim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picasso.h"
+
+#define WIDTH   1600
+#define HEIGHT  1200
+
+/* trimmed context keeps less than this part of the peak. */
+#define TRIM_RATIO  10
+
+static void draw_frame(ps_context* ctx, ps_font* font)
+{
+    ps_color white = {1, 1, 1, 1};
+    ps_color red = {0.8f, 0.1f, 0.1f, 1};
+    ps_color shadow = {0, 0, 0, 0.5f};
+    ps_rect r = {100, 100, WIDTH - 200, HEIGHT - 200};
+    ps_rect area = {0, 0, WIDTH, HEIGHT};
+    const char* text = "picasso memory trim";
+    ps_font* old;
+
+    ps_set_source_color(ctx, &white);
+    ps_clear(ctx);
+
+    ps_save(ctx);
+    ps_set_shadow(ctx, 10, 10, 0.2f);
+    ps_set_shadow_color(ctx, &shadow);
+    ps_set_source_color(ctx, &red);
+    ps_ellipse(ctx, &r);
+    ps_fill(ctx);
+    ps_restore(ctx);
+
+    old = ps_set_font(ctx, font);
+    ps_draw_text(ctx, &area, text, (unsigned int)strlen(text), DRAW_TEXT_FILL, TEXT_ALIGN_CENTER);
+    ps_set_font(ctx, old);
+}
+
+int main(int argc, char* argv[])
+{
+    int stride = WIDTH * 4;
+    ps_byte* first = (ps_byte*)calloc(1, stride * HEIGHT);
+    ps_byte* second = (ps_byte*)calloc(1, stride * HEIGHT);
+    ps_memory_stats peak, trimmed, shared;
+    ps_canvas* canvas;
+    ps_context* ctx;
+    ps_font* font;
+    int failed = 0;
+
+    if (!ps_initialize()) {
+        fprintf(stderr, "picasso initialize failed.\n");
+        return 1;
+    }
+
+    canvas = ps_canvas_create_with_data(first, COLOR_FORMAT_RGBA, WIDTH, HEIGHT, stride);
+    ctx = ps_context_create(canvas, 0);
+    font = ps_font_create("Sans", CHARSET_ANSI, 96, FONT_WEIGHT_BOLD, False);
+
+    draw_frame(ctx, font);
+    ps_get_memory_stats(ctx, &peak);
+
+    ps_context_trim(ctx);
+    ps_get_memory_stats(ctx, &trimmed);
+
+    printf("context: %u bytes at peak, %u bytes trimmed.\n", peak.total_bytes, trimmed.total_bytes);
+    if (trimmed.total_bytes * TRIM_RATIO > peak.total_bytes) {
+        fprintf(stderr, "trimmed context keeps more than 1/%d of the peak.\n", TRIM_RATIO);
+        failed = 1;
+    }
+
+    /* glyph caches of the font in use are kept. */
+    ps_trim_caches();
+    ps_get_memory_stats(NULL, &shared);
+    printf("shared caches: %u glyph bytes, %u font bytes.\n", shared.glyph_bytes, shared.font_bytes);
+
+    ps_context_set_canvas(ctx, ps_canvas_create_with_data(second, COLOR_FORMAT_RGBA, WIDTH, HEIGHT, stride));
+    ps_canvas_unref(canvas);
+    canvas = ps_context_get_canvas(ctx);
+
+    draw_frame(ctx, font);
+    if (memcmp(first, second, stride * HEIGHT)) {
+        fprintf(stderr, "frame drawn after trimming differs.\n");
+        failed = 1;
+    }
+
+    ps_font_unref(font);
+    ps_context_unref(ctx);
+    ps_canvas_unref(canvas);
+    ps_shutdown();
+    free(second);
+    free(first);
+
+    printf("memory trim: %s\n", failed ? "FAILED" : "passed");
+    return failed;
+}
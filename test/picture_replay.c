@@ -0,0 +1,193 @@
+/* picture_replay - parallel picture replay conformance test base on picasso
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Records a picture with shadows, gradients, strokes and clipped text
+ * which cross the tile edges, then draws it by ps_draw_picture and by
+ * ps_draw_picture_parallel with several thread counts and tile sizes,
+ * into canvas of every pixel format. The results must be bit exact.
+ *
+ * usage: picture_replay [-f format]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picasso.h"
+
+#define WIDTH   640
+#define HEIGHT  480
+
+static const struct {
+    ps_color_format fmt;
+    const char* name;
+    int bpp;
+} formats[] = {
+    { COLOR_FORMAT_RGBA, "rgba", 4 },
+    { COLOR_FORMAT_ARGB, "argb", 4 },
+    { COLOR_FORMAT_ABGR, "abgr", 4 },
+    { COLOR_FORMAT_BGRA, "bgra", 4 },
+    { COLOR_FORMAT_RGB, "rgb", 3 },
+    { COLOR_FORMAT_BGR, "bgr", 3 },
+    { COLOR_FORMAT_RGB565, "rgb565", 2 },
+    { COLOR_FORMAT_RGB555, "rgb555", 2 },
+};
+
+#define NUM_FORMATS (sizeof(formats) / sizeof(formats[0]))
+
+static const unsigned int threads[] = { 1, 2, 4, 8 };
+static const unsigned int tiles[] = { 64, 100, 256 };
+
+#define NUM_THREADS (sizeof(threads) / sizeof(threads[0]))
+#define NUM_TILES (sizeof(tiles) / sizeof(tiles[0]))
+
+static void record_scene(ps_context* ctx, ps_font* font)
+{
+    ps_color back = {0.9f, 0.9f, 0.8f, 1};
+    ps_color red = {0.8f, 0.1f, 0.1f, 0.9f};
+    ps_color blue = {0.1f, 0.2f, 0.9f, 1};
+    ps_color shadow = {0, 0, 0, 0.6f};
+    ps_color c1 = {1, 0.5f, 0, 1};
+    ps_color c2 = {0, 0.5f, 1, 0.7f};
+    ps_point s = {50, 50};
+    ps_point e = {400, 300};
+    ps_gradient* gradient;
+    ps_font* old;
+    int i;
+
+    ps_set_source_color(ctx, &back);
+    ps_clear(ctx);
+
+    /* shadows are blurred over the edges of 64, 100 and 256 pixels tiles. */
+    ps_save(ctx);
+    ps_set_shadow(ctx, 6, 6, 0.3f);
+    ps_set_shadow_color(ctx, &shadow);
+    for (i = 0; i < 6; i++) {
+        ps_rect r = {(float)(40 + i * 95), (float)(50 + (i % 3) * 30), 60, 70};
+        ps_set_source_color(ctx, &red);
+        ps_ellipse(ctx, &r);
+        ps_fill(ctx);
+    }
+    ps_restore(ctx);
+
+    gradient = ps_gradient_create_linear(GRADIENT_SPREAD_REFLECT, &s, &e);
+    ps_gradient_add_color_stop(gradient, 0, &c1);
+    ps_gradient_add_color_stop(gradient, 1, &c2);
+    {
+        ps_rect r = {200, 180, 220, 150};
+        ps_set_source_gradient(ctx, gradient);
+        ps_rounded_rect(ctx, &r, 20, 20, 20, 20, 20, 20, 20, 20);
+        ps_fill(ctx);
+        ps_set_stroke_color(ctx, &blue);
+        ps_set_line_width(ctx, 5);
+        ps_stroke(ctx);
+    }
+    ps_gradient_unref(gradient);
+
+    /* clipped text, clip and glyphs cross the tile edges. */
+    old = ps_set_font(ctx, font);
+    ps_save(ctx);
+    {
+        ps_rect clip = {90, 240, 420, 150};
+        ps_rect area = {0, 250, WIDTH, 120};
+        const char* text = "Picasso tiles clip text";
+        ps_clip_rect(ctx, &clip);
+        ps_set_shadow(ctx, 3, 3, 0.1f);
+        ps_set_shadow_color(ctx, &shadow);
+        ps_set_text_color(ctx, &blue);
+        ps_text_out_length(ctx, 60, 300, text, (unsigned int)strlen(text));
+        ps_draw_text(ctx, &area, text, (unsigned int)strlen(text), DRAW_TEXT_FILL, TEXT_ALIGN_CENTER);
+    }
+    ps_restore(ctx);
+    ps_set_font(ctx, old);
+}
+
+static int check_format(int f, ps_picture* picture, const ps_matrix* matrix)
+{
+    int stride = WIDTH * formats[f].bpp;
+    ps_byte* serial = (ps_byte*)calloc(1, stride * HEIGHT);
+    ps_byte* parallel = (ps_byte*)calloc(1, stride * HEIGHT);
+    ps_canvas* cs = ps_canvas_create_with_data(serial, formats[f].fmt, WIDTH, HEIGHT, stride);
+    ps_canvas* cp = ps_canvas_create_with_data(parallel, formats[f].fmt, WIDTH, HEIGHT, stride);
+    ps_context* xs = ps_context_create(cs, 0);
+    ps_context* xp = ps_context_create(cp, 0);
+    unsigned int i, j;
+    int failed = 0;
+
+    ps_draw_picture(xs, picture, matrix);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        for (j = 0; j < NUM_TILES; j++) {
+            memset(parallel, 0, stride * HEIGHT);
+            ps_draw_picture_parallel(xp, picture, matrix, tiles[j], threads[i]);
+            if (memcmp(serial, parallel, stride * HEIGHT)) {
+                fprintf(stderr, "%s: %s, %u threads, %u tiles differ from serial replay.\n",
+                        formats[f].name, matrix ? "scaled" : "identity", threads[i], tiles[j]);
+                failed++;
+            }
+        }
+    }
+
+    ps_context_unref(xp);
+    ps_context_unref(xs);
+    ps_canvas_unref(cp);
+    ps_canvas_unref(cs);
+    free(parallel);
+    free(serial);
+    return failed;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* only = NULL;
+    ps_canvas* canvas;
+    ps_context* ctx;
+    ps_picture* picture;
+    ps_matrix* matrix;
+    ps_font* font;
+    unsigned int f;
+    int i, failed = 0;
+
+    for (i = 1; i < argc - 1; i += 2) {
+        if (!strcmp(argv[i], "-f"))
+            only = argv[i+1];
+    }
+
+    if (!ps_initialize()) {
+        fprintf(stderr, "picasso initialize failed.\n");
+        return 1;
+    }
+
+    /* record in the device space of a canvas same size as the targets. */
+    canvas = ps_canvas_create(COLOR_FORMAT_RGBA, WIDTH, HEIGHT);
+    ctx = ps_context_create(canvas, 0);
+    font = ps_font_create("Sans", CHARSET_ANSI, 28, FONT_WEIGHT_BOLD, False);
+    picture = ps_begin_record(ctx);
+    record_scene(ctx, font);
+    ps_end_record(ctx);
+
+    matrix = ps_matrix_create_init(0.8f, 0.1f, -0.1f, 0.9f, 37.5f, 11.25f);
+
+    for (f = 0; f < NUM_FORMATS; f++) {
+        int n;
+
+        if (only && strcmp(only, formats[f].name))
+            continue;
+
+        n = check_format(f, picture, NULL) + check_format(f, picture, matrix);
+        printf("replay %s: %s\n", formats[f].name, n ? "FAILED" : "passed");
+        failed += n;
+    }
+
+    ps_matrix_unref(matrix);
+    ps_picture_unref(picture);
+    ps_font_unref(font);
+    ps_context_unref(ctx);
+    ps_canvas_unref(canvas);
+    ps_shutdown();
+    return failed ? 1 : 0;
+}
@@ -20,7 +20,7 @@ static ps_canvas *canvas;
 
 gboolean expose (GtkWidget *widget, GdkEventExpose *event)
 {
-    suseconds_t t1, t2;
+    long long t1, t2;
     gdk_pixbuf_fill(pixbuf, 0xFFFFFFFF);
     t1 = get_time();
     draw_test(0, context);
@@ -0,0 +1,300 @@
+/* thread_stress - multi-thread rendering test base on picasso
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Every thread draws the same frames into its own canvas, with gradients,
+ * clips, shadows and text. The image, pattern, gradient and font are shared
+ * by all threads, so their reference counts are changed concurrently.
+ * At last the canvases of all threads must be equal.
+ *
+ * Then every thread draws the frames again into its own rows of one shared
+ * host canvas, through a sub canvas created from the host or from an image
+ * of the host, so all threads add damage to the host concurrently.
+ *
+ * Build the library and this test with -fsanitize=thread to check races.
+ *
+ * usage: thread_stress [-t threads] [-n frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "picasso.h"
+
+#define WIDTH   320
+#define HEIGHT  240
+#define MAX_THREADS 32
+
+static ps_image* g_image;
+static ps_pattern* g_pattern;
+static ps_gradient* g_gradient;
+static ps_font* g_font;
+static int g_frames = 50;
+
+static ps_canvas* g_host;
+
+typedef struct {
+    int id;
+    ps_byte* buffer;
+} thread_data;
+
+static void draw_frame(ps_context* ctx, int frame)
+{
+    ps_color white = {1, 1, 1, 1};
+    ps_color red = {1, 0, 0, 0.8f};
+    ps_color blue = {0, 0, 1, 1};
+    ps_color shadow = {0, 0, 0, 0.5f};
+    ps_rect clip = {20, 20, WIDTH - 40, HEIGHT - 40};
+    ps_rect r1 = {(float)(frame % 60), 10, 150, 100};
+    ps_rect r2 = {160, (float)(frame % 40), 120, 120};
+    ps_rect r3 = {40, 120, 200, 80};
+    ps_rect area = {10, 180, 300, 40};
+    char text[64];
+    ps_font* old;
+
+    ps_set_source_color(ctx, &white);
+    ps_clear(ctx);
+
+    ps_save(ctx);
+    ps_clip_rect(ctx, &clip);
+
+    ps_set_source_gradient(ctx, g_gradient);
+    ps_rectangle(ctx, &r1);
+    ps_fill(ctx);
+
+    ps_set_shadow(ctx, 3, 3, 0.2f);
+    ps_set_shadow_color(ctx, &shadow);
+    ps_set_source_image(ctx, g_image);
+    ps_ellipse(ctx, &r2);
+    ps_fill(ctx);
+    ps_reset_shadow(ctx);
+
+    ps_set_source_pattern(ctx, g_pattern);
+    ps_rounded_rect(ctx, &r3, 10, 10, 10, 10, 10, 10, 10, 10);
+    ps_fill(ctx);
+
+    ps_set_stroke_color(ctx, &blue);
+    ps_set_line_width(ctx, 2);
+    ps_rectangle(ctx, &r3);
+    ps_stroke(ctx);
+    ps_restore(ctx);
+
+    old = ps_set_font(ctx, g_font);
+    ps_set_text_color(ctx, &red);
+    sprintf(text, "frame %d, picasso threads", frame);
+    ps_text_out_length(ctx, 20, 40, text, (unsigned int)strlen(text));
+    ps_draw_text(ctx, &area, text, (unsigned int)strlen(text), DRAW_TEXT_FILL, TEXT_ALIGN_CENTER);
+    ps_set_font(ctx, old);
+}
+
+static void render(thread_data* d)
+{
+    ps_canvas* canvas = ps_canvas_create_with_data(d->buffer, COLOR_FORMAT_RGBA, WIDTH, HEIGHT, WIDTH * 4);
+    ps_context* ctx = ps_context_create(canvas, 0);
+    int i;
+
+    for (i = 0; i < g_frames; i++)
+        draw_frame(ctx, i);
+
+    ps_context_unref(ctx);
+    ps_canvas_unref(canvas);
+}
+
+static void render_host(thread_data* d)
+{
+    ps_rect r = {0, (float)(d->id * HEIGHT), WIDTH, HEIGHT};
+    ps_image* image = NULL;
+    ps_canvas* canvas;
+    ps_context* ctx;
+    int i;
+
+    if (d->id % 2) {
+        image = ps_image_create_from_canvas(g_host, &r);
+        canvas = ps_canvas_create_from_image(image, NULL);
+    } else {
+        canvas = ps_canvas_create_from_canvas(g_host, &r);
+    }
+
+    ctx = ps_context_create(canvas, 0);
+    for (i = 0; i < g_frames; i++)
+        draw_frame(ctx, i);
+
+    ps_context_unref(ctx);
+    ps_canvas_unref(canvas);
+    if (image)
+        ps_image_unref(image);
+}
+
+#if defined(WIN32)
+static DWORD WINAPI thread_proc(LPVOID p)
+{
+    render((thread_data*)p);
+    return 0;
+}
+
+static DWORD WINAPI host_thread_proc(LPVOID p)
+{
+    render_host((thread_data*)p);
+    return 0;
+}
+#else
+static void* thread_proc(void* p)
+{
+    render((thread_data*)p);
+    return NULL;
+}
+
+static void* host_thread_proc(void* p)
+{
+    render_host((thread_data*)p);
+    return NULL;
+}
+#endif
+
+static void run_threads(thread_data* data, int num, int host)
+{
+#if defined(WIN32)
+    HANDLE threads[MAX_THREADS];
+#else
+    pthread_t threads[MAX_THREADS];
+#endif
+    int i;
+
+    for (i = 0; i < num; i++) {
+#if defined(WIN32)
+        threads[i] = CreateThread(NULL, 0, host ? host_thread_proc : thread_proc, &data[i], 0, NULL);
+#else
+        pthread_create(&threads[i], NULL, host ? host_thread_proc : thread_proc, &data[i]);
+#endif
+    }
+
+    for (i = 0; i < num; i++) {
+#if defined(WIN32)
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+static void create_shared_objects(ps_byte* pixels)
+{
+    ps_point s = {0, 0};
+    ps_point e = {WIDTH, HEIGHT};
+    ps_color c1 = {1, 0, 0, 1};
+    ps_color c2 = {0, 1, 0, 1};
+    ps_color c3 = {0, 0, 1, 1};
+    int x, y;
+
+    for (y = 0; y < 64; y++) {
+        for (x = 0; x < 64; x++) {
+            ps_byte* p = pixels + (y * 64 + x) * 4;
+            p[0] = (ps_byte)(x * 4);
+            p[1] = (ps_byte)(y * 4);
+            p[2] = (ps_byte)((x ^ y) * 4);
+            p[3] = 255;
+        }
+    }
+
+    g_image = ps_image_create_with_data(pixels, COLOR_FORMAT_RGBA, 64, 64, 64 * 4);
+    g_pattern = ps_pattern_create_image(g_image, WRAP_TYPE_REPEAT, WRAP_TYPE_REFLECT, NULL);
+    g_gradient = ps_gradient_create_linear(GRADIENT_SPREAD_REFLECT, &s, &e);
+    ps_gradient_add_color_stop(g_gradient, 0, &c1);
+    ps_gradient_add_color_stop(g_gradient, 0.5f, &c2);
+    ps_gradient_add_color_stop(g_gradient, 1, &c3);
+    g_font = ps_font_create("Sans", CHARSET_ANSI, 16, FONT_WEIGHT_REGULAR, False);
+}
+
+static void destroy_shared_objects(void)
+{
+    ps_font_unref(g_font);
+    ps_gradient_unref(g_gradient);
+    ps_pattern_unref(g_pattern);
+    ps_image_unref(g_image);
+}
+
+int main(int argc, char* argv[])
+{
+    static ps_byte pixels[64 * 64 * 4];
+    thread_data data[MAX_THREADS];
+    ps_byte* host_buffer;
+    ps_rect damage[8];
+    unsigned int num_damage;
+    int num = 4, i, failed = 0;
+
+    for (i = 1; i < argc - 1; i += 2) {
+        if (!strcmp(argv[i], "-t"))
+            num = atoi(argv[i+1]);
+        else if (!strcmp(argv[i], "-n"))
+            g_frames = atoi(argv[i+1]);
+    }
+
+    if (num < 1 || num > MAX_THREADS || g_frames < 1) {
+        fprintf(stderr, "usage: %s [-t threads] [-n frames]\n", argv[0]);
+        return 1;
+    }
+
+    if (!ps_initialize()) {
+        fprintf(stderr, "picasso initialize failed.\n");
+        return 1;
+    }
+
+    create_shared_objects(pixels);
+
+    for (i = 0; i < num; i++) {
+        data[i].id = i;
+        data[i].buffer = (ps_byte*)calloc(1, WIDTH * HEIGHT * 4);
+    }
+
+    run_threads(data, num, 0);
+
+    for (i = 1; i < num; i++) {
+        if (memcmp(data[0].buffer, data[i].buffer, WIDTH * HEIGHT * 4)) {
+            fprintf(stderr, "thread %d: canvas differs from thread 0.\n", i);
+            failed = 1;
+        }
+    }
+
+    host_buffer = (ps_byte*)calloc(num, WIDTH * HEIGHT * 4);
+    g_host = ps_canvas_create_with_data(host_buffer, COLOR_FORMAT_RGBA, WIDTH, HEIGHT * num, WIDTH * 4);
+
+    run_threads(data, num, 1);
+
+    for (i = 0; i < num; i++) {
+        if (memcmp(data[0].buffer, host_buffer + i * WIDTH * HEIGHT * 4, WIDTH * HEIGHT * 4)) {
+            fprintf(stderr, "thread %d: host rows differ from thread 0.\n", i);
+            failed = 1;
+        }
+    }
+
+    /* all rows of the host are cleared, so the damage is merged into the whole host. */
+    num_damage = ps_canvas_get_damage(g_host, damage, 8);
+    if (num_damage != 1 || damage[0].x != 0 || damage[0].y != 0
+        || damage[0].w != WIDTH || damage[0].h != HEIGHT * num) {
+        fprintf(stderr, "host damage: %u rectangles, not the whole host.\n", num_damage);
+        failed = 1;
+    }
+
+    ps_canvas_unref(g_host);
+    free(host_buffer);
+
+    for (i = 0; i < num; i++)
+        free(data[i].buffer);
+
+    destroy_shared_objects();
+    ps_shutdown();
+
+    printf("%d threads, %d frames: %s\n", num, g_frames, failed ? "FAILED" : "passed");
+    return failed;
+}
@@ -19,14 +19,15 @@ typedef long suseconds_t;
 #define inline __inline
 #endif
 
-static inline suseconds_t get_time()
+/* microseconds, seconds are counted in too so it does not wrap every second. */
+static inline long long get_time()
 {
 #if defined(WIN32) || defined(WINCE)
-    DWORD t1 = GetTickCount();
+    long long t1 = (long long)GetTickCount() * 1000;
 #else
     struct timeval t;
     gettimeofday(&t, 0);
-    suseconds_t t1 = t.tv_usec;
+    long long t1 = (long long)t.tv_sec * 1000000 + t.tv_usec;
 #endif
     return t1;
 }
@@ -48,6 +49,20 @@ static inline double get_clock_used_ms(LARGE_INTEGER t1, LARGE_INTEGER t2)
     return ((double)(t2.QuadPart-t1.QuadPart)/(double)f.QuadPart)*1000;
 }
 
+#else
+typedef struct timespec clocktime_t;
+
+static inline clocktime_t get_clock()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t;
+}
+
+static inline double get_clock_used_ms(clocktime_t t1, clocktime_t t2)
+{
+    return (double)(t2.tv_sec-t1.tv_sec)*1000 + (double)(t2.tv_nsec-t1.tv_nsec)/1000000;
+}
 #endif
 
 #endif
@@ -0,0 +1,205 @@
+/* union_many - n-way path union test base on picasso
+ *
+ * Copyright (C) 2016 Zhang Ji Peng
+ * Contact: onecoolx@gmail.com
+ */
+
+/*
+ * Builds random sets of rectangles and ellipses as polygons, some of them
+ * with an inner contour, small and spread for disjoint bounds and large for
+ * heavy overlap. All the outer contours are also added to one reference path
+ * in the same direction and the inner contours against it, so the reference
+ * filled by the nonzero rule is the exact union. The result of
+ * ps_path_union_many is filled without antialias and compared with it, the
+ * filled pixels must be the same except on the boundary. The result given
+ * as one of the sources and empty paths in the array are checked too.
+ *
+ * usage: union_many [-s seeds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "picasso.h"
+
+#define WIDTH   600
+#define HEIGHT  600
+#define MAX_PATHS 400
+#define ELLIPSE_STEPS 64
+
+static const struct {
+    int num;
+    int size;
+} sets[] = {
+    { 300, 60 },  /* mostly disjoint bounds. */
+    { 50, 250 },  /* heavy overlap. */
+    { 120, 120 },
+    { 1, 200 },
+};
+
+#define NUM_SETS (sizeof(sets) / sizeof(sets[0]))
+
+static void fill_path(ps_path* path, ps_fill_rule rule, ps_byte* buffer)
+{
+    ps_canvas* canvas = ps_canvas_create_with_data(buffer, COLOR_FORMAT_RGBA, WIDTH, HEIGHT, WIDTH * 4);
+    ps_context* ctx = ps_context_create(canvas, 0);
+    ps_color white = {1, 1, 1, 1};
+
+    memset(buffer, 0, WIDTH * HEIGHT * 4);
+    ps_set_antialias(ctx, False);
+    ps_set_source_color(ctx, &white);
+    ps_set_fill_rule(ctx, rule);
+    ps_set_path(ctx, path);
+    ps_fill(ctx);
+
+    ps_context_unref(ctx);
+    ps_canvas_unref(canvas);
+}
+
+/* contour of a rectangle or an ellipse inside r, counter or clockwise. */
+static void add_contour(ps_path* path, const ps_rect* r, int ellipse, int reverse)
+{
+    int i, steps = ellipse ? ELLIPSE_STEPS : 4;
+    for (i = 0; i < steps; i++) {
+        int k = reverse ? (steps - i) % steps : i;
+        ps_point p;
+        if (ellipse) {
+            double a = 2 * 3.14159265358979 * k / steps;
+            p.x = (float)(r->x + r->w * (1 + cos(a)) / 2);
+            p.y = (float)(r->y + r->h * (1 + sin(a)) / 2);
+        } else {
+            p.x = (k == 1 || k == 2) ? r->x + r->w : r->x;
+            p.y = (k >= 2) ? r->y + r->h : r->y;
+        }
+
+        if (i == 0)
+            ps_path_move_to(path, &p);
+        else
+            ps_path_line_to(path, &p);
+    }
+    ps_path_sub_close(path);
+}
+
+static void create_paths(ps_path** paths, int num, int size, ps_path* reference)
+{
+    int i;
+    for (i = 0; i < num; i++) {
+        int ellipse = rand() % 2;
+        ps_rect r;
+        r.x = (float)(rand() % (WIDTH - size - 2));
+        r.y = (float)(rand() % (HEIGHT - size - 2));
+        r.w = size * (0.3f + (rand() % 70) / 100.0f);
+        r.h = size * (0.3f + (rand() % 70) / 100.0f);
+
+        paths[i] = ps_path_create();
+        add_contour(paths[i], &r, ellipse, 0);
+        add_contour(reference, &r, ellipse, 0);
+
+        if (rand() % 10 == 0) {
+            ps_rect q = {r.x + r.w / 4, r.y + r.h / 4, r.w / 2, r.h / 2};
+            add_contour(paths[i], &q, 0, 0);
+            add_contour(reference, &q, 0, 1);
+        }
+    }
+}
+
+/*
+ * The overlapping contours of the reference add their coverage in a pixel
+ * an edge passes through, so such pixels may round the other way. Only the
+ * pixels with a neighbour of other value are allowed to differ.
+ */
+static int on_boundary(const ps_byte* buffer, int x, int y)
+{
+    int i, j;
+    for (j = -1; j <= 1; j++) {
+        for (i = -1; i <= 1; i++) {
+            if (buffer[((y + j) * WIDTH + x + i) * 4] != buffer[(y * WIDTH + x) * 4])
+                return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare(const char* what, ps_path* reference, ps_path* result, ps_byte* ba, ps_byte* bb)
+{
+    int x, y, diff = 0;
+
+    fill_path(reference, FILL_RULE_WINDING, ba);
+    fill_path(result, FILL_RULE_EVEN_ODD, bb);
+    for (y = 1; y < HEIGHT - 1; y++) {
+        for (x = 1; x < WIDTH - 1; x++) {
+            int i = y * WIDTH + x;
+            if (ba[i * 4] != bb[i * 4] && !on_boundary(ba, x, y) && !on_boundary(bb, x, y))
+                diff++;
+        }
+    }
+
+    if (diff)
+        fprintf(stderr, "%s: %d pixels differ from the reference.\n", what, diff);
+    return diff ? 1 : 0;
+}
+
+static int check_set(int seed, int num, int size, ps_byte* ba, ps_byte* bb)
+{
+    ps_path* paths[MAX_PATHS + 1];
+    ps_path* reference = ps_path_create();
+    ps_path* many = ps_path_create();
+    char what[64];
+    int i, failed = 0;
+
+    srand(seed);
+    create_paths(paths, num, size, reference);
+
+    sprintf(what, "seed %d, %d paths of %d", seed, num, size);
+    ps_path_union_many(many, paths, num);
+    failed += compare(what, reference, many, ba, bb);
+
+    /* empty path is skipped. */
+    paths[num] = ps_path_create();
+    ps_path_union_many(many, paths, num + 1);
+    strcat(what, ", empty");
+    failed += compare(what, reference, many, ba, bb);
+    ps_path_unref(paths[num]);
+
+    /* result is one of the sources. */
+    ps_path_union_many(paths[0], paths, num);
+    strcat(what, ", in place");
+    failed += compare(what, reference, paths[0], ba, bb);
+
+    for (i = 0; i < num; i++)
+        ps_path_unref(paths[i]);
+    ps_path_unref(many);
+    ps_path_unref(reference);
+    return failed;
+}
+
+int main(int argc, char* argv[])
+{
+    ps_byte* ba = (ps_byte*)malloc(WIDTH * HEIGHT * 4);
+    ps_byte* bb = (ps_byte*)malloc(WIDTH * HEIGHT * 4);
+    int seeds = 5, i, failed = 0;
+    unsigned int j;
+
+    for (i = 1; i < argc - 1; i += 2) {
+        if (!strcmp(argv[i], "-s"))
+            seeds = atoi(argv[i+1]);
+    }
+
+    if (!ps_initialize()) {
+        fprintf(stderr, "picasso initialize failed.\n");
+        return 1;
+    }
+
+    for (i = 1; i <= seeds; i++)
+        for (j = 0; j < NUM_SETS; j++)
+            failed += check_set(i, sets[j].num, sets[j].size, ba, bb);
+
+    ps_shutdown();
+    free(bb);
+    free(ba);
+
+    printf("union many: %s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}